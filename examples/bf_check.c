@@ -0,0 +1,234 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bf.h"
+
+#define CALL_OR_DIE(call)     \
+  {                           \
+    BF_ErrorCode code = call; \
+    if (code != BF_OK)        \
+    {                         \
+      BF_PrintError(code);    \
+      exit(code);             \
+    }                         \
+  }
+
+#define BLOCKS_NUM 300 // blocks of the file, more than the blocks in memory so that they are replaced
+#define WINDOW 4       // blocks pinned together by BF_GetBlocks
+#define FILE_NAME "check.db"
+
+// the BF level every check runs with
+typedef struct
+{
+  const char *name;
+  ReplacementAlgorithm policy;
+  int frames;
+  int pageSize;
+  int mapped; // 1 if the file is mapped with BF_MapFile
+} Config;
+
+const Config configs[] = {
+    {"LRU", LRU, BF_BUFFER_SIZE, BF_BLOCK_SIZE, 0},
+    {"MRU", MRU, BF_BUFFER_SIZE, BF_BLOCK_SIZE, 0},
+#ifdef BF_SRC
+    {"CLOCK, 8 frames", CLOCK, 8, BF_BLOCK_SIZE, 0},
+    {"TWO_Q, 8 frames", TWO_Q, 8, BF_BLOCK_SIZE, 0},
+    {"ARC, 8 frames", ARC, 8, BF_BLOCK_SIZE, 0},
+    {"LRU, 4096 byte pages", LRU, 16, 4096, 0},
+    {"LRU, mapped file", LRU, 8, BF_BLOCK_SIZE, 1},
+#endif
+};
+
+int failures = 0;
+int versions[BLOCKS_NUM]; // how many times every block has been written
+
+void check(int ok, const char *what)
+{
+  printf("  %-44s %s\n", what, ok ? "ok" : "FAILED");
+  if (!ok)
+    failures++;
+}
+
+char pattern(int block_num, int j)
+{
+  return (char)(block_num * 31 + j * 7 + versions[block_num] * 13);
+}
+
+void fillBlock(BF_Block *block, int block_num, int pageSize)
+{
+  char *data = BF_Block_GetData(block);
+  for (int j = 0; j < pageSize; j++)
+    data[j] = pattern(block_num, j);
+  BF_Block_SetDirty(block);
+}
+
+int sameBlock(BF_Block *block, int block_num, int pageSize)
+{
+  char *data = BF_Block_GetData(block);
+  for (int j = 0; j < pageSize; j++)
+    if (data[j] != pattern(block_num, j))
+      return 0;
+  return 1;
+}
+
+void initBF(const Config *config)
+{
+#ifdef BF_SRC
+  CALL_OR_DIE(BF_InitPool(config->policy, config->frames));
+#else
+  CALL_OR_DIE(BF_Init(config->policy));
+#endif
+}
+
+void openFile(const Config *config, int *fd)
+{
+  CALL_OR_DIE(BF_OpenFile(FILE_NAME, fd));
+#ifdef BF_SRC
+  CALL_OR_DIE(BF_SetPageSize(*fd, config->pageSize));
+  if (config->mapped)
+    CALL_OR_DIE(BF_MapFile(*fd));
+#endif
+}
+
+/*
+  Reads every block of the file with BF_GetBlock, first to last or last to first, and compares it with what was written.
+*/
+int verifyBlocks(int fd, int pageSize, int reverse)
+{
+  BF_Block *block;
+  BF_Block_Init(&block);
+  int ok = 1;
+  for (int i = 0; i < BLOCKS_NUM && ok; i++)
+  {
+    int block_num = reverse ? BLOCKS_NUM - 1 - i : i;
+    CALL_OR_DIE(BF_GetBlock(fd, block_num, block));
+    ok = sameBlock(block, block_num, pageSize);
+    CALL_OR_DIE(BF_UnpinBlock(block));
+  }
+  BF_Block_Destroy(&block);
+  return ok;
+}
+
+/*
+  Reads and rewrites the blocks in an order that visits some of them much more often than others,
+  so that every policy keeps and replaces different blocks.
+*/
+int rewriteBlocks(int fd, int pageSize)
+{
+  BF_Block *block;
+  BF_Block_Init(&block);
+  int ok = 1;
+  for (int i = 0; i < 4 * BLOCKS_NUM && ok; i++)
+  {
+    int block_num = i % 3 == 0 ? (i / 3) % 5 : (i * 37) % BLOCKS_NUM;
+    CALL_OR_DIE(BF_GetBlock(fd, block_num, block));
+    ok = sameBlock(block, block_num, pageSize);
+    if (i % 4 == 0)
+    {
+      versions[block_num]++;
+      fillBlock(block, block_num, pageSize);
+    }
+    CALL_OR_DIE(BF_UnpinBlock(block));
+  }
+  BF_Block_Destroy(&block);
+  return ok;
+}
+
+void runChecks(const Config *config)
+{
+  printf("%s\n", config->name);
+  remove(FILE_NAME);
+  memset(versions, 0, sizeof(versions));
+  initBF(config);
+  CALL_OR_DIE(BF_CreateFile(FILE_NAME));
+  int fd;
+  openFile(config, &fd);
+
+  BF_Block *block;
+  BF_Block_Init(&block);
+  for (int i = 0; i < BLOCKS_NUM; i++)
+  {
+    CALL_OR_DIE(BF_AllocateBlock(fd, block));
+    fillBlock(block, i, config->pageSize);
+    CALL_OR_DIE(BF_UnpinBlock(block));
+  }
+  int blocks_num;
+  CALL_OR_DIE(BF_GetBlockCounter(fd, &blocks_num));
+  check(blocks_num == BLOCKS_NUM, "BF_AllocateBlock and BF_GetBlockCounter");
+  check(verifyBlocks(fd, config->pageSize, 0) && verifyBlocks(fd, config->pageSize, 1), "BF_GetBlock");
+  check(rewriteBlocks(fd, config->pageSize) && verifyBlocks(fd, config->pageSize, 0), "BF_GetBlock after rewrites");
+
+  // with every block in memory pinned there is no room for one more
+  if (!config->mapped)
+  {
+    BF_Block **pinned = malloc((config->frames + 1) * sizeof(BF_Block *));
+    int pinnedN = 0;
+    BF_ErrorCode code = BF_OK;
+    while (pinnedN <= config->frames && code == BF_OK)
+    {
+      BF_Block_Init(&pinned[pinnedN]);
+      code = BF_GetBlock(fd, pinnedN, pinned[pinnedN]);
+      if (code == BF_OK)
+        pinnedN++;
+      else
+        BF_Block_Destroy(&pinned[pinnedN]);
+    }
+    check(pinnedN == config->frames && code == BF_FULL_MEMORY_ERROR, "BF_GetBlock with every block pinned");
+    for (int i = 0; i < pinnedN; i++)
+    {
+      CALL_OR_DIE(BF_UnpinBlock(pinned[i]));
+      BF_Block_Destroy(&pinned[i]);
+    }
+    free(pinned);
+  }
+
+#ifdef BF_SRC
+  int frames, pageSize;
+  CALL_OR_DIE(BF_GetPoolSize(&frames));
+  CALL_OR_DIE(BF_GetPageSize(fd, &pageSize));
+  check(frames == config->frames && pageSize == config->pageSize, "BF_GetPoolSize and BF_GetPageSize");
+
+  // windows of blocks far apart, asked for last to first
+  BF_Block *window[WINDOW];
+  int block_nums[WINDOW];
+  for (int w = 0; w < WINDOW; w++)
+    BF_Block_Init(&window[w]);
+  int ok = 1;
+  for (int i = 0; i + WINDOW <= BLOCKS_NUM && ok; i += WINDOW)
+  {
+    for (int w = 0; w < WINDOW; w++)
+      block_nums[w] = (i + WINDOW - 1 - w) * 7 % BLOCKS_NUM;
+    CALL_OR_DIE(BF_Prefetch(fd, block_nums, WINDOW));
+    CALL_OR_DIE(BF_GetBlocks(fd, block_nums, WINDOW, window));
+    for (int w = 0; w < WINDOW; w++)
+      ok &= sameBlock(window[w], block_nums[w], config->pageSize);
+    CALL_OR_DIE(BF_UnpinBlocks(window, WINDOW));
+  }
+  for (int w = 0; w < WINDOW; w++)
+    BF_Block_Destroy(&window[w]);
+  check(ok, "BF_Prefetch and BF_GetBlocks");
+#endif
+
+  // the blocks are on the disk after BF_Close
+  CALL_OR_DIE(BF_CloseFile(fd));
+  CALL_OR_DIE(BF_Close());
+  initBF(config);
+  openFile(config, &fd);
+  CALL_OR_DIE(BF_GetBlockCounter(fd, &blocks_num));
+  check(blocks_num == BLOCKS_NUM && verifyBlocks(fd, config->pageSize, 0), "BF_Close and BF_OpenFile");
+
+  BF_Block_Destroy(&block);
+  CALL_OR_DIE(BF_CloseFile(fd));
+  CALL_OR_DIE(BF_Close());
+  remove(FILE_NAME);
+}
+
+int main()
+{
+  for (int c = 0; c < (int)(sizeof(configs) / sizeof(Config)); c++)
+    runChecks(&configs[c]);
+
+  printf("%s\n", failures == 0 ? "All checks passed" : "Some checks FAILED");
+  return failures == 0 ? 0 : 1;
+}
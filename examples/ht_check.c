@@ -0,0 +1,399 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bf.h"
+#include "hash_file.h"
+
+#define RECORDS_NUM 1500  // records of the first file, the second one gets two thirds of them
+#define DUPLICATES_NUM 60 // extra records of the first file with id DUPLICATE_ID, so that its bucket gets an overflow chain
+#define DUPLICATE_ID 7
+#define KEPT_NUM 10   // records of the first file that are not deleted at the end, so that its buckets merge
+#define JOIN_BLOCKS 3 // the smallest budget of HT_GraceJoin, so that its partitions are split again
+#define FILE_NAME1 "check1.db"
+#define FILE_NAME2 "check2.db"
+
+const char *names[] = {
+    "Yannis",
+    "Christofos",
+    "Sofia",
+    "Marianna",
+    "Vagelis",
+    "Maria",
+    "Iosif",
+    "Dionisis",
+    "Konstantina",
+    "Theofilos",
+    "Giorgos",
+    "Dimitris"};
+
+const char *surnames[] = {
+    "Ioannidis",
+    "Svingos",
+    "Karvounari",
+    "Rezkalla",
+    "Nikolopoulos",
+    "Berreta",
+    "Koronis",
+    "Gaitanis",
+    "Oikonomou",
+    "Mailis",
+    "Michas",
+    "Halatsis"};
+
+const char *cities[] = {
+    "Athens",
+    "San Francisco",
+    "Los Angeles",
+    "Amsterdam",
+    "London",
+    "New York",
+    "Tokyo",
+    "Hong Kong",
+    "Munich",
+    "Miami"};
+
+// the BF level and page size that every check runs with
+typedef struct
+{
+  const char *name;
+  ReplacementAlgorithm policy;
+  int frames;
+  int pageSize;
+} Config;
+
+const Config configs[] = {
+    {"LRU", LRU, BF_BUFFER_SIZE, BF_BLOCK_SIZE},
+    {"MRU", MRU, BF_BUFFER_SIZE, BF_BLOCK_SIZE},
+#ifdef BF_SRC
+    {"CLOCK, 24 frames", CLOCK, 24, BF_BLOCK_SIZE},
+    {"TWO_Q, 24 frames", TWO_Q, 24, BF_BLOCK_SIZE},
+    {"ARC, 24 frames", ARC, 24, BF_BLOCK_SIZE},
+    {"LRU, 4096 byte pages", LRU, BF_BUFFER_SIZE, 4096},
+#endif
+};
+
+// what a file should hold: the record of every tuple id, and if it is still in the file
+typedef struct
+{
+  Record *records;
+  char *alive;
+  int capacity;
+} Model;
+
+// the pairs a join gave, checked against two models
+typedef struct
+{
+  Model *model1;
+  Model *model2;
+  const char *field;
+  long pairs;
+  unsigned long sum; // sum of pairHash of every pair, the same whatever the order of the pairs
+  long bad;          // pairs whose records do not exist or do not have the same key
+} JoinResult;
+
+int failures = 0;
+
+void check(int ok, const char *what)
+{
+  printf("  %-44s %s\n", what, ok ? "ok" : "FAILED");
+  if (!ok)
+    failures++;
+}
+
+unsigned long pairHash(tid tupleId1, tid tupleId2)
+{
+  unsigned long h = (unsigned long)tupleId1 * 2654435761u + (unsigned long)tupleId2;
+  h ^= h >> 29;
+  h *= 0xbf58476d1ce4e5b9ul;
+  return h ^ (h >> 32);
+}
+
+Record makeRecord(int id, int i)
+{
+  Record record;
+  memset(&record, 0, sizeof(Record));
+  record.id = id;
+  strcpy(record.name, names[i % 12]);
+  strcpy(record.surname, surnames[(i / 12) % 12]);
+  strcpy(record.city, cities[(i * 7) % 10]);
+  return record;
+}
+
+void insertModelRecord(int indexDesc, Model *model, Record record)
+{
+  UpdateRecordArray update[MAX_UPDATES];
+  tid tupleId;
+  CALL_OR_DIE(HT_InsertEntry(indexDesc, record, &tupleId, update));
+
+  if (tupleId >= model->capacity)
+  {
+    int capacity = 2 * tupleId + 1;
+    model->records = realloc(model->records, capacity * sizeof(Record));
+    model->alive = realloc(model->alive, capacity);
+    memset(model->alive + model->capacity, 0, capacity - model->capacity);
+    model->capacity = capacity;
+  }
+  model->records[tupleId] = record;
+  model->alive[tupleId] = 1;
+}
+
+/*
+  Deletes one record with 'id' and marks the tuple id HT_DeleteEntry reports as deleted in 'model'.
+*/
+int deleteModelRecord(int indexDesc, Model *model, int id)
+{
+  UpdateRecordArray update[MAX_UPDATES];
+  if (HT_DeleteEntry(indexDesc, id, update) != HT_OK)
+    return 0;
+  tid tupleId = update[0].oldTupleId;
+  if (tupleId < 0 || tupleId >= model->capacity || !model->alive[tupleId] || model->records[tupleId].id != id)
+    return 0;
+  model->alive[tupleId] = 0;
+  return 1;
+}
+
+int sameRecord(const Record *a, const Record *b)
+{
+  return a->id == b->id && strcmp(a->name, b->name) == 0 && strcmp(a->surname, b->surname) == 0 && strcmp(a->city, b->city) == 0;
+}
+
+/*
+  HT_Lookup finds every id of 'model' (some record with that id for duplicates) and no other id.
+*/
+int verifyLookup(int indexDesc, Model *model, int maxId)
+{
+  char *seen = calloc(maxId + 1, 1);
+  int ok = 1;
+  for (tid t = 0; t < model->capacity; t++)
+  {
+    if (!model->alive[t] || seen[model->records[t].id])
+      continue;
+    seen[model->records[t].id] = 1;
+
+    Record record;
+    if (HT_Lookup(indexDesc, model->records[t].id, &record) != HT_OK || record.id != model->records[t].id)
+      ok = 0;
+    else if (record.id != DUPLICATE_ID && !sameRecord(&record, &model->records[t]))
+      ok = 0;
+  }
+  for (int id = 0; id <= maxId; id++)
+  {
+    Record record;
+    if (!seen[id] && HT_Lookup(indexDesc, id, &record) == HT_OK)
+      ok = 0;
+  }
+  free(seen);
+  return ok;
+}
+
+/*
+  HT_Scan gives every record of 'model' once, with its tuple id.
+*/
+int verifyScan(int indexDesc, Model *model)
+{
+  char *seen = calloc(model->capacity, 1);
+  int ok = 1;
+  HT_Scan scan;
+  Record record;
+  tid tupleId;
+
+  CALL_OR_DIE(HT_ScanOpen(indexDesc, &scan));
+  while (1)
+  {
+    CALL_OR_DIE(HT_ScanNext(&scan, &record, &tupleId));
+    if (tupleId == -1)
+      break;
+    if (tupleId >= model->capacity || !model->alive[tupleId] || seen[tupleId] || !sameRecord(&record, &model->records[tupleId]))
+      ok = 0;
+    else
+      seen[tupleId] = 1;
+  }
+  CALL_OR_DIE(HT_ScanClose(&scan));
+
+  for (tid t = 0; t < model->capacity; t++)
+    if (model->alive[t] && !seen[t])
+      ok = 0;
+  free(seen);
+  return ok;
+}
+
+/*
+  HT_FetchRecords gives the records of every tuple id of 'model', asked last to first.
+*/
+int verifyFetch(int indexDesc, Model *model)
+{
+  tid *tupleIds = malloc(model->capacity * sizeof(tid));
+  Record *records = malloc(model->capacity * sizeof(Record));
+  int n = 0;
+  for (tid t = model->capacity - 1; t >= 0; t--)
+    if (model->alive[t])
+      tupleIds[n++] = t;
+
+  int ok = HT_FetchRecords(indexDesc, tupleIds, n, records) == HT_OK;
+  for (int i = 0; i < n && ok; i++)
+    ok = sameRecord(&records[i], &model->records[tupleIds[i]]);
+
+  free(tupleIds);
+  free(records);
+  return ok;
+}
+
+void addJoinPair(const char *key, tid tupleId1, tid tupleId2, void *arg)
+{
+  JoinResult *result = arg;
+  char key1[sizeof(((JoinTuple *)0)->key)], key2[sizeof(((JoinTuple *)0)->key)];
+
+  result->pairs++;
+  result->sum += pairHash(tupleId1, tupleId2);
+  if (tupleId1 < 0 || tupleId1 >= result->model1->capacity || !result->model1->alive[tupleId1] ||
+      tupleId2 < 0 || tupleId2 >= result->model2->capacity || !result->model2->alive[tupleId2])
+  {
+    result->bad++;
+    return;
+  }
+  getRecordKey(&result->model1->records[tupleId1], result->field, key1);
+  getRecordKey(&result->model2->records[tupleId2], result->field, key2);
+  if (strcmp(key1, key) != 0 || strcmp(key2, key) != 0)
+    result->bad++;
+}
+
+/*
+  HT_GraceJoin on 'field' gives the same pairs as nested loops over the two models, with the smallest and the largest budget.
+*/
+int verifyGraceJoin(int indexDesc1, Model *model1, int indexDesc2, Model *model2, const char *field)
+{
+  JoinResult expected = {model1, model2, field, 0, 0, 0};
+  char key1[sizeof(((JoinTuple *)0)->key)], key2[sizeof(((JoinTuple *)0)->key)];
+  for (tid t1 = 0; t1 < model1->capacity; t1++)
+  {
+    if (!model1->alive[t1])
+      continue;
+    getRecordKey(&model1->records[t1], field, key1);
+    for (tid t2 = 0; t2 < model2->capacity; t2++)
+    {
+      if (!model2->alive[t2])
+        continue;
+      getRecordKey(&model2->records[t2], field, key2);
+      if (strcmp(key1, key2) == 0)
+      {
+        expected.pairs++;
+        expected.sum += pairHash(t1, t2);
+      }
+    }
+  }
+
+  int budgets[] = {JOIN_BLOCKS, getJoinMemoryMax()};
+  for (int b = 0; b < 2; b++)
+  {
+    JoinResult result = {model1, model2, field, 0, 0, 0};
+    if (HT_GraceJoin(indexDesc1, indexDesc2, field, budgets[b], addJoinPair, &result) != HT_OK)
+      return 0;
+    if (result.bad != 0 || result.pairs != expected.pairs || result.sum != expected.sum)
+      return 0;
+  }
+  return 1;
+}
+
+void checkFile(int indexDesc, Model *model, int maxId, const char *what)
+{
+  char message[64];
+  snprintf(message, sizeof(message), "%s: HT_Lookup", what);
+  check(verifyLookup(indexDesc, model, maxId), message);
+  snprintf(message, sizeof(message), "%s: HT_Scan", what);
+  check(verifyScan(indexDesc, model), message);
+  snprintf(message, sizeof(message), "%s: HT_FetchRecords", what);
+  check(verifyFetch(indexDesc, model), message);
+}
+
+void checkJoins(int indexDesc1, Model *model1, int indexDesc2, Model *model2, const char *what)
+{
+  const char *fields[] = {"id", "name", "city"};
+  char message[64];
+  for (int f = 0; f < 3; f++)
+  {
+    snprintf(message, sizeof(message), "%s: HT_GraceJoin on %s", what, fields[f]);
+    check(verifyGraceJoin(indexDesc1, model1, indexDesc2, model2, fields[f]), message);
+  }
+}
+
+void runChecks(const Config *config)
+{
+  printf("%s\n", config->name);
+  remove(FILE_NAME1);
+  remove(FILE_NAME2);
+  CALL_OR_DIE(HT_InitBF(config->policy, config->frames));
+  CALL_OR_DIE(HT_Init());
+  CALL_OR_DIE(HT_SetPageSize(config->pageSize));
+
+  Model model1 = {NULL, NULL, 0};
+  Model model2 = {NULL, NULL, 0};
+  int indexDesc1, indexDesc2;
+  CALL_OR_DIE(HT_CreateIndex(FILE_NAME1, 1));
+  CALL_OR_DIE(HT_OpenIndex(FILE_NAME1, &indexDesc1));
+  CALL_OR_DIE(HT_CreateIndex(FILE_NAME2, 1));
+  CALL_OR_DIE(HT_OpenIndex(FILE_NAME2, &indexDesc2));
+
+  for (int i = 0; i < RECORDS_NUM; i++)
+  {
+    insertModelRecord(indexDesc1, &model1, makeRecord(i, i));
+    if (i % 3 != 2)
+      insertModelRecord(indexDesc2, &model2, makeRecord(i, i + 5));
+    if (i < DUPLICATES_NUM)
+      insertModelRecord(indexDesc1, &model1, makeRecord(DUPLICATE_ID, i));
+  }
+  checkFile(indexDesc1, &model1, RECORDS_NUM, "insert");
+  checkJoins(indexDesc1, &model1, indexDesc2, &model2, "insert");
+
+  // the files are the same after they are closed and opened again
+  CALL_OR_DIE(HT_CloseFile(indexDesc1));
+  CALL_OR_DIE(HT_OpenIndex(FILE_NAME1, &indexDesc1));
+  checkFile(indexDesc1, &model1, RECORDS_NUM, "reopen");
+
+  // every duplicate, then most of the other records
+  int ok = 1;
+  for (int i = 0; i <= DUPLICATES_NUM; i++)
+    ok &= deleteModelRecord(indexDesc1, &model1, DUPLICATE_ID);
+  for (int id = KEPT_NUM; id < RECORDS_NUM; id += 3)
+    ok &= deleteModelRecord(indexDesc1, &model1, id);
+  Record record;
+  ok &= HT_Lookup(indexDesc1, DUPLICATE_ID, &record) != HT_OK;
+  check(ok, "delete: HT_DeleteEntry");
+  checkFile(indexDesc1, &model1, RECORDS_NUM, "delete");
+  checkJoins(indexDesc1, &model1, indexDesc2, &model2, "delete");
+
+  // with only a few records left the buckets merge and the hash table halves
+  int size = indexArray[indexDesc1].hashTable.size;
+  ok = 1;
+  for (int id = KEPT_NUM; id < RECORDS_NUM; id++)
+    if (id % 3 != KEPT_NUM % 3)
+      ok &= deleteModelRecord(indexDesc1, &model1, id);
+  check(ok && indexArray[indexDesc1].hashTable.size < size, "merge: the hash table halves");
+  checkFile(indexDesc1, &model1, RECORDS_NUM, "merge");
+
+  // the freed tuple ids and blocks are used again
+  for (int id = KEPT_NUM; id < RECORDS_NUM; id++)
+    if (id != DUPLICATE_ID)
+      insertModelRecord(indexDesc1, &model1, makeRecord(id, id));
+  checkFile(indexDesc1, &model1, RECORDS_NUM, "insert again");
+  checkJoins(indexDesc1, &model1, indexDesc2, &model2, "insert again");
+
+  CALL_OR_DIE(HT_CloseFile(indexDesc1));
+  CALL_OR_DIE(HT_CloseFile(indexDesc2));
+  CALL_OR_DIE(HT_SetPageSize(BF_BLOCK_SIZE));
+  BF_Close();
+  remove(FILE_NAME1);
+  remove(FILE_NAME2);
+  free(model1.records);
+  free(model1.alive);
+  free(model2.records);
+  free(model2.alive);
+}
+
+int main(void)
+{
+  for (int c = 0; c < (int)(sizeof(configs) / sizeof(Config)); c++)
+    runChecks(&configs[c]);
+
+  printf("%s\n", failures == 0 ? "All checks passed" : "Some checks FAILED");
+  return failures == 0 ? 0 : 1;
+}
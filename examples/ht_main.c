@@ -51,9 +51,9 @@ const char *cities[] = {
 
 int main()
 {
-  BF_Init(LRU);
+  CALL_OR_DIE(HT_InitBF(LRU, BF_BUFFER_SIZE));
 
-  UpdateRecordArray update[MAX_RECORDS];
+  UpdateRecordArray update[MAX_UPDATES];
 
   CALL_OR_DIE(HT_Init());
 
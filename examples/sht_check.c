@@ -0,0 +1,436 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bf.h"
+#include "hash_file.h"
+#include "sht_file.h"
+
+#define RECORDS_NUM 2000 // records of the first pair of files, the second one gets 3/5 of them
+#define CITIES_NUM 40    // cities of the records, besides SKEWED_CITY
+#define SKEWED_CITY "Athens" // a quarter of the records of the first file, so that its tuple ids need many blocks
+#define GLOBAL_DEPT 2
+#define JOIN_BLOCKS 3 // the smallest budget of SHT_GraceJoin
+#define THREADS_N 4   // threads of SHT_ParallelInnerJoin
+#define PRIME_FILE_NAME1 "primary1.db"
+#define FILE_NAME1 "secondary1.db"
+#define PRIME_FILE_NAME2 "primary2.db"
+#define FILE_NAME2 "secondary2.db"
+#define ROWS_FILE_NAME "rows.db" // file of the block file sink
+
+const char *names[] = {
+    "Yannis",
+    "Christofos",
+    "Sofia",
+    "Marianna",
+    "Vagelis",
+    "Maria",
+    "Iosif",
+    "Dionisis",
+    "Konstantina",
+    "Theofilos",
+    "Giorgos",
+    "Dimitris"};
+
+const char *surnames[] = {
+    "Ioannidis",
+    "Svingos",
+    "Karvounari",
+    "Rezkalla",
+    "Nikolopoulos",
+    "Berreta",
+    "Koronis",
+    "Gaitanis",
+    "Oikonomou",
+    "Mailis",
+    "Michas",
+    "Halatsis"};
+
+#define CALL_OR_DIE(call)     \
+  {                           \
+    HT_ErrorCode code = call; \
+    if (code != HT_OK)        \
+    {                         \
+      printf("Error\n");      \
+      exit(code);             \
+    }                         \
+  }
+
+// a primary index with a secondary one on the city, and what they should hold: the record of every tuple id, and if it is still there
+typedef struct
+{
+  int indexDesc;
+  int sindexDesc;
+  Record *records;
+  char *alive;
+  int capacity;
+} Files;
+
+// the pairs (or the tuple ids of a key) a join (or a lookup) gave, checked against the models
+typedef struct
+{
+  Files *files1;
+  Files *files2;
+  const char *key; // the key of a lookup
+  long pairs;
+  unsigned long sum; // sum of pairHash of every pair, the same whatever the order of the pairs
+  long bad;          // pairs whose records do not exist, do not have the key, or are not the records of the files
+} JoinResult;
+
+int failures = 0;
+
+void check(int ok, const char *what)
+{
+  printf("  %-56s %s\n", what, ok ? "ok" : "FAILED");
+  if (!ok)
+    failures++;
+}
+
+unsigned long pairHash(tid tupleId1, tid tupleId2)
+{
+  unsigned long h = (unsigned long)tupleId1 * 2654435761u + (unsigned long)tupleId2;
+  h ^= h >> 29;
+  h *= 0xbf58476d1ce4e5b9ul;
+  return h ^ (h >> 32);
+}
+
+Record makeRecord(int id, int i)
+{
+  Record record;
+  memset(&record, 0, sizeof(Record));
+  record.id = id;
+  strcpy(record.name, names[i % 12]);
+  strcpy(record.surname, surnames[(i / 12) % 12]);
+  if (i % 4 == 0)
+    strcpy(record.city, SKEWED_CITY);
+  else
+    sprintf(record.city, "City%d", (i * 7) % CITIES_NUM);
+  return record;
+}
+
+int sameRecord(const Record *a, const Record *b)
+{
+  return a->id == b->id && strcmp(a->name, b->name) == 0 && strcmp(a->surname, b->surname) == 0 && strcmp(a->city, b->city) == 0;
+}
+
+int isAlive(Files *files, tid tupleId)
+{
+  return tupleId >= 0 && tupleId < files->capacity && files->alive[tupleId];
+}
+
+void openFiles(Files *files, const char *fileName, const char *sfileName)
+{
+  remove(fileName);
+  remove(sfileName);
+  memset(files, 0, sizeof(Files));
+  CALL_OR_DIE(HT_CreateIndex(fileName, GLOBAL_DEPT));
+  CALL_OR_DIE(HT_OpenIndex(fileName, &files->indexDesc));
+  CALL_OR_DIE(SHT_CreateSecondaryIndex(sfileName, "cities", strlen("cities"), GLOBAL_DEPT, (char *)fileName));
+  CALL_OR_DIE(SHT_OpenSecondaryIndex(sfileName, &files->sindexDesc));
+}
+
+void closeFiles(Files *files, const char *fileName, const char *sfileName)
+{
+  CALL_OR_DIE(SHT_CloseSecondaryIndex(files->sindexDesc));
+  CALL_OR_DIE(HT_CloseFile(files->indexDesc));
+  remove(fileName);
+  remove(sfileName);
+  free(files->records);
+  free(files->alive);
+}
+
+void insertFilesRecord(Files *files, Record record)
+{
+  UpdateRecordArray update[MAX_UPDATES];
+  SecondaryRecord secr;
+  tid tupleId;
+
+  CALL_OR_DIE(HT_InsertEntry(files->indexDesc, record, &tupleId, update));
+  secr.tupleId = tupleId;
+  memcpy(secr.index_key, record.city, sizeof(secr.index_key));
+  CALL_OR_DIE(SHT_SecondaryUpdateEntry(files->sindexDesc, update));
+  CALL_OR_DIE(SHT_SecondaryInsertEntry(files->sindexDesc, secr));
+
+  if (tupleId >= files->capacity)
+  {
+    int capacity = 2 * tupleId + 1;
+    files->records = realloc(files->records, capacity * sizeof(Record));
+    files->alive = realloc(files->alive, capacity);
+    memset(files->alive + files->capacity, 0, capacity - files->capacity);
+    files->capacity = capacity;
+  }
+  files->records[tupleId] = record;
+  files->alive[tupleId] = 1;
+}
+
+/*
+  Deletes the record with 'id' from the primary index and its tuple id from the secondary one.
+*/
+int deleteFilesRecord(Files *files, int id)
+{
+  UpdateRecordArray update[MAX_UPDATES];
+  if (HT_DeleteEntry(files->indexDesc, id, update) != HT_OK)
+    return 0;
+  tid tupleId = update[0].oldTupleId;
+  if (!isAlive(files, tupleId) || files->records[tupleId].id != id)
+    return 0;
+  if (SHT_SecondaryUpdateEntry(files->sindexDesc, update) != HT_OK)
+    return 0;
+  files->alive[tupleId] = 0;
+  return 1;
+}
+
+/*
+  The pairs of nested loops over the two models, on 'key' (all the keys if NULL).
+*/
+JoinResult expectedJoin(Files *files1, Files *files2, const char *key)
+{
+  JoinResult expected = {files1, files2, NULL, 0, 0, 0};
+  for (tid t1 = 0; t1 < files1->capacity; t1++)
+  {
+    if (!files1->alive[t1] || (key != NULL && strcmp(files1->records[t1].city, key) != 0))
+      continue;
+    for (tid t2 = 0; t2 < files2->capacity; t2++)
+      if (files2->alive[t2] && strcmp(files1->records[t1].city, files2->records[t2].city) == 0)
+      {
+        expected.pairs++;
+        expected.sum += pairHash(t1, t2);
+      }
+  }
+  return expected;
+}
+
+int sameJoin(JoinResult *result, JoinResult *expected)
+{
+  return result->bad == 0 && result->pairs == expected->pairs && result->sum == expected->sum;
+}
+
+void addJoinPair(const char *key, tid tupleId1, tid tupleId2, void *arg)
+{
+  JoinResult *result = arg;
+  result->pairs++;
+  result->sum += pairHash(tupleId1, tupleId2);
+  if (!isAlive(result->files1, tupleId1) || !isAlive(result->files2, tupleId2) ||
+      strcmp(result->files1->records[tupleId1].city, key) != 0 || strcmp(result->files2->records[tupleId2].city, key) != 0)
+    result->bad++;
+}
+
+void addJoinRow(const SHT_JoinRow *row, void *arg)
+{
+  JoinResult *result = arg;
+  addJoinPair(row->index_key, row->tupleId1, row->tupleId2, arg);
+  if (isAlive(result->files1, row->tupleId1) && isAlive(result->files2, row->tupleId2) &&
+      (!sameRecord(row->record1, &result->files1->records[row->tupleId1]) || !sameRecord(row->record2, &result->files2->records[row->tupleId2])))
+    result->bad++;
+}
+
+void addLookupTuple(tid tupleId, void *arg)
+{
+  JoinResult *result = arg;
+  result->pairs++;
+  result->sum += pairHash(tupleId, 0);
+  if (!isAlive(result->files1, tupleId) || strcmp(result->files1->records[tupleId].city, result->key) != 0)
+    result->bad++;
+}
+
+void addLookupRecord(tid tupleId, Record *record, void *arg)
+{
+  JoinResult *result = arg;
+  addLookupTuple(tupleId, arg);
+  if (isAlive(result->files1, tupleId) && !sameRecord(record, &result->files1->records[tupleId]))
+    result->bad++;
+}
+
+/*
+  SHT_Lookup and SHT_LookupRecords give the tuple ids of the model for every city and for a city no record has,
+  and SHT_BuildBloomFilter has every city.
+*/
+void verifyLookup(Files *files, const char *what)
+{
+  char key[20], message[80];
+  int lookupOk = 1, recordsOk = 1, bloomOk = 1;
+  SHT_BloomFilter filter;
+  CALL_OR_DIE(SHT_BuildBloomFilter(files->sindexDesc, SHT_BLOOM_BITS_PER_KEY, &filter));
+
+  for (int c = -1; c <= CITIES_NUM; c++)
+  {
+    if (c == -1)
+      strcpy(key, SKEWED_CITY);
+    else
+      sprintf(key, "City%d", c); // City<CITIES_NUM> has no records
+    JoinResult expected = {files, files, key, 0, 0, 0};
+    for (tid t = 0; t < files->capacity; t++)
+      if (files->alive[t] && strcmp(files->records[t].city, key) == 0)
+      {
+        expected.pairs++;
+        expected.sum += pairHash(t, 0);
+      }
+
+    JoinResult result = {files, files, key, 0, 0, 0};
+    lookupOk &= SHT_Lookup(files->sindexDesc, key, addLookupTuple, &result) == HT_OK && sameJoin(&result, &expected);
+    JoinResult records = {files, files, key, 0, 0, 0};
+    recordsOk &= SHT_LookupRecords(files->sindexDesc, key, addLookupRecord, &records) == HT_OK && sameJoin(&records, &expected);
+    if (expected.pairs > 0)
+      bloomOk &= SHT_BloomMayContain(&filter, key);
+  }
+  SHT_BloomFree(&filter);
+
+  snprintf(message, sizeof(message), "%s: SHT_Lookup", what);
+  check(lookupOk, message);
+  snprintf(message, sizeof(message), "%s: SHT_LookupRecords", what);
+  check(recordsOk, message);
+  snprintf(message, sizeof(message), "%s: SHT_BuildBloomFilter", what);
+  check(bloomOk, message);
+}
+
+/*
+  Every join method, SHT_GraceJoin, every sink and SHT_ParallelInnerJoin give the pairs of nested loops.
+*/
+void verifyJoins(Files *files1, Files *files2, const char *what)
+{
+  const char *methodNames[] = {"SHT_HASH_JOIN", "SHT_PARTITIONED_JOIN", "SHT_BLOOM_JOIN"};
+  char *keys[] = {NULL, SKEWED_CITY, "City3", "Nowhere"};
+  char message[80];
+  JoinResult all = expectedJoin(files1, files2, NULL);
+
+  for (int method = SHT_HASH_JOIN; method <= SHT_BLOOM_JOIN; method++)
+  {
+    int ok = 1;
+    for (int k = 0; k < 4; k++)
+    {
+      JoinResult expected = k == 0 ? all : expectedJoin(files1, files2, keys[k]);
+      JoinResult result = {files1, files2, NULL, 0, 0, 0};
+      ok &= SHT_InnerJoinCallback(files1->sindexDesc, files2->sindexDesc, keys[k], method, addJoinPair, &result) == HT_OK &&
+            sameJoin(&result, &expected);
+    }
+    snprintf(message, sizeof(message), "%s: %s", what, methodNames[method]);
+    check(ok, message);
+  }
+
+  int budgets[] = {JOIN_BLOCKS, getJoinMemoryMax()};
+  int ok = 1;
+  for (int b = 0; b < 2; b++)
+  {
+    JoinResult result = {files1, files2, NULL, 0, 0, 0};
+    ok &= SHT_GraceJoin(files1->sindexDesc, files2->sindexDesc, budgets[b], addJoinPair, &result) == HT_OK && sameJoin(&result, &all);
+  }
+  snprintf(message, sizeof(message), "%s: SHT_GraceJoin", what);
+  check(ok, message);
+
+  SHT_JoinSink sink;
+  CALL_OR_DIE(SHT_OpenCountSink(&sink));
+  ok = SHT_InnerJoinSink(files1->sindexDesc, files2->sindexDesc, NULL, SHT_PARTITIONED_JOIN, &sink) == HT_OK;
+  CALL_OR_DIE(SHT_CloseJoinSink(&sink));
+  snprintf(message, sizeof(message), "%s: count sink", what);
+  check(ok && sink.rows == all.pairs, message);
+
+  JoinResult result = {files1, files2, NULL, 0, 0, 0};
+  CALL_OR_DIE(SHT_OpenCallbackSink(&sink, addJoinRow, &result));
+  ok = SHT_InnerJoinSink(files1->sindexDesc, files2->sindexDesc, NULL, SHT_HASH_JOIN, &sink) == HT_OK;
+  CALL_OR_DIE(SHT_CloseJoinSink(&sink));
+  snprintf(message, sizeof(message), "%s: callback sink", what);
+  check(ok && sameJoin(&result, &all), message);
+
+  remove(ROWS_FILE_NAME);
+  JoinResult rows = {files1, files2, NULL, 0, 0, 0};
+  CALL_OR_DIE(SHT_OpenBlockFileSink(&sink, ROWS_FILE_NAME));
+  ok = SHT_InnerJoinSink(files1->sindexDesc, files2->sindexDesc, NULL, SHT_BLOOM_JOIN, &sink) == HT_OK;
+  CALL_OR_DIE(SHT_CloseJoinSink(&sink));
+  ok &= SHT_ScanJoinRowFile(ROWS_FILE_NAME, addJoinRow, &rows) == HT_OK;
+  remove(ROWS_FILE_NAME);
+  snprintf(message, sizeof(message), "%s: block file sink and SHT_ScanJoinRowFile", what);
+  check(ok && sameJoin(&rows, &all), message);
+
+  // the CSV has a header line and a line for every pair
+  FILE *csv = tmpfile();
+  CALL_OR_DIE(SHT_OpenCsvSink(&sink, csv));
+  ok = SHT_InnerJoinSink(files1->sindexDesc, files2->sindexDesc, NULL, SHT_HASH_JOIN, &sink) == HT_OK;
+  CALL_OR_DIE(SHT_CloseJoinSink(&sink));
+  fflush(csv);
+  rewind(csv);
+  long lines = 0;
+  for (int c = fgetc(csv); c != EOF; c = fgetc(csv))
+    if (c == '\n')
+      lines++;
+  fclose(csv);
+  snprintf(message, sizeof(message), "%s: CSV sink", what);
+  check(ok && lines == all.pairs + 1, message);
+
+  // the rows of every thread together are the pairs of the join, whether the sinks read the records or not
+  SHT_JoinSink sinks[THREADS_N];
+  JoinResult results[THREADS_N];
+  for (int t = 0; t < THREADS_N; t++)
+  {
+    results[t] = (JoinResult){files1, files2, NULL, 0, 0, 0};
+    CALL_OR_DIE(SHT_OpenCallbackSink(&sinks[t], addJoinRow, &results[t]));
+  }
+  ok = SHT_ParallelInnerJoin(files1->sindexDesc, files2->sindexDesc, THREADS_N, sinks) == HT_OK;
+  JoinResult parallel = {files1, files2, NULL, 0, 0, 0};
+  for (int t = 0; t < THREADS_N; t++)
+  {
+    CALL_OR_DIE(SHT_CloseJoinSink(&sinks[t]));
+    parallel.pairs += results[t].pairs;
+    parallel.sum += results[t].sum;
+    parallel.bad += results[t].bad;
+  }
+  long counted = 0;
+  for (int t = 0; t < THREADS_N; t++)
+    CALL_OR_DIE(SHT_OpenCountSink(&sinks[t]));
+  ok &= SHT_ParallelInnerJoin(files1->sindexDesc, files2->sindexDesc, THREADS_N, sinks) == HT_OK;
+  for (int t = 0; t < THREADS_N; t++)
+  {
+    CALL_OR_DIE(SHT_CloseJoinSink(&sinks[t]));
+    counted += sinks[t].rows;
+  }
+  snprintf(message, sizeof(message), "%s: SHT_ParallelInnerJoin", what);
+  check(ok && sameJoin(&parallel, &all) && counted == all.pairs, message);
+}
+
+int main(void)
+{
+  CALL_OR_DIE(HT_InitBF(LRU, BF_BUFFER_SIZE));
+  CALL_OR_DIE(HT_Init());
+  CALL_OR_DIE(SHT_Init());
+
+  Files files1, files2;
+  openFiles(&files1, PRIME_FILE_NAME1, FILE_NAME1);
+  openFiles(&files2, PRIME_FILE_NAME2, FILE_NAME2);
+  for (int i = 0; i < RECORDS_NUM; i++)
+  {
+    insertFilesRecord(&files1, makeRecord(i, i));
+    if (i % 5 < 3)
+      insertFilesRecord(&files2, makeRecord(i, i + 1));
+  }
+
+  printf("insert\n");
+  verifyLookup(&files1, "insert");
+  verifyJoins(&files1, &files2, "insert");
+  verifyJoins(&files1, &files1, "insert, self join");
+
+  // a third of the records of the first pair of files and a fifth of the second
+  int ok = 1;
+  for (int id = 0; id < RECORDS_NUM; id += 3)
+    ok &= deleteFilesRecord(&files1, id);
+  for (int id = 1; id < RECORDS_NUM; id += 5)
+    ok &= deleteFilesRecord(&files2, id);
+  printf("delete\n");
+  check(ok, "delete: HT_DeleteEntry and SHT_SecondaryUpdateEntry");
+  verifyLookup(&files1, "delete");
+  verifyLookup(&files2, "delete, second file");
+  verifyJoins(&files1, &files2, "delete");
+
+#ifdef BF_SRC
+  // the same answers from the secondary indexes mapped in memory
+  CALL_OR_DIE(SHT_MapSecondaryIndex(files1.sindexDesc));
+  CALL_OR_DIE(SHT_MapSecondaryIndex(files2.sindexDesc));
+  printf("map\n");
+  verifyLookup(&files1, "map");
+  verifyJoins(&files1, &files2, "map");
+#endif
+
+  closeFiles(&files1, PRIME_FILE_NAME1, FILE_NAME1);
+  closeFiles(&files2, PRIME_FILE_NAME2, FILE_NAME2);
+  BF_Close();
+
+  printf("%s\n", failures == 0 ? "All checks passed" : "Some checks FAILED");
+  return failures == 0 ? 0 : 1;
+}
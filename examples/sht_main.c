@@ -63,7 +63,7 @@ const char *cities[] = {
 
 int main(void)
 {
-  BF_Init(LRU);
+  CALL_OR_DIE(HT_InitBF(LRU, BF_BUFFER_SIZE));
   int indexDesc;
 
   CALL_OR_DIE(HT_Init());
@@ -78,7 +78,7 @@ int main(void)
   SecondaryRecord secr;
   Record record;
   srand(12569874);
-  UpdateRecordArray update[MAX_RECORDS];
+  UpdateRecordArray update[MAX_UPDATES];
   int r1, r2, r3;
   int sum = 0;
 
@@ -102,8 +102,9 @@ int main(void)
     secr.tupleId = tupleId;
     memcpy(secr.index_key, cities[r3], strlen(cities[r3]) + 1);
 
-    CALL_OR_DIE(SHT_SecondaryInsertEntry(sindexDesc, secr));
+    // update moved records first, the new record may have taken the old tupleId of one of them
     CALL_OR_DIE(SHT_SecondaryUpdateEntry(sindexDesc, update));
+    CALL_OR_DIE(SHT_SecondaryInsertEntry(sindexDesc, secr));
   }
 
   printf("---------------------------------\n");
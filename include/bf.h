@@ -8,6 +8,7 @@ extern "C" {
 #define BF_BLOCK_SIZE 512      /* Το μέγεθος ενός block σε bytes */
 #define BF_BUFFER_SIZE 100     /* Ο μέγιστος αριθμός block που κρατάμε στην μνήμη */
 #define BF_MAX_OPEN_FILES 100  /* Ο μέγιστος αριθμός ανοικτών αρχείων */
+#define BF_MAX_PAGE_SIZE 65536 /* Το μέγιστο μέγεθος block της BF_SetPageSize (μόνο στο src/bf.c) */
 
 typedef enum BF_ErrorCode {
   BF_OK,
@@ -23,7 +24,12 @@ typedef enum BF_ErrorCode {
 
 typedef enum ReplacementAlgorithm {
   LRU,
-  MRU
+  MRU,
+#ifdef BF_SRC
+  CLOCK, /* Μόνο στο src/bf.c: δεύτερη ευκαιρία με bit αναφοράς */
+  TWO_Q, /* Μόνο στο src/bf.c: ουρές A1in/A1out/Am, ένα σάρωμα δεν διώχνει τα συχνά block */
+  ARC    /* Μόνο στο src/bf.c: προσαρμοστική ισορροπία ανάμεσα σε πρόσφατα και συχνά block */
+#endif
 } ReplacementAlgorithm;
 
 
@@ -91,6 +97,73 @@ BF_ErrorCode BF_OpenFile(const char* filename, int *file_desc);
  */
 BF_ErrorCode BF_CloseFile(const int file_desc);
 
+/*
+ * Η συνάρτηση BF_SetPageSize αλλάζει το μέγεθος των block του ανοιχτού αρχείου
+ * file_desc σε page_size bytes (δύναμη του 2, από BF_BLOCK_SIZE έως
+ * BF_MAX_PAGE_SIZE). Το αρχείο δεν κρατά το μέγεθος αυτό, οπότε πρέπει να
+ * ξανακαλείται κάθε φορά που ανοίγει. Κανένα block του αρχείου δεν πρέπει να
+ * είναι καρφιτσωμένο. Η BF_GetPageSize επιστρέφει το μέγεθος στην μεταβλητή
+ * page_size. Υπάρχουν μόνο στο src/bf.c και δηλώνονται όταν ορίζεται το BF_SRC
+ * (make ... BF=src).
+ */
+#ifdef BF_SRC
+BF_ErrorCode BF_SetPageSize(const int file_desc, const int page_size);
+
+/*
+ * Η συνάρτηση BF_InitPool είναι η BF_Init με frames block στην μνήμη αντί για
+ * BF_BUFFER_SIZE. Υπάρχει μόνο στο src/bf.c (make ... BF=src), όπως και οι
+ * πολιτικές CLOCK, TWO_Q και ARC. Οι TWO_Q και ARC θυμούνται και όσα block
+ * διώχτηκαν πρόσφατα, ώστε ένα σάρωμα ενός αρχείου να μην διώχνει τα block που
+ * χρησιμοποιούνται συχνά (π.χ. τον κατάλογο ενός ευρετηρίου).
+ */
+BF_ErrorCode BF_InitPool(const ReplacementAlgorithm repl_alg, int frames);
+
+/*
+ * Η συνάρτηση BF_GetPoolSize επιστρέφει στην μεταβλητή frames πόσα block
+ * χωράει η μνήμη του BF, όπως ορίστηκε από την BF_Init ή την BF_InitPool.
+ * Υπάρχει μόνο στο src/bf.c (BF_SRC).
+ */
+BF_ErrorCode BF_GetPoolSize(int *frames);
+
+BF_ErrorCode BF_GetPageSize(const int file_desc, int *page_size);
+
+/*
+ * Η συνάρτηση BF_MapFile απεικονίζει (mmap) ολόκληρο το ανοιχτό αρχείο
+ * file_desc στη μνήμη. Από εκεί και πέρα η BF_GetBlock δίνει δείκτη μέσα στην
+ * απεικόνιση, χωρίς ανάγνωση από το δίσκο και χωρίς αντιγραφή σε σελίδα της
+ * μνήμης του BF, η BF_AllocateBlock μεγαλώνει το αρχείο (ftruncate) και την
+ * απεικόνιση (mremap), και η BF_CloseFile γράφει τις αλλαγές στο δίσκο (msync).
+ * Τα blocks του αρχείου δεν πιάνουν θέσεις της μνήμης του BF, και η απεικόνιση
+ * ισχύει ως το κλείσιμο του αρχείου. Κανένα block του αρχείου δεν πρέπει να είναι
+ * καρφιτσωμένο. Υπάρχει μόνο στο src/bf.c (BF_SRC).
+ */
+BF_ErrorCode BF_MapFile(const int file_desc);
+
+/*
+ * Η συνάρτηση BF_Prefetch ζητά να αρχίσει στο παρασκήνιο η ανάγνωση των n blocks
+ * του πίνακα block_nums του ανοιχτού αρχείου file_desc, ώστε οι BF_GetBlock που
+ * ακολουθούν να τα βρίσκουν στη μνήμη του λειτουργικού (posix_fadvise, ή madvise
+ * για αρχείο της BF_MapFile). Τα blocks που είναι ήδη στη μνήμη του BF ή δεν
+ * υπάρχουν αγνοούνται, και τα διαδοχικά blocks ζητούνται μαζί. Η κλήση δεν
+ * καρφιτσώνει τίποτα και δεν περιμένει την ανάγνωση. Υπάρχει μόνο στο src/bf.c
+ * (BF_SRC).
+ */
+BF_ErrorCode BF_Prefetch(const int file_desc, const int *block_nums, const int n);
+
+/*
+ * Η συνάρτηση BF_GetBlocks καρφιτσώνει με μία κλήση τα n blocks του πίνακα
+ * block_nums του ανοιχτού αρχείου file_desc στα blocks[0..n-1], όπως n κλήσεις
+ * της BF_GetBlock. Τα blocks που είναι ήδη στη μνήμη καρφιτσώνονται πρώτα, και
+ * τα υπόλοιπα διαβάζονται κατά σειρά αρχείου, κάθε σειρά διαδοχικών blocks με
+ * μία ανάγνωση (preadv). Αν αποτύχει, δεν μένει καρφιτσωμένο κανένα από τα
+ * blocks. Η BF_UnpinBlocks ξεκαρφιτσώνει τα n blocks του πίνακα blocks, όπως n
+ * κλήσεις της BF_UnpinBlock. Υπάρχουν μόνο στο src/bf.c (BF_SRC).
+ */
+BF_ErrorCode BF_GetBlocks(const int file_desc, const int *block_nums, const int n, BF_Block **blocks);
+
+BF_ErrorCode BF_UnpinBlocks(BF_Block **blocks, const int n);
+#endif
+
 /*
  * Η συνάρτηση Get_BlockCounter δέχεται ως όρισμα τον αναγνωριστικό αριθμό
  * file_desc ενός ανοιχτού αρχείου από block και βρίσκει τον αριθμό των
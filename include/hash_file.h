@@ -11,25 +11,53 @@ typedef struct
 	char surname[20];
 	char city[20];
 	int oldTupleId; // η παλια θέση της εγγραφής πριν την εισαγωγή της νέας
-	int newTupleId; // η νέα θέση της εγγραφής που μετακινήθηκε μετα την εισαγωγή της νέας εγγραφής
+	int newTupleId; // η νέα θέση της εγγραφής που μετακινήθηκε μετα την εισαγωγή της νέας εγγραφής (-1 αν η εγγραφή διαγράφηκε)
 
 } UpdateRecordArray;
 
+// Μια αλλαγή tuple id σε συμπαγή μορφή: αντί για τα αλφαριθμητικά των κλειδιών κρατά μόνο την τιμή κατακερματισμού τους
 typedef struct
 {
-	int fd;
-	int used;
-	char filename[MAX_NAME_LEN];
-} IndexNode;
+	unsigned int cityHash;	  // hashString(city)
+	unsigned int surnameHash; // hashString(surname)
+	tid oldTupleId;			  // το tuple id πριν την αλλαγή
+	tid newTupleId;			  // το νέο tuple id (-1 αν η εγγραφή διαγράφηκε)
+} TupleDelta;
 
-IndexNode indexArray[MAX_OPEN_FILES];
+// Το πρώτο block του αρχείου (πρωτεύοντος ή δευτερεύοντος)
+typedef struct
+{
+	int depth;		// το ολικό βάθος
+	int free_block; // το πρώτο ελεύθερο block, κάθε ελεύθερο block κρατά στην αρχή του το επόμενο (-1 αν δεν υπάρχει)
+	int tid_map;	// το πρώτο block του πίνακα των tuple ids (-1 αν δεν υπάρχει)
+	int page_size;	// το μέγεθος των block του αρχείου σε bytes (HT_SetPageSize)
+} InfoHeader;
 
 typedef struct
 {
 	int size;
-	int local_depth;
+	int local_depth; // το τοπικό βάθος του κάδου (ισχύει μόνο στο πρώτο block του)
+	int next_block;	 // το επόμενο block υπερχείλισης του κάδου (-1 αν δεν υπάρχει)
 } DataHeader;
 
+typedef struct
+{
+	int size;		 // πλήθος τιμών κατακερματισμού σε αυτό το block
+	int next_hblock; // το επόμενο block του ευρετηρίου (-1 αν είναι το τελευταίο)
+} HashHeader;
+
+// Η τιμή κατακερματισμού i αντιστοιχεί στη θέση i του ευρετηρίου, οπότε αποθηκεύεται μόνο το block
+typedef struct
+{
+	int block_num;
+} HashNode;
+
+typedef struct
+{
+	int size;		// πλήθος tuple ids σε αυτό το block
+	int next_block; // το επόμενο block του πίνακα των tuple ids (-1 αν είναι το τελευταίο)
+} TidMapHeader;
+
 typedef enum HT_ErrorCode
 {
 	HT_OK,
@@ -46,15 +74,125 @@ typedef struct Record
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-#define MAX_RECORDS ((BF_BLOCK_SIZE - sizeof(DataHeader)) / sizeof(Record))
-#define MAX_HNODES ((BF_BLOCK_SIZE - sizeof(HashHeader)) / sizeof(HashNode))
+// Πόσα στοιχεία χωράνε σε ένα block μεγέθους pageSize (το page_size του αρχείου, getPageSize)
+#define MAX_RECORDS(pageSize) (((pageSize) - sizeof(DataHeader)) / sizeof(Record))
+#define MAX_HNODES(pageSize) (((pageSize) - sizeof(HashHeader)) / sizeof(HashNode))
+#define MAX_TID_SLOTS(pageSize) (((pageSize) - sizeof(TidMapHeader)) / sizeof(tid))
+#define MAX_UPDATES MAX_RECORDS(BF_MAX_PAGE_SIZE) /* θέσεις ενός updateArray, για αρχεία με οποιοδήποτε μέγεθος block */
+#define PIN_WINDOW 8 /* πόσα blocks καρφιτσώνουν μαζί (pinEntries) οι HT_InsertBatch και HT_FetchRecords */
+#define HT_MAX_DEPTH 24 /* το μέγιστο ολικό βάθος, πέρα από αυτό οι κάδοι παίρνουν blocks υπερχείλισης αντί να σπάνε */
 
 typedef struct
 {
 	DataHeader header;
-	Record record[MAX_RECORDS];
+	Record record[]; // MAX_RECORDS(page_size)
 } Entry;
 
+typedef struct
+{
+	HashHeader header;
+	HashNode hashNode[]; // MAX_HNODES(page_size)
+} HashEntry;
+
+typedef struct
+{
+	TidMapHeader header;
+	tid slot[]; // MAX_TID_SLOTS(page_size)
+} TidMapEntry;
+
+// Το ευρετήριο στη μνήμη. Στο δίσκο είναι αλυσίδα από HashEntry blocks με αρχή το block 1.
+typedef struct
+{
+	int size;			// πλήθος τιμών κατακερματισμού (2^depth)
+	HashNode *hashNode; // όλες οι τιμές κατακερματισμού, με τη σειρά
+	int pagesN;			// πλήθος blocks του ευρετηρίου στο δίσκο
+	int *pages;			// block_num κάθε block του ευρετηρίου, με τη σειρά της αλυσίδας
+	char *dirtyPages;	// 1 για κάθε block του ευρετηρίου που πρέπει να ξαναγραφτεί
+	int nodesN;			// τιμές κατακερματισμού ανά block του ευρετηρίου (MAX_HNODES του αρχείου)
+} HashTable;
+
+// Ο πίνακας των tuple ids στη μνήμη. Το tuple id μιας εγγραφής δεν αλλάζει όταν η εγγραφή μετακινείται (σπάσιμο ή ένωση κάδων),
+// αλλάζει μόνο η θέση της στον πίνακα. Στο δίσκο είναι αλυσίδα από TidMapEntry blocks με αρχή το InfoHeader.tid_map.
+typedef struct
+{
+	int size;		  // πλήθος tuple ids που έχουν δοθεί
+	int capacity;	  // θέσεις των slot και freeTids
+	tid *slot;		  // για κάθε tuple id, η θέση της εγγραφής του (getTid(block, index, recordsN)) ή -1 αν έχει διαγραφεί
+	int freeN;		  // πλήθος tuple ids διαγραμμένων εγγραφών, που θα ξαναδοθούν
+	tid *freeTids;	  // τα tuple ids διαγραμμένων εγγραφών
+	int ownerN;		  // θέσεις του owner
+	tid *owner;		  // για κάθε θέση getTid(block, index, recordsN), το tuple id της εγγραφής που βρίσκεται εκεί ή -1
+	int pagesN;		  // πλήθος blocks του πίνακα στο δίσκο
+	int *pages;		  // block_num κάθε block του πίνακα, με τη σειρά της αλυσίδας
+	char *dirtyPages; // 1 για κάθε block του πίνακα που πρέπει να ξαναγραφτεί
+	int slotsN;		  // tuple ids ανά block του πίνακα (MAX_TID_SLOTS του αρχείου)
+	int recordsN;	  // εγγραφές ανά κάδο (MAX_RECORDS του αρχείου), οι θέσεις είναι getTid(block, index, recordsN)
+} TidMap;
+
+typedef struct
+{
+	int fd;
+	int used;
+	char filename[MAX_NAME_LEN];
+	int depth;			 // το ολικό βάθος, όπως φορτώθηκε στην HT_OpenIndex
+	HashTable hashTable; // αντίγραφο του ευρετηρίου στη μνήμη
+	TidMap tidMap;		 // αντίγραφο του πίνακα των tuple ids στη μνήμη
+	int dirty;			 // 1 αν depth/hashTable/tidMap έχουν αλλάξει και δεν έχουν γραφτεί στο δίσκο
+} IndexNode;
+
+extern IndexNode indexArray[MAX_OPEN_FILES];
+extern int htPageSize; // το μέγεθος block των αρχείων που δημιουργούνται (HT_SetPageSize)
+
+// Κέρσορας που διατρέχει όλες τις εγγραφές ενός ανοιχτού αρχείου, έναν κάδο τη φορά (HT_ScanOpen, HT_ScanNext, HT_ScanClose)
+typedef struct
+{
+	int indexDesc;	 // θέση του αρχείου στον πίνακα με τα ανοιχτά αρχεία
+	int value;		 // η πρώτη τιμή κατακερματισμού του τρέχοντος κάδου
+	int block_num;	 // το block του τρέχοντος κάδου (ή της αλυσίδας υπερχείλισής του)
+	int local_depth; // το τοπικό βάθος του τρέχοντος κάδου
+	int index;		 // η επόμενη εγγραφή του τρέχοντος block
+	BF_Block *block; // ο τρέχων κάδος μένει καρφιτσωμένος όσο διαβάζονται οι εγγραφές του
+	Entry *entry;	 // τα δεδομένα του τρέχοντος κάδου (NULL αν δεν έχει φορτωθεί κάδος)
+} HT_Scan;
+
+// Μια εγγραφή μιας διαμέρισης της grace hash join: το κλειδί της ζεύξης ως αλφαριθμητικό και το tuple id
+typedef struct
+{
+	char key[20];
+	tid tupleId;
+} JoinTuple;
+
+typedef struct
+{
+	int size;		// πλήθος εγγραφών σε αυτό το block
+	int next_block; // το επόμενο block της ίδιας διαμέρισης (-1 αν είναι το τελευταίο)
+} JoinPageHeader;
+
+#define MAX_JOIN_TUPLES ((BF_BLOCK_SIZE - sizeof(JoinPageHeader)) / sizeof(JoinTuple))
+#define JOIN_MAX_LEVEL 4 /* πόσες φορές μπορεί να ξαναμοιραστεί μια διαμέριση που δεν χωράει στη μνήμη */
+
+typedef struct
+{
+	JoinPageHeader header;
+	JoinTuple tuple[MAX_JOIN_TUPLES];
+} JoinPage;
+
+// Οι διαμερίσεις της μιας πλευράς μιας grace hash join, σε ένα προσωρινό αρχείο: κάθε διαμέριση είναι αλυσίδα από JoinPage blocks
+typedef struct
+{
+	char filename[MAX_NAME_LEN];
+	int fd;
+	int n;			  // πλήθος διαμερίσεων
+	int level;		  // 0 για τις αρχικές διαμερίσεις, +1 κάθε φορά που μια διαμέριση ξαναμοιράζεται (joinHash)
+	int *first;		  // το πρώτο block κάθε διαμέρισης (-1 αν είναι άδεια)
+	int *count;		  // πλήθος εγγραφών κάθε διαμέρισης
+	BF_Block **block; // το τελευταίο block κάθε διαμέρισης μένει καρφιτσωμένο όσο γεμίζει
+	JoinPage **page;  // τα δεδομένα του τελευταίου block κάθε διαμέρισης (NULL αν δεν είναι καρφιτσωμένο)
+} JoinPartitions;
+
+/* Καλείται από τις συναρτήσεις ζεύξης μία φορά για κάθε ζεύγος, με το κλειδί και τα tupleIds της πρώτης και της δεύτερης πλευράς. */
+typedef void (*HT_JoinCallback)(const char *key, tid tupleId1, tid tupleId2, void *arg);
+
 #define CALL_OR_DIE(call)         \
 	{                             \
 		HT_ErrorCode code = call; \
@@ -73,15 +211,54 @@ typedef struct
  */
 HT_ErrorCode HT_Init();
 
+/*
+ * Η συνάρτηση HT_SetPageSize ορίζει το μέγεθος block (pageSize bytes, δύναμη του 2 από BF_BLOCK_SIZE έως BF_MAX_PAGE_SIZE)
+ * των αρχείων που θα δημιουργηθούν από εδώ και πέρα (HT_CreateIndex, HT_BulkCreateIndex, SHT_CreateSecondaryIndex, SHT_BulkCreateIndexes).
+ * Το μέγεθος αποθηκεύεται στο πρώτο block κάθε αρχείου, και οι κάδοι, το ευρετήριο και ο πίνακας των tuple ids χωράνε τόσα
+ * στοιχεία όσα επιτρέπει αυτό. Μεγαλύτερο μέγεθος από BF_BLOCK_SIZE χρειάζεται το επίπεδο BF του src/bf.c (make ... BF=src).
+ * Σε περίπτωση που εκτελεστεί επιτυχώς επιστρέφεται HT_OK, ενώ σε διαφορετική περίπτωση κωδικός λάθους.
+ */
+HT_ErrorCode HT_SetPageSize(
+	int pageSize /* μέγεθος block σε bytes */
+);
+
+/*
+ * Η συνάρτηση HT_InitBF αρχικοποιεί το επίπεδο BF για τα ευρετήρια με την πολιτική repl_alg και frames block στην μνήμη.
+ * Με τη lib/libbf.so δέχεται μόνο τις LRU και MRU και BF_BUFFER_SIZE block, ενώ οι CLOCK, TWO_Q, ARC και άλλο πλήθος
+ * block χρειάζονται το επίπεδο BF του src/bf.c (make ... BF=src).
+ * Σε περίπτωση που εκτελεστεί επιτυχώς επιστρέφεται HT_OK, ενώ σε διαφορετική περίπτωση κωδικός λάθους.
+ */
+HT_ErrorCode HT_InitBF(
+	const ReplacementAlgorithm repl_alg, /* πολιτική αντικατάστασης block */
+	int frames							 /* πλήθος block στην μνήμη */
+);
+
 /*
  * Η συνάρτηση HT_CreateIndex χρησιμοποιείται για τη δημιουργία και κατάλληλη αρχικοποίηση ενός άδειου αρχείου κατακερματισμού με όνομα fileName.
- * Στην περίπτωση που το αρχείο υπάρχει ήδη, τότε επιστρέφεται ένας κωδικός λάθους.
+ * Στην περίπτωση που το αρχείο υπάρχει ήδη, ή το depth είναι μεγαλύτερο από HT_MAX_DEPTH, τότε επιστρέφεται ένας κωδικός λάθους.
  * Σε περίπτωση που εκτελεστεί επιτυχώς επιστρέφεται HΤ_OK, ενώ σε διαφορετική περίπτωση κωδικός λάθους.
  */
 HT_ErrorCode HT_CreateIndex(
 	const char *fileName, /* όνομααρχείου */
 	int depth);
 
+/*
+ * Η συνάρτηση HT_BulkCreateIndex δημιουργεί ένα αρχείο κατακερματισμού με όνομα fileName που περιέχει ήδη τις n εγγραφές του records.
+ * Οι εγγραφές ταξινομούνται ανά τιμή κατακερματισμού και το ολικό βάθος (τουλάχιστον depth) επιλέγεται από την αρχή,
+ * οπότε κάθε κάδος γράφεται μία φορά, με τη σειρά, χωρίς σπασίματα κάδων. Οι εγγραφές ενός κάδου που δεν χωρίζονται (ίδια τιμή
+ * κατακερματισμού, ή τοπικό βάθος HT_MAX_DEPTH) γράφονται σε αλυσίδα από μπλοκ υπερχείλισης, όπως στην HT_InsertEntry.
+ * Η εγγραφή records[i] παίρνει tuple id i, και αν το tupleIds δεν είναι NULL, το i επιστρέφεται στη θέση i του.
+ * Το αρχείο δεν μένει ανοιχτό, ανοίγεται με την HT_OpenIndex.
+ * Σε περίπτωση που εκτελεστεί επιτυχώς, επιστρέφεται HT_OK, ενώ σε διαφορετική περίπτωση κωδικός λάθους.
+ */
+HT_ErrorCode HT_BulkCreateIndex(
+	const char *fileName, /* όνομα αρχείου */
+	int depth,			  /* ελάχιστο ολικό βάθος ευρετηρίου επεκτατού κατακερματισμού */
+	Record *records,	  /* οι εγγραφές του αρχείου */
+	int n,				  /* πλήθος εγγραφών */
+	tid *tupleIds		  /* τα tuple ids των εγγραφών (n θέσεις ή NULL) */
+);
+
 /*
  * Η ρουτίνα αυτή ανοίγει το αρχείο με όνομα fileName.
  * Εάν το αρχείο ανοιχτεί κανονικά, η ρουτίνα επιστρέφει HT_OK, ενώ σε διαφορετική περίπτωση κωδικός λάθους.
@@ -100,16 +277,146 @@ HT_ErrorCode HT_CloseFile(
 	int indexDesc /* θέση στον πίνακα με τα ανοιχτά αρχεία */
 );
 
+/*
+ * Η ρουτίνα αυτή γράφει στο δίσκο το ολικό βάθος και το ευρετήριο που κρατούνται στη μνήμη για το αρχείο
+ * στη θέση indexDesc, εφόσον έχουν αλλάξει. Καλείται αυτόματα από την HT_CloseFile.
+ * Σε περίπτωση που εκτελεστεί επιτυχώς επιστρέφεται HT_OK, ενώ σε διαφορετική περίπτωση κωδικός λάθους.
+ */
+HT_ErrorCode HT_SyncIndex(
+	int indexDesc /* θέση στον πίνακα με τα ανοιχτά αρχεία */
+);
+
 /*
  * Η συνάρτηση HT_InsertEntry χρησιμοποιείται για την εισαγωγή μίας εγγραφής στο αρχείο κατακερματισμού.
  * Οι πληροφορίες που αφορούν το αρχείο βρίσκονται στον πίνακα ανοιχτών αρχείων, ενώ η εγγραφή προς εισαγωγή προσδιορίζεται από τη δομή record.
+ * Το tuple id της εγγραφής δεν αλλάζει όταν σπάνε κάδοι (αλλάζει μόνο ο πίνακας των tuple ids), οπότε το updateArray επιστρέφεται πάντα άδειο.
  * Σε περίπτωση που εκτελεστεί επιτυχώς επιστρέφεται HT_OK, ενώ σε διαφορετική περίπτωση κάποιος κωδικός λάθους.
  */
 HT_ErrorCode HT_InsertEntry(
 	int indexDesc,				   /* θέση στον πίνακα με τα ανοιχτά αρχεία */
 	Record record,				   /* δομή που προσδιορίζει την εγγραφή */
 	tid *tupleId,				   /* το tuple id της καινούργιας εγγραφής*/
-	UpdateRecordArray *updateArray /* πίνακας με τις αλλαγές */
+	UpdateRecordArray *updateArray /* πίνακας με τις αλλαγές (MAX_UPDATES θέσεις) */
+);
+
+/*
+ * Η συνάρτηση HT_InsertBatch χρησιμοποιείται για την εισαγωγή n εγγραφών μαζί στο αρχείο κατακερματισμού.
+ * Οι εγγραφές ομαδοποιούνται ανά κάδο, ώστε κάθε κάδος να διαβάζεται και να γράφεται μία φορά για όλες τις εγγραφές του.
+ * Στη θέση i του tupleIds επιστρέφεται το tuple id της εγγραφής records[i].
+ * Τα tuple ids δεν αλλάζουν όταν σπάνε κάδοι, οπότε δεν υπάρχουν μετακινήσεις για το δευτερεύον ευρετήριο:
+ * το updates επιστρέφεται NULL και το updatesN 0 (το free(updates) από τον καλούντα παραμένει σωστό).
+ * Σε περίπτωση που εκτελεστεί επιτυχώς επιστρέφεται HT_OK, ενώ σε διαφορετική περίπτωση κάποιος κωδικός λάθους.
+ */
+HT_ErrorCode HT_InsertBatch(
+	int indexDesc,				   /* θέση στον πίνακα με τα ανοιχτά αρχεία */
+	Record *records,			   /* οι εγγραφές προς εισαγωγή */
+	int n,						   /* πλήθος εγγραφών */
+	tid *tupleIds,				   /* τα tuple ids των καινούργιων εγγραφών (n θέσεις) */
+	UpdateRecordArray **updates,   /* πίνακας με τις αλλαγές των υπαρχουσών εγγραφών */
+	int *updatesN				   /* πλήθος αλλαγών στο updates */
+);
+
+/*
+ * Η συνάρτηση HT_DeleteEntry χρησιμοποιείται για τη διαγραφή μίας εγγραφής με record.id ίσο με id από το αρχείο κατακερματισμού.
+ * Η τελευταία εγγραφή του κάδου παίρνει τη θέση της (το tuple id της δεν αλλάζει), και αν ο κάδος χωράει μαζί με τον γειτονικό του κάδο (ίδιο τοπικό βάθος)
+ * σε ένα block, οι δύο κάδοι ενώνονται και το block που αδειάζει επαναχρησιμοποιείται. Όταν κανένας κάδος δεν έχει τοπικό βάθος
+ * ίσο με το ολικό, το ευρετήριο υποδιπλασιάζεται.
+ * Στο updateArray[0] επιστρέφεται η διαγραμμένη εγγραφή με newTupleId -1, ώστε να δοθεί όπως είναι στην SHT_SecondaryUpdateEntry.
+ * Το tuple id της διαγραμμένης εγγραφής μπορεί να δοθεί ξανά σε επόμενη εισαγωγή.
+ * Σε περίπτωση που εκτελεστεί επιτυχώς επιστρέφεται HT_OK, ενώ σε διαφορετική περίπτωση (π.χ. δεν υπάρχει εγγραφή με αυτό το id) κάποιος κωδικός λάθους.
+ */
+HT_ErrorCode HT_DeleteEntry(
+	int indexDesc,				   /* θέση στον πίνακα με τα ανοιχτά αρχεία */
+	int id,						   /* τιμή του πεδίου κλειδιού της εγγραφής προς διαγραφή */
+	UpdateRecordArray *updateArray /* πίνακας με τις αλλαγές (MAX_UPDATES θέσεις) */
+);
+
+/*
+ * Οι HT_InsertEntryDelta και HT_DeleteEntryDelta κάνουν ό,τι οι HT_InsertEntry και HT_DeleteEntry, αλλά επιστρέφουν μόνο τις εγγραφές
+ * που άλλαξε το tuple id τους, στις πρώτες deltasN θέσεις του deltas (MAX_UPDATES θέσεις), χωρίς να αγγίζουν τις υπόλοιπες.
+ * Μια εισαγωγή δεν αλλάζει tuple ids, οπότε η HT_InsertEntryDelta δεν έχει deltas και επιστρέφει πάντα deltasN 0,
+ * και μια διαγραφή επιστρέφει μόνο τη διαγραμμένη εγγραφή.
+ * Το deltas δίνεται όπως είναι στην SHT_SecondaryApplyDeltas.
+ * Σε περίπτωση που εκτελεστούν επιτυχώς επιστρέφεται HT_OK, ενώ σε διαφορετική περίπτωση κάποιος κωδικός λάθους.
+ */
+HT_ErrorCode HT_InsertEntryDelta(
+	int indexDesc,		/* θέση στον πίνακα με τα ανοιχτά αρχεία */
+	Record record,		/* δομή που προσδιορίζει την εγγραφή */
+	tid *tupleId,		/* το tuple id της καινούργιας εγγραφής*/
+	int *deltasN		/* πλήθος αλλαγών (πάντα 0) */
+);
+
+HT_ErrorCode HT_DeleteEntryDelta(
+	int indexDesc,		/* θέση στον πίνακα με τα ανοιχτά αρχεία */
+	int id,				/* τιμή του πεδίου κλειδιού της εγγραφής προς διαγραφή */
+	TupleDelta *deltas, /* οι αλλαγές των tuple ids */
+	int *deltasN		/* πλήθος αλλαγών */
+);
+
+/*
+ * Η συνάρτηση HT_Lookup αντιγράφει στο out την εγγραφή με record.id ίσο με id, χωρίς να τυπώνει τίποτα.
+ * Αν υπάρχουν περισσότερες εγγραφές με αυτό το id, επιστρέφεται η πρώτη του κάδου.
+ * Επιστρέφεται HT_OK αν βρεθεί η εγγραφή, ενώ HT_ERROR αν δεν υπάρχει (χωρίς μήνυμα) ή αν το αρχείο είναι κλειστό.
+ */
+HT_ErrorCode HT_Lookup(
+	int indexDesc, /* θέση στον πίνακα με τα ανοιχτά αρχεία */
+	int id,		   /* τιμή του πεδίου κλειδιού προς αναζήτηση */
+	Record *out	   /* η εγγραφή που βρέθηκε */
+);
+
+/*
+ * Η συνάρτηση HT_FetchRecords αντιγράφει στο records[i] την εγγραφή με tuple id tupleIds[i], για κάθε i < n.
+ * Τα tuple ids ταξινομούνται ανά block, οπότε κάθε block του αρχείου διαβάζεται μία φορά και με τη σειρά του αρχείου,
+ * όσες εγγραφές του κι αν ζητούνται. Ένα tuple id μπορεί να εμφανίζεται περισσότερες από μία φορές.
+ * Σε περίπτωση που εκτελεστεί επιτυχώς επιστρέφεται HT_OK, ενώ αν κάποιο tuple id δεν υπάρχει ή το αρχείο είναι κλειστό HT_ERROR.
+ */
+HT_ErrorCode HT_FetchRecords(
+	int indexDesc,		  /* θέση στον πίνακα με τα ανοιχτά αρχεία */
+	const tid *tupleIds, /* τα tuple ids των εγγραφών */
+	int n,				  /* πλήθος tuple ids */
+	Record *records		  /* n θέσεις, για τις εγγραφές με τη σειρά των tupleIds */
+);
+
+/*
+ * Οι συναρτήσεις HT_ScanOpen, HT_ScanNext και HT_ScanClose διατρέχουν όλες τις εγγραφές του αρχείου στη θέση indexDesc.
+ * Κάθε κάδος διαβάζεται μία φορά, όσες τιμές κατακερματισμού κι αν δείχνουν σε αυτόν.
+ * Η HT_ScanNext αντιγράφει στο record την επόμενη εγγραφή και στο tupleId το tuple id της. Όταν δεν υπάρχουν άλλες εγγραφές, το tupleId γίνεται -1.
+ * Το αρχείο δεν πρέπει να αλλάζει (εισαγωγές, διαγραφές) όσο ο κέρσορας είναι ανοιχτός, και η HT_ScanClose πρέπει να καλείται πάντα.
+ * Σε περίπτωση που εκτελεστούν επιτυχώς επιστρέφεται HT_OK, ενώ σε διαφορετική περίπτωση κάποιος κωδικός λάθους.
+ */
+HT_ErrorCode HT_ScanOpen(
+	int indexDesc, /* θέση στον πίνακα με τα ανοιχτά αρχεία */
+	HT_Scan *scan  /* ο κέρσορας που αρχικοποιείται */
+);
+
+HT_ErrorCode HT_ScanNext(
+	HT_Scan *scan,	/* ανοιχτός κέρσορας */
+	Record *record, /* η επόμενη εγγραφή */
+	tid *tupleId	/* το tuple id της εγγραφής (-1 στο τέλος της σάρωσης) */
+);
+
+HT_ErrorCode HT_ScanClose(
+	HT_Scan *scan /* ανοιχτός κέρσορας */
+);
+
+/*
+ * Η συνάρτηση HT_GraceJoin κάνει ζεύξη των εγγραφών δύο ανοιχτών αρχείων στο πεδίο field ("id", "name", "surname" ή "city")
+ * και καλεί την callback για κάθε ζεύγος. Είναι grace hash join: οι εγγραφές και των δύο αρχείων διαβάζονται μία φορά και
+ * μοιράζονται σε διαμερίσεις σε δύο προσωρινά αρχεία μέσω του BF, και μετά κάθε ζεύγος διαμερίσεων ενώνεται στη μνήμη.
+ * Η ζεύξη χρησιμοποιεί το πολύ memoryBlocks blocks του BF (από 3 έως τα μισά blocks της μνήμης του BF, BF_BUFFER_SIZE / 2
+ * ή frames / 2 της BF_InitPool). Ένα ζεύγος διαμερίσεων που δεν χωράει στη μνήμη ξαναμοιράζεται με άλλη συνάρτηση
+ * κατακερματισμού (έως JOIN_MAX_LEVEL φορές), οπότε κάθε εγγραφή διαβάζεται λίγες φορές όσο μεγάλα κι αν είναι τα αρχεία.
+ * Μόνο μια διαμέριση που δεν μπορεί να μοιραστεί άλλο (π.χ. ένα κλειδί σε πολλές εγγραφές) ενώνεται τμηματικά.
+ * Τα αρχεία δεν πρέπει να αλλάζουν όσο γίνεται η ζεύξη.
+ * Σε περίπτωση που εκτελεστεί επιτυχώς επιστρέφεται HT_OK, ενώ σε διαφορετική περίπτωση κάποιος κωδικός λάθους.
+ */
+HT_ErrorCode HT_GraceJoin(
+	int indexDesc1,			  /* θέση στον πίνακα με τα ανοιχτά αρχεία του πρώτου αρχείου */
+	int indexDesc2,			  /* θέση στον πίνακα με τα ανοιχτά αρχεία του δεύτερου αρχείου */
+	const char *field,		  /* το πεδίο του Record πάνω στο οποίο γίνεται η ζεύξη */
+	int memoryBlocks,		  /* πόσα blocks του BF μπορεί να χρησιμοποιήσει η ζεύξη */
+	HT_JoinCallback callback, /* συνάρτηση που καλείται για κάθε ζεύγος */
+	void *arg				  /* παράμετρος που δίνεται σε κάθε κλήση της callback */
 );
 
 /*
@@ -124,22 +431,57 @@ HT_ErrorCode HT_PrintAllEntries(
 
 /*
  * Η συνάρτηση HashStatistics χρησιμοποιείται για την εκτύπωση στατιστικών στοιχείων
+ * Αν το αρχείο είναι ήδη ανοιχτό, διαβάζεται ο κατάλογος της μνήμης του, που μπορεί να μην έχει γραφτεί ακόμη στο δίσκο.
  */
 HT_ErrorCode HashStatistics(
 	char *filename);
 
 // Utility functions
 unsigned int hashFunction(int, int);
+unsigned int hashString(const char *);
+unsigned int joinHash(const char *, int);
 
-tid getTid(int, int);
+tid getTid(int, int, int);
+int getPageSize(int);
+HT_ErrorCode setPageSize(int, int);
+HT_ErrorCode loadPageSize(int, BF_Block *);
+void prefetchBlocks(int, int *, int);
+void prefetchBuckets(int, HashTable *);
 
 HT_ErrorCode getNewBlock(int, BF_Block *, int *);
+HT_ErrorCode allocateBlock(int, BF_Block *, int *);
+HT_ErrorCode freeBlock(int, BF_Block *, int);
 HT_ErrorCode getDepth(int, BF_Block *, int *);
 HT_ErrorCode setDepth(int, BF_Block *, int);
-HT_ErrorCode getEntry(int, BF_Block *, int, Entry *);
+HT_ErrorCode getHashTable(int, BF_Block *, HashTable *);
+HT_ErrorCode setHashTable(int, BF_Block *, HashTable *);
+void freeHashTable(HashTable *);
+HT_ErrorCode getTidMap(int, BF_Block *, TidMap *);
+HT_ErrorCode setTidMap(int, BF_Block *, TidMap *);
+void freeTidMap(TidMap *);
+tid getTidSlot(IndexNode *, tid);
+HT_ErrorCode pinEntry(int, BF_Block *, int, Entry **);
+HT_ErrorCode pinNewEntry(int, BF_Block *, int *, Entry **);
+HT_ErrorCode unpinPage(BF_Block *, int);
+HT_ErrorCode pinEntries(int, BF_Block **, int *, int, Entry **);
+HT_ErrorCode unpinPages(BF_Block **, int, int *);
+
+int getJoinMemoryMax(void);
+HT_ErrorCode checkGraceJoin(int, int, const char *, int);
+HT_ErrorCode getRecordKey(Record *, const char *, char *);
+int getJoinPartitionsN(int, int);
+HT_ErrorCode openJoinPartitions(JoinPartitions *, int, int, int);
+HT_ErrorCode addJoinTuple(JoinPartitions *, const char *, tid);
+HT_ErrorCode flushJoinPartitions(JoinPartitions *);
+HT_ErrorCode joinPartition(JoinPartitions *, JoinPartitions *, int, int, int, HT_JoinCallback, void *);
+HT_ErrorCode repartitionJoinPartition(JoinPartitions *, int, JoinPartitions *);
+HT_ErrorCode joinPartitionPair(JoinPartitions *, JoinPartitions *, int, int, HT_JoinCallback, void *);
+HT_ErrorCode joinPartitions(JoinPartitions *, JoinPartitions *, int, HT_JoinCallback, void *);
+HT_ErrorCode partitionRecords(int, const char *, JoinPartitions *);
+HT_ErrorCode closeJoinPartitions(JoinPartitions *);
 
-int getBlockNumFromTID(tid);
-int getIndexFromTID(tid);
+int getBlockNumFromTID(tid, int);
+int getIndexFromTID(tid, int);
 
 void printUpdateArray(UpdateRecordArray *array);
 
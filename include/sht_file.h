@@ -1,3 +1,4 @@
+#include <stdio.h>
 #include "hash_file.h"
 #ifndef HASH_FILE_H
 #define HASH_FILE_H
@@ -27,7 +28,7 @@ typedef struct
 
 } UpdateRecordArray;
 
-tid getTid(int, int);
+tid getTid(int, int, int);
 
 #endif // HASH_FILE_H
 
@@ -39,12 +40,31 @@ typedef struct
 
 typedef struct
 {
-	int size;
+	int size;		/* πλήθος διακριτών κλειδιών στο block */
 	int local_depth;
+	int next_block; /* το επόμενο block υπερχείλισης του κάδου (-1 αν δεν υπάρχει) */
+	int used;		/* bytes του block που χρησιμοποιούνται από κλειδιά και tupleIds */
 } SecHeader;
 
-#define SEC_MAX_NODES ((BF_BLOCK_SIZE - sizeof(SecHashHeader)) / sizeof(SecHashNode))
-#define SEC_MAX_RECORDS ((BF_BLOCK_SIZE - sizeof(SecHeader)) / sizeof(SecondaryRecord))
+/* Κάθε διακριτό κλειδί αποθηκεύεται μία φορά, ακολουθούμενο από count tupleIds. */
+typedef struct
+{
+	char index_key[20];
+	int count;		  /* πλήθος tupleIds που ακολουθούν το κλειδί στο ίδιο block */
+	int next_posting; /* το πρώτο block υπερχείλισης με tupleIds του κλειδιού (-1 αν δεν υπάρχει) */
+} SecKeyHeader;
+
+typedef struct
+{
+	int size;		/* πλήθος tupleIds στο block */
+	int next_block; /* το επόμενο block με tupleIds του ίδιου κλειδιού (-1 αν δεν υπάρχει) */
+} SecPostingHeader;
+
+/* Τα όρια ενός block μεγέθους pageSize (το page_size του αρχείου, βλ. HT_SetPageSize). */
+#define SEC_MAX_NODES(pageSize) (((pageSize) - sizeof(SecHashHeader)) / sizeof(SecHashNode))
+#define SEC_DATA_SIZE(pageSize) ((pageSize) - sizeof(SecHeader))
+#define SEC_MAX_POSTINGS(pageSize) (((pageSize) - sizeof(SecPostingHeader)) / sizeof(int))
+#define SEC_FETCH_BATCH 4096 /* πόσες εγγραφές του πρωτεύοντος φέρνουν μαζί οι SHT_InnerJoin και SHT_LookupRecords */
 
 //////////////////////////////////////////////////////////////////////////
 
@@ -57,19 +77,99 @@ HT_ErrorCode SHT_CreateSecondaryIndex(
 	int depth,			   /* το ολικό βάθος ευρετηρίου επεκτατού κατακερματισμού */
 	char *fileName /* όνομα αρχείου πρωτεύοντος ευρετηρίου*/);
 
+/*
+ * Η συνάρτηση SHT_BulkCreateIndexes δημιουργεί με τις n εγγραφές του records το πρωτεύον αρχείο fileName (μέσω της HT_BulkCreateIndex)
+ * και μαζί το δευτερεύον αρχείο sfileName πάνω στο πεδίο attrName. Τα tuple ids του πρωτεύοντος χρησιμοποιούνται απευθείας,
+ * οπότε κάθε μπλοκ και των δύο αρχείων γράφεται μία φορά, χωρίς σπασίματα κάδων.
+ * Σε περίπτωση που εκτελεστεί επιτυχώς επιστρέφεται HT_OK, ενώ σε διαφορετική περίπτωση κωδικός λάθους.
+ */
+HT_ErrorCode SHT_BulkCreateIndexes(
+	const char *fileName,  /* όνομα αρχείου πρωτεύοντος ευρετηρίου */
+	int depth,			   /* ελάχιστο ολικό βάθος του πρωτεύοντος ευρετηρίου */
+	Record *records,	   /* οι εγγραφές */
+	int n,				   /* πλήθος εγγραφών */
+	const char *sfileName, /* όνομα αρχείου δευτερεύοντος ευρετηρίου */
+	char *attrName,		   /* όνομα πεδίου-κλειδιού */
+	int attrLength,		   /* μήκος πεδίου-κλειδιού */
+	int sdepth /* ελάχιστο ολικό βάθος του δευτερεύοντος ευρετηρίου */);
+
+/*
+ * Η συνάρτηση SHT_OpenSecondaryIndex ανοίγει το δευτερεύον αρχείο sfileName. Το όνομα του πρωτεύοντος αρχείου, που χρειάζονται
+ * η SHT_LookupRecords και οι ζεύξεις, διαβάζεται από το πρώτο block του αρχείου, όπου το γράφει η SHT_CreateSecondaryIndex.
+ */
 HT_ErrorCode SHT_OpenSecondaryIndex(
 	const char *sfileName, /* όνομα αρχείου */
 	int *indexDesc /* θέση στον πίνακα με τα ανοιχτά αρχεία που επιστρέφεται */);
 
 HT_ErrorCode SHT_CloseSecondaryIndex(int indexDesc /* θέση στον πίνακα με τα ανοιχτά αρχεία */);
 
+/*
+ * Η συνάρτηση SHT_MapSecondaryIndex απεικονίζει ολόκληρο το ανοιχτό δευτερεύον ευρετήριο indexDesc στη μνήμη (BF_MapFile),
+ * ώστε οι αναζητήσεις και οι ζεύξεις να διαβάζουν τα blocks του χωρίς ανάγνωση και αντιγραφή ανά block. Είναι για ευρετήρια
+ * που κυρίως διαβάζονται, και ισχύει ως την SHT_CloseSecondaryIndex. Χρειάζεται το επίπεδο BF του src/bf.c (make ... BF=src).
+ * Σε περίπτωση που εκτελεστεί επιτυχώς επιστρέφεται HT_OK, ενώ σε διαφορετική περίπτωση κωδικός λάθους.
+ */
+HT_ErrorCode SHT_MapSecondaryIndex(int indexDesc /* θέση στον πίνακα με τα ανοιχτά αρχεία */);
+
 HT_ErrorCode SHT_SecondaryInsertEntry(
 	int indexDesc, /* θέση στον πίνακα με τα ανοιχτά αρχεία */
 	SecondaryRecord record /* δομή που προσδιορίζει την εγγραφή */);
 
 HT_ErrorCode SHT_SecondaryUpdateEntry(
 	int indexDesc, /* θέση στον πίνακα με τα ανοιχτά αρχεία */
-	UpdateRecordArray *updateArray /* δομή που προσδιορίζει την παλιά εγγραφή */);
+	UpdateRecordArray *updateArray /* δομή που προσδιορίζει την παλιά εγγραφή (έως MAX_UPDATES θέσεις, ως την πρώτη με oldTupleId και newTupleId -1) */);
+
+/*
+ * Η συνάρτηση SHT_SecondaryDeleteEntry αφαιρεί το record.tupleId από το κλειδί record.index_key. Αν ο κάδος του κλειδιού χωράει μαζί με
+ * τον γειτονικό του σε ένα block οι δύο κάδοι ενώνονται, και το ευρετήριο υποδιπλασιάζεται όταν κανένας κάδος δεν έχει τοπικό βάθος ίσο με το ολικό.
+ * Η SHT_SecondaryUpdateEntry κάνει το ίδιο για κάθε θέση του updateArray με newTupleId -1 (εγγραφές που διέγραψε η HT_DeleteEntry).
+ * Σε περίπτωση που εκτελεστεί επιτυχώς επιστρέφεται HT_OK, ενώ σε διαφορετική περίπτωση κωδικός λάθους.
+ */
+HT_ErrorCode SHT_SecondaryDeleteEntry(
+	int indexDesc, /* θέση στον πίνακα με τα ανοιχτά αρχεία */
+	SecondaryRecord record /* δομή που προσδιορίζει την εγγραφή προς διαγραφή */);
+
+/*
+ * Η συνάρτηση SHT_SecondaryApplyDeltas εφαρμόζει με τη σειρά τις n αλλαγές tuple ids του deltas (από τις HT_InsertEntryDelta, HT_DeleteEntryDelta).
+ * Ο κάδος κάθε αλλαγής βρίσκεται από την τιμή κατακερματισμού του κλειδιού (cityHash ή surnameHash, ανάλογα με το attribute του ευρετηρίου)
+ * και το κλειδί από το oldTupleId. Με n 0 η συνάρτηση επιστρέφει αμέσως, χωρίς να διαβάσει κανένα block.
+ * Σε περίπτωση που εκτελεστεί επιτυχώς επιστρέφεται HT_OK, ενώ σε διαφορετική περίπτωση κωδικός λάθους.
+ */
+HT_ErrorCode SHT_SecondaryApplyDeltas(
+	int indexDesc,		/* θέση στον πίνακα με τα ανοιχτά αρχεία */
+	TupleDelta *deltas, /* οι αλλαγές των tuple ids */
+	int n				/* πλήθος αλλαγών */
+);
+
+/* Καλείται από την SHT_Lookup μία φορά για κάθε tupleId του κλειδιού, με το arg που δόθηκε στην SHT_Lookup. */
+typedef void (*SHT_LookupCallback)(tid tupleId, void *arg);
+
+/*
+ * Η συνάρτηση SHT_Lookup καλεί την callback για κάθε tupleId των εγγραφών με τιμή πεδίου-κλειδιού index_key, χωρίς να τυπώνει τίποτα.
+ * Τα tupleIds διαβάζονται απευθείας από τα μπλοκ του κλειδιού, η callback δεν πρέπει να αλλάζει το δευτερεύον ευρετήριο.
+ * Σε περίπτωση που εκτελεστεί επιτυχώς (ακόμη κι αν δεν υπάρχει το κλειδί) επιστρέφεται HT_OK, ενώ σε διαφορετική περίπτωση κωδικός λάθους.
+ */
+HT_ErrorCode SHT_Lookup(
+	int sindexDesc,				 /* θέση στον πίνακα με τα ανοιχτά αρχεία του αρχείου δευτερεύοντος ευρετηρίου */
+	char *index_key,			 /* τιμή του πεδίου-κλειδιού προς αναζήτηση */
+	SHT_LookupCallback callback, /* συνάρτηση που καλείται για κάθε tupleId */
+	void *arg /* παράμετρος που δίνεται σε κάθε κλήση της callback */);
+
+/* Καλείται από την SHT_LookupRecords μία φορά για κάθε εγγραφή του κλειδιού, με το tupleId της και την εγγραφή του πρωτεύοντος. */
+typedef void (*SHT_RecordCallback)(tid tupleId, Record *record, void *arg);
+
+/*
+ * Η συνάρτηση SHT_LookupRecords κάνει ό,τι η SHT_Lookup, αλλά δίνει στην callback και την εγγραφή του πρωτεύοντος αρχείου κάθε tupleId.
+ * Τα tupleIds του κλειδιού μαζεύονται πρώτα και οι εγγραφές διαβάζονται με την HT_FetchRecords, SEC_FETCH_BATCH τη φορά,
+ * οπότε κάθε block του πρωτεύοντος διαβάζεται μία φορά ανά ομάδα, με τη σειρά του αρχείου. Η callback καλείται με τη σειρά της SHT_Lookup.
+ * Σε περίπτωση που εκτελεστεί επιτυχώς (ακόμη κι αν δεν υπάρχει το κλειδί) επιστρέφεται HT_OK, ενώ σε διαφορετική περίπτωση
+ * (π.χ. αν δεν ανοίγει το πρωτεύον αρχείο) κωδικός λάθους.
+ */
+HT_ErrorCode SHT_LookupRecords(
+	int sindexDesc,				 /* θέση στον πίνακα με τα ανοιχτά αρχεία του αρχείου δευτερεύοντος ευρετηρίου */
+	char *index_key,			 /* τιμή του πεδίου-κλειδιού προς αναζήτηση */
+	SHT_RecordCallback callback, /* συνάρτηση που καλείται για κάθε εγγραφή */
+	void *arg /* παράμετρος που δίνεται σε κάθε κλήση της callback */);
 
 HT_ErrorCode SHT_PrintAllEntries(
 	int sindexDesc, /* θέση στον πίνακα με τα ανοιχτά αρχεία  του αρχείου δευτερεύοντος ευρετηρίου */
@@ -82,6 +182,215 @@ HT_ErrorCode SHT_InnerJoin(
 	int sindexDesc2, /* θέση στον πίνακα με τα ανοιχτά αρχεία του αρχείου δευτερεύοντος ευρετηρίου για το δεύτερο αρχείο εισόδου */
 	char *index_key /* το κλειδι πανω στο οποιο θα γινει το join. Αν  NULL τοτε επιστρέφεί όλες τις πλειάδες*/);
 
+// Ο τρόπος ζεύξης όλων των εγγραφών (index_key NULL) της SHT_InnerJoinCallback
+typedef enum SHT_JoinMethod
+{
+	SHT_HASH_JOIN,		  // πίνακας κατακερματισμού στη μνήμη με όλες τις εγγραφές του μικρότερου ευρετηρίου
+	SHT_PARTITIONED_JOIN, // ζεύξη κάδο προς κάδο, αφού και τα δύο ευρετήρια κατακερματίζουν με την hashAttr
+	SHT_BLOOM_JOIN		  // όπως το SHT_HASH_JOIN, αλλά με φίλτρα στα κλειδιά του μικρότερου ευρετηρίου πριν διαβαστεί το μεγαλύτερο
+} SHT_JoinMethod;
+
+/* Καλείται από την SHT_InnerJoinCallback μία φορά για κάθε ζεύγος της ζεύξης, με τα tupleIds του πρώτου και του δεύτερου ευρετηρίου. */
+typedef void (*SHT_JoinCallback)(const char *index_key, tid tupleId1, tid tupleId2, void *arg);
+
+/*
+ * Η συνάρτηση SHT_InnerJoinCallback κάνει ό,τι η SHT_InnerJoin, αλλά αντί να τυπώνει καλεί την callback για κάθε ζεύγος.
+ * Με index_key NULL η ζεύξη γίνεται με τον τρόπο method:
+ *  - SHT_HASH_JOIN: χτίζεται πίνακας κατακερματισμού στη μνήμη με τις εγγραφές του ευρετηρίου με τα λιγότερα blocks,
+ *    και το άλλο ευρετήριο διαβάζεται μία φορά, κάδο κάδο.
+ *  - SHT_PARTITIONED_JOIN: τα δύο ευρετήρια διαβάζονται μαζί, και ένα κλειδί αναζητείται μόνο στους κάδους του άλλου ευρετηρίου με
+ *    το ίδιο πρόθεμα τιμής κατακερματισμού. Κάθε κάδος διαβάζεται μία φορά και στη μνήμη κρατείται ένας κάδος κάθε φορά.
+ *  - SHT_BLOOM_JOIN: όπως το SHT_HASH_JOIN, αλλά ένας κάδος του μεγαλύτερου ευρετηρίου διαβάζεται μόνο αν κάποιο κλειδί του μικρότερου
+ *    έχει τιμή κατακερματισμού του, ένα κλειδί του συγκρίνεται μόνο αν περάσει ένα Bloom filter με τα κλειδιά του μικρότερου,
+ *    και τα tupleIds του διαβάζονται μόνο αν υπάρχει ζεύγος. Συμφέρει όταν το ένα ευρετήριο είναι πολύ μικρότερο από το άλλο.
+ * Τα ζεύγη είναι ίδια με της εμφωλευμένης επανάληψης, και στην ίδια σειρά όταν ένα ευρετήριο ενώνεται με τον εαυτό του.
+ * Η callback δεν πρέπει να αλλάζει τα ευρετήρια.
+ * Σε περίπτωση που εκτελεστεί επιτυχώς επιστρέφεται HT_OK, ενώ σε διαφορετική περίπτωση κωδικός λάθους.
+ */
+HT_ErrorCode SHT_InnerJoinCallback(
+	int sindexDesc1,		   /* θέση στον πίνακα με τα ανοιχτά αρχεία του πρώτου αρχείου δευτερεύοντος ευρετηρίου */
+	int sindexDesc2,		   /* θέση στον πίνακα με τα ανοιχτά αρχεία του δεύτερου αρχείου δευτερεύοντος ευρετηρίου */
+	char *index_key,		   /* το κλειδί της ζεύξης, ή NULL για όλες τις πλειάδες */
+	SHT_JoinMethod method,	   /* ο τρόπος ζεύξης όταν το index_key είναι NULL */
+	SHT_JoinCallback callback, /* συνάρτηση που καλείται για κάθε ζεύγος */
+	void *arg /* παράμετρος που δίνεται σε κάθε κλήση της callback */);
+
+// Bloom filter πάνω σε κλειδιά (μέσω της hashString): μπορεί να απαντήσει λανθασμένα ότι ένα κλειδί υπάρχει, αλλά ποτέ ότι δεν υπάρχει
+typedef struct
+{
+	int bitsN;			 // πλήθος bits
+	int hashesN;		 // πλήθος bits που θέτει κάθε κλειδί
+	unsigned char *bits; // (bitsN + 7) / 8 bytes
+} SHT_BloomFilter;
+
+#define SHT_BLOOM_BITS_PER_KEY 10 /* bits ανά κλειδί του φίλτρου του SHT_BLOOM_JOIN (περίπου 1% λανθασμένα θετικά) */
+
+/* Η συνάρτηση SHT_BloomInit δημιουργεί ένα άδειο φίλτρο για keysN κλειδιά, με bitsPerKey bits ανά κλειδί. */
+HT_ErrorCode SHT_BloomInit(
+	SHT_BloomFilter *filter, /* το φίλτρο που αρχικοποιείται */
+	int keysN,				 /* αναμενόμενο πλήθος κλειδιών */
+	int bitsPerKey /* bits ανά κλειδί (π.χ. SHT_BLOOM_BITS_PER_KEY) */);
+
+void SHT_BloomAdd(SHT_BloomFilter *filter, const char *key);
+
+/* Επιστρέφει 0 αν το key σίγουρα δεν έχει προστεθεί στο φίλτρο, αλλιώς 1. */
+int SHT_BloomMayContain(const SHT_BloomFilter *filter, const char *key);
+
+void SHT_BloomFree(SHT_BloomFilter *filter);
+
+/*
+ * Η συνάρτηση SHT_BuildBloomFilter δημιουργεί ένα φίλτρο με όλα τα διακριτά κλειδιά του δευτερεύοντος ευρετηρίου sindexDesc, διαβάζοντας
+ * μόνο τα blocks των κάδων. Με αυτό ένα σύνολο κλειδιών μπορεί να ελεγχθεί (SHT_BloomMayContain) πριν από τις SHT_Lookup ή
+ * SHT_PrintAllEntries, που διαβάζουν τον κάδο κάθε κλειδιού. Το φίλτρο ελευθερώνεται με την SHT_BloomFree.
+ * Σε περίπτωση που εκτελεστεί επιτυχώς επιστρέφεται HT_OK, ενώ σε διαφορετική περίπτωση κωδικός λάθους.
+ */
+HT_ErrorCode SHT_BuildBloomFilter(
+	int sindexDesc, /* θέση στον πίνακα με τα ανοιχτά αρχεία του αρχείου δευτερεύοντος ευρετηρίου */
+	int bitsPerKey, /* bits ανά κλειδί */
+	SHT_BloomFilter *filter /* το φίλτρο που δημιουργείται */);
+
+/*
+ * Η συνάρτηση SHT_GraceJoin κάνει ζεύξη όλων των εγγραφών δύο δευτερευόντων ευρετηρίων, όπως η SHT_InnerJoinCallback με index_key NULL,
+ * με grace hash join: οι εγγραφές και των δύο ευρετηρίων μοιράζονται σε διαμερίσεις σε δύο προσωρινά αρχεία μέσω του BF (όπως στην HT_GraceJoin)
+ * και κάθε ζεύγος διαμερίσεων ενώνεται στη μνήμη, με το πολύ memoryBlocks blocks (όπως στην HT_GraceJoin). Σε αντίθεση με το
+ * SHT_HASH_JOIN, δεν χρειάζεται να χωράει ολόκληρο ευρετήριο στη μνήμη, και σε αντίθεση με το SHT_PARTITIONED_JOIN τα ευρετήρια μπορεί να
+ * έχουν οποιοδήποτε βάθος. Η σειρά των ζευγών δεν είναι αυτή της εμφωλευμένης επανάληψης.
+ * Σε περίπτωση που εκτελεστεί επιτυχώς επιστρέφεται HT_OK, ενώ σε διαφορετική περίπτωση κωδικός λάθους.
+ */
+HT_ErrorCode SHT_GraceJoin(
+	int sindexDesc1,		   /* θέση στον πίνακα με τα ανοιχτά αρχεία του πρώτου αρχείου δευτερεύοντος ευρετηρίου */
+	int sindexDesc2,		   /* θέση στον πίνακα με τα ανοιχτά αρχεία του δεύτερου αρχείου δευτερεύοντος ευρετηρίου */
+	int memoryBlocks,		   /* πόσα blocks του BF μπορεί να χρησιμοποιήσει η ζεύξη */
+	SHT_JoinCallback callback, /* συνάρτηση που καλείται για κάθε ζεύγος */
+	void *arg /* παράμετρος που δίνεται σε κάθε κλήση της callback */);
+
+// Μια γραμμή του αποτελέσματος μιας ζεύξης, όπως τη δέχεται ένας SHT_JoinSink
+typedef struct
+{
+	const char *index_key;
+	tid tupleId1;
+	tid tupleId2;
+	const Record *record1; // η εγγραφή του πρώτου πρωτεύοντος (NULL αν ο sink δεν ζητά εγγραφές)
+	const Record *record2; // η εγγραφή του δεύτερου πρωτεύοντος (NULL αν ο sink δεν ζητά εγγραφές)
+} SHT_JoinRow;
+
+/* Καλείται από τον sink της SHT_OpenCallbackSink και από την SHT_ScanJoinRowFile μία φορά για κάθε γραμμή. */
+typedef void (*SHT_JoinRowCallback)(const SHT_JoinRow *row, void *arg);
+
+// Μια γραμμή όπως γράφεται από τον sink της SHT_OpenBlockFileSink σε ένα αρχείο του BF
+typedef struct
+{
+	char index_key[20];
+	tid tupleId1;
+	tid tupleId2;
+	Record record1;
+	Record record2;
+} SHT_JoinRowRecord;
+
+typedef struct
+{
+	int size; // πλήθος γραμμών στο block
+} SHT_JoinRowHeader;
+
+#define SHT_MAX_JOIN_ROWS ((BF_BLOCK_SIZE - sizeof(SHT_JoinRowHeader)) / sizeof(SHT_JoinRowRecord))
+
+typedef struct
+{
+	SHT_JoinRowHeader header;
+	SHT_JoinRowRecord row[SHT_MAX_JOIN_ROWS];
+} SHT_JoinRowPage;
+
+#define SHT_SINK_BUFFER_SIZE 65536 /* bytes του buffer των sinks κειμένου (CSV) */
+
+/*
+ * Ο αποδέκτης των γραμμών μιας ζεύξης (SHT_InnerJoinSink). Ανοίγεται με μία από τις SHT_Open...Sink και κλείνει με την SHT_CloseJoinSink.
+ * Για δικό του sink ο χρήστης ορίζει τα needsRecords, usesBF, write, close και arg, και μηδενίζει το rows.
+ */
+typedef struct SHT_JoinSink SHT_JoinSink;
+struct SHT_JoinSink
+{
+	int needsRecords;											  // 1 αν οι γραμμές πρέπει να έχουν τις εγγραφές των πρωτευόντων
+	HT_ErrorCode (*write)(SHT_JoinSink *sink, const SHT_JoinRow *row); // καλείται για κάθε γραμμή
+	HT_ErrorCode (*close)(SHT_JoinSink *sink);					  // καλείται από την SHT_CloseJoinSink (ή NULL)
+	long rows;													  // πλήθος γραμμών που δέχτηκε ο sink
+	SHT_JoinRowCallback callback;								  // SHT_OpenCallbackSink
+	void *arg;
+	FILE *file;		   // sinks κειμένου
+	char *buffer;	   // sinks κειμένου: οι γραμμές που δεν έχουν γραφτεί ακόμη στο file
+	int bufferN;	   // sinks κειμένου: bytes του buffer
+	int bySurname;	   // sink της SHT_InnerJoin: 1 αν τυπώνεται η πόλη αντί για το επίθετο
+	int usesBF;		   // 1 αν η write καλεί το BF, οπότε στην SHT_ParallelInnerJoin καλείται ένα νήμα τη φορά
+	int fd;			   // SHT_OpenBlockFileSink
+	BF_Block *block;   // SHT_OpenBlockFileSink: το τελευταίο block του αρχείου μένει καρφιτσωμένο όσο γεμίζει
+	SHT_JoinRowPage *page;
+};
+
+/* Ο sink καλεί την callback για κάθε γραμμή, με τις εγγραφές των δύο πρωτευόντων. */
+HT_ErrorCode SHT_OpenCallbackSink(
+	SHT_JoinSink *sink,			  /* ο sink που αρχικοποιείται */
+	SHT_JoinRowCallback callback, /* συνάρτηση που καλείται για κάθε γραμμή */
+	void *arg /* παράμετρος που δίνεται σε κάθε κλήση της callback */);
+
+/* Ο sink γράφει τις γραμμές (SHT_JoinRowRecord) σε ένα νέο αρχείο του BF, block block, χωρίς μορφοποίηση. Διαβάζεται με την SHT_ScanJoinRowFile. */
+HT_ErrorCode SHT_OpenBlockFileSink(
+	SHT_JoinSink *sink, /* ο sink που αρχικοποιείται */
+	const char *fileName /* όνομα του αρχείου που δημιουργείται */);
+
+/*
+ * Ο sink γράφει τις γραμμές ως CSV στο file (key,tupleId1,id1,name1,surname1,city1,tupleId2,id2,name2,surname2,city2), ξεκινώντας με
+ * μια γραμμή επικεφαλίδας. Οι γραμμές μαζεύονται σε buffer SHT_SINK_BUFFER_SIZE bytes και γράφονται με μία fwrite όταν αυτός γεμίσει.
+ */
+HT_ErrorCode SHT_OpenCsvSink(
+	SHT_JoinSink *sink, /* ο sink που αρχικοποιείται */
+	FILE *file /* ανοιχτό αρχείο όπου γράφεται το CSV (δεν κλείνει από την SHT_CloseJoinSink) */);
+
+/* Ο sink μόνο μετρά τις γραμμές (στο rows), χωρίς να διαβάζει τις εγγραφές των πρωτευόντων. */
+HT_ErrorCode SHT_OpenCountSink(SHT_JoinSink *sink /* ο sink που αρχικοποιείται */);
+
+/* Η συνάρτηση SHT_CloseJoinSink γράφει ό,τι έχει μείνει στον sink και ελευθερώνει τους πόρους του. Το rows μένει διαθέσιμο. */
+HT_ErrorCode SHT_CloseJoinSink(SHT_JoinSink *sink /* ανοιχτός sink */);
+
+/*
+ * Η συνάρτηση SHT_InnerJoinSink κάνει ό,τι η SHT_InnerJoinCallback, αλλά δίνει κάθε γραμμή στον sink. Αν ο sink ζητά εγγραφές, αυτές
+ * διαβάζονται με την HT_FetchRecords, SEC_FETCH_BATCH γραμμές τη φορά, αλλιώς τα πρωτεύοντα αρχεία δεν διαβάζονται καθόλου.
+ * Ο sink δεν κλείνει, ώστε να μπορεί να δεχτεί τις γραμμές περισσότερων ζεύξεων.
+ * Σε περίπτωση που εκτελεστεί επιτυχώς επιστρέφεται HT_OK, ενώ σε διαφορετική περίπτωση κωδικός λάθους.
+ */
+HT_ErrorCode SHT_InnerJoinSink(
+	int sindexDesc1,	   /* θέση στον πίνακα με τα ανοιχτά αρχεία του πρώτου αρχείου δευτερεύοντος ευρετηρίου */
+	int sindexDesc2,	   /* θέση στον πίνακα με τα ανοιχτά αρχεία του δεύτερου αρχείου δευτερεύοντος ευρετηρίου */
+	char *index_key,	   /* το κλειδί της ζεύξης, ή NULL για όλες τις πλειάδες */
+	SHT_JoinMethod method, /* ο τρόπος ζεύξης όταν το index_key είναι NULL */
+	SHT_JoinSink *sink /* ανοιχτός sink */);
+
+#define SHT_MAX_THREADS 64 /* μέγιστο πλήθος νημάτων της SHT_ParallelInnerJoin */
+
+/*
+ * Η συνάρτηση SHT_ParallelInnerJoin κάνει ζεύξη όλων των εγγραφών δύο δευτερευόντων ευρετηρίων με threadsN νήματα. Οι διακριτοί κάδοι
+ * του πρώτου ευρετηρίου μοιράζονται στα νήματα έναν έναν, και κάθε νήμα ενώνει τον κάδο του με τους κάδους του δεύτερου ευρετηρίου
+ * κάτω από τις ίδιες τιμές κατακερματισμού (όπως το SHT_PARTITIONED_JOIN). Το νήμα t δίνει τις γραμμές του στον sinks[t], οπότε
+ * οι sinks δεν χρειάζεται να είναι thread-safe, και η σειρά των γραμμών δεν είναι ορισμένη.
+ * Η lib/libbf.so δεν είναι thread-safe: με αυτή κάθε ανάγνωση block (και κάθε write ενός sink με usesBF) γίνεται με κλειδωμένο ένα
+ * κοινό mutex, ενώ η ζεύξη των κάδων και οι sinks τρέχουν παράλληλα. Με το src/bf.c (BF_SRC), που είναι thread-safe, και οι αναγνώσεις
+ * γίνονται παράλληλα, από τόσα νήματα όσα χωράνε τα καρφιτσωμένα τους blocks στη μνήμη του BF, και μόνο οι writes των sinks με usesBF
+ * γίνονται μία τη φορά. Τα ευρετήρια δεν πρέπει να αλλάζουν όσο γίνεται η ζεύξη.
+ * Σε περίπτωση που εκτελεστεί επιτυχώς επιστρέφεται HT_OK, ενώ σε διαφορετική περίπτωση κωδικός λάθους.
+ */
+HT_ErrorCode SHT_ParallelInnerJoin(
+	int sindexDesc1, /* θέση στον πίνακα με τα ανοιχτά αρχεία του πρώτου αρχείου δευτερεύοντος ευρετηρίου */
+	int sindexDesc2, /* θέση στον πίνακα με τα ανοιχτά αρχεία του δεύτερου αρχείου δευτερεύοντος ευρετηρίου */
+	int threadsN,	 /* πλήθος νημάτων, από 1 έως SHT_MAX_THREADS */
+	SHT_JoinSink *sinks /* threadsN ανοιχτοί sinks, ένας για κάθε νήμα */);
+
+/*
+ * Η συνάρτηση SHT_ScanJoinRowFile καλεί την callback για κάθε γραμμή του αρχείου fileName που έγραψε ένας sink της SHT_OpenBlockFileSink,
+ * με τη σειρά που γράφτηκαν. Σε περίπτωση που εκτελεστεί επιτυχώς επιστρέφεται HT_OK, ενώ σε διαφορετική περίπτωση κωδικός λάθους.
+ */
+HT_ErrorCode SHT_ScanJoinRowFile(
+	const char *fileName,		  /* όνομα του αρχείου */
+	SHT_JoinRowCallback callback, /* συνάρτηση που καλείται για κάθε γραμμή */
+	void *arg /* παράμετρος που δίνεται σε κάθε κλήση της callback */);
+
 void SHT_PrintSecHashTable(int fd, BF_Block *block, int full);
 
 unsigned int hashAttr(const char *str, int depth);
\ No newline at end of file
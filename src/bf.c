@@ -0,0 +1,1458 @@
+#define _GNU_SOURCE // mremap
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include "bf.h"
+
+#define BF_MAP_MIN_SIZE (1 << 30) // bytes of address space a mapping takes at first (past the end of the file), so that it rarely has to move to grow
+#define BF_MAX_RUN 64               // blocks that BF_GetBlocks reads with one preadv at most
+
+// the lists a page can be in. Ghosts are pages evicted lately, kept only by their (fd, block_num) for 2Q and ARC
+typedef enum
+{
+  BF_LIST_FREE,           // entries that are not used
+  BF_LIST_RECENT,         // 2Q: A1in, ARC: T1 (pages used once lately)
+  BF_LIST_FREQUENT,       // 2Q: Am, ARC: T2 (pages used more than once), LRU/MRU/CLOCK: every page in memory
+  BF_LIST_GHOST_RECENT,   // 2Q: A1out, ARC: B1
+  BF_LIST_GHOST_FREQUENT, // ARC: B2
+  BF_LISTS
+} BFListId;
+
+// a page in memory, or a ghost
+typedef struct
+{
+  int file; // the entry of the file in bfManager.files
+  int block_num;
+  BFListId list;
+  int prev;     // the previous entry of the list (closer to its head, the most recent end), or -1
+  int next;     // the next entry of the list, or -1
+  int hashNext; // the next entry of the same hash chain, or -1
+  int pins;
+  int dirty;
+  int loading; // 1 while a thread reads the page from the disk with bfLatch released
+  int ref;     // CLOCK: 1 if the page was used since the hand last passed it
+  char *data; // the page size of its file in bytes, NULL for ghosts and free entries
+} BFPage;
+
+typedef struct
+{
+  int head;
+  int tail;
+  int size;
+} BFList;
+
+// a file on the disk. Opening it again gives another file_desc for the same BFFile, so both see the same pages
+typedef struct
+{
+  int refs; // the file_desc that refer to it, 0 if the entry is not used
+  int os_fd;
+  dev_t dev;
+  ino_t ino;
+  int blocks;   // number of blocks, including allocated blocks that are not on the disk yet
+  int pageSize; // the size of its blocks, BF_BLOCK_SIZE unless BF_SetPageSize changed it
+  char *map;      // the whole file mapped in memory after BF_MapFile, or NULL. Its blocks are never in the pages
+  size_t mapSize; // the bytes of address space of 'map', the file is as long as its blocks
+  int mapPins;    // the blocks of 'map' that are pinned
+} BFFile;
+
+struct BF_Block
+{
+  int page; // the entry of the page while it is pinned through this BF_Block, or -1
+  int file; // the file while a block of its mapping is pinned through this BF_Block, or -1
+  char *data;
+};
+
+// the state of the BF level between BF_Init and BF_Close
+typedef struct
+{
+  int active;
+  ReplacementAlgorithm policy;
+  int frames;   // pages that fit in memory
+  int entriesN; // entries of pages: the frames and as many ghosts
+  BFPage *pages;
+  int residentN; // pages in memory, each one with its own buffer of the page size of its file
+  int hashSize; // a power of 2
+  int *hash;    // the first entry of each hash chain, or -1
+  BFList lists[BF_LISTS];
+  int hand;      // CLOCK: the next entry of BF_LIST_FREQUENT the hand looks at, or -1 for the head
+  int arcTarget; // ARC: the target size of T1 (p)
+  int recentMax; // 2Q: the size of A1in above which it is evicted first (Kin)
+  int ghostMax;  // 2Q: the size of A1out (Kout)
+  BFFile files[BF_MAX_OPEN_FILES];
+  int handles[BF_MAX_OPEN_FILES]; // the file of each file_desc, or -1
+} BFManager;
+
+BFManager bfManager;
+
+/*
+  Every BF call holds bfLatch while it uses bfManager, so threads can call the BF together: each BF_ function takes it and
+  calls the bf function of the same name. A page that is not in memory is read with the latch released (bfLoadPage), so
+  threads that read different blocks do it at the same time, and a thread that wants a page another thread is reading
+  waits on bfLoaded. Blocks of a mapped file are read with no latch at all, only their pins take it.
+*/
+pthread_mutex_t bfLatch = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t bfLoaded = PTHREAD_COND_INITIALIZER;
+
+/*
+  Returns the hash chain of the page ('file', 'block_num').
+*/
+int bfHash(int file, int block_num)
+{
+  unsigned int h = (unsigned int)file * 2654435761u ^ (unsigned int)block_num * 40503u;
+  return (h ^ (h >> 15)) & (bfManager.hashSize - 1);
+}
+
+/*
+  Returns the entry of the page ('file', 'block_num'), whether it is in memory or a ghost, or -1.
+*/
+int bfFindPage(int file, int block_num)
+{
+  for (int e = bfManager.hash[bfHash(file, block_num)]; e != -1; e = bfManager.pages[e].hashNext)
+    if (bfManager.pages[e].file == file && bfManager.pages[e].block_num == block_num)
+      return e;
+  return -1;
+}
+
+void bfHashInsert(int e)
+{
+  int h = bfHash(bfManager.pages[e].file, bfManager.pages[e].block_num);
+  bfManager.pages[e].hashNext = bfManager.hash[h];
+  bfManager.hash[h] = e;
+}
+
+void bfHashRemove(int e)
+{
+  int *link = &bfManager.hash[bfHash(bfManager.pages[e].file, bfManager.pages[e].block_num)];
+  while (*link != e)
+    link = &bfManager.pages[*link].hashNext;
+  *link = bfManager.pages[e].hashNext;
+}
+
+/*
+  Takes entry 'e' out of its list.
+*/
+void bfListRemove(int e)
+{
+  BFPage *page = &bfManager.pages[e];
+  BFList *list = &bfManager.lists[page->list];
+
+  if (bfManager.hand == e)
+    bfManager.hand = page->next;
+  if (page->prev != -1)
+    bfManager.pages[page->prev].next = page->next;
+  else
+    list->head = page->next;
+  if (page->next != -1)
+    bfManager.pages[page->next].prev = page->prev;
+  else
+    list->tail = page->prev;
+  list->size--;
+  page->prev = page->next = -1;
+}
+
+/*
+  Puts entry 'e' (that is in no list) at the head of list 'id' if 'atHead' is 1, else at its tail.
+*/
+void bfListPush(int e, BFListId id, int atHead)
+{
+  BFPage *page = &bfManager.pages[e];
+  BFList *list = &bfManager.lists[id];
+
+  page->list = id;
+  if (atHead)
+  {
+    page->prev = -1;
+    page->next = list->head;
+    if (list->head != -1)
+      bfManager.pages[list->head].prev = e;
+    list->head = e;
+    if (list->tail == -1)
+      list->tail = e;
+  }
+  else
+  {
+    page->next = -1;
+    page->prev = list->tail;
+    if (list->tail != -1)
+      bfManager.pages[list->tail].next = e;
+    list->tail = e;
+    if (list->head == -1)
+      list->head = e;
+  }
+  list->size++;
+}
+
+/*
+  Forgets entry 'e' (a ghost, or a page whose buffer was already given back) and puts it in the free list.
+*/
+void bfDropEntry(int e)
+{
+  bfHashRemove(e);
+  bfListRemove(e);
+  bfManager.pages[e].file = -1;
+  bfManager.pages[e].data = NULL;
+  bfListPush(e, BF_LIST_FREE, 1);
+}
+
+/*
+  Returns a free entry, forgetting the oldest ghost if there is none, or -1.
+*/
+int bfNewEntry()
+{
+  BFList *freeList = &bfManager.lists[BF_LIST_FREE];
+  if (freeList->size == 0)
+  {
+    BFList *ghosts = &bfManager.lists[BF_LIST_GHOST_RECENT];
+    if (ghosts->size == 0)
+      ghosts = &bfManager.lists[BF_LIST_GHOST_FREQUENT];
+    if (ghosts->size == 0)
+      return -1;
+    bfDropEntry(ghosts->tail);
+  }
+
+  int e = freeList->head;
+  bfListRemove(e);
+  return e;
+}
+
+/*
+  Writes 'size' bytes of 'data' at 'offset' of the file 'os_fd', as many calls as it takes.
+*/
+BF_ErrorCode bfWrite(int os_fd, const char *data, size_t size, off_t offset)
+{
+  while (size > 0)
+  {
+    ssize_t n = pwrite(os_fd, data, size, offset);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return BF_ERROR;
+    data += n;
+    size -= n;
+    offset += n;
+  }
+  return BF_OK;
+}
+
+/*
+  Reads 'size' bytes at 'offset' of the file 'os_fd' into 'data'. What is past the end of the file reads as zeros
+  (allocated blocks are only written when they are evicted or their file is closed).
+*/
+BF_ErrorCode bfRead(int os_fd, char *data, size_t size, off_t offset)
+{
+  while (size > 0)
+  {
+    ssize_t n = pread(os_fd, data, size, offset);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0)
+      return BF_ERROR;
+    if (n == 0)
+    {
+      memset(data, 0, size);
+      break;
+    }
+    data += n;
+    size -= n;
+    offset += n;
+  }
+  return BF_OK;
+}
+
+/*
+  Reads the 'count' adjacent blocks of 'size' bytes at 'offset' of the file 'os_fd' into the buffers 'data' with one preadv.
+  After a short read the rest is read as bfRead does, so what is past the end of the file reads as zeros.
+*/
+BF_ErrorCode bfReadv(int os_fd, char **data, int count, int size, off_t offset)
+{
+  struct iovec iov[BF_MAX_RUN];
+  for (int k = 0; k < count; k++)
+  {
+    iov[k].iov_base = data[k];
+    iov[k].iov_len = size;
+  }
+
+  ssize_t n;
+  do
+    n = preadv(os_fd, iov, count, offset);
+  while (n < 0 && errno == EINTR);
+  if (n < 0)
+    return BF_ERROR;
+
+  for (int k = 0; k < count; k++)
+  {
+    ssize_t start = (ssize_t)k * size;
+    if (start + size <= n)
+      continue;
+    ssize_t done = n > start ? n - start : 0;
+    BF_ErrorCode code = bfRead(os_fd, data[k] + done, size - done, offset + start + done);
+    if (code != BF_OK)
+      return code;
+  }
+  return BF_OK;
+}
+
+/*
+  Writes page 'e' to the disk if it is dirty.
+*/
+BF_ErrorCode bfFlushPage(int e)
+{
+  BFPage *page = &bfManager.pages[e];
+  if (!page->dirty)
+    return BF_OK;
+
+  int pageSize = bfManager.files[page->file].pageSize;
+  BF_ErrorCode code = bfWrite(bfManager.files[page->file].os_fd, page->data, pageSize, (off_t)page->block_num * pageSize);
+  if (code == BF_OK)
+    page->dirty = 0;
+  return code;
+}
+
+/*
+  Evicts the unpinned page 'e': writes it if it is dirty and returns its buffer in 'data' and the buffer's size in 'size'.
+  2Q keeps the pages evicted from A1in as ghosts (A1out), ARC keeps every evicted page as a ghost (B1 or B2), the other
+  policies forget it.
+*/
+BF_ErrorCode bfEvict(int e, char **data, int *size)
+{
+  BFPage *page = &bfManager.pages[e];
+  BF_ErrorCode code = bfFlushPage(e);
+  if (code != BF_OK)
+    return code;
+
+  *data = page->data;
+  *size = bfManager.files[page->file].pageSize;
+  page->data = NULL;
+  BFListId from = page->list;
+
+  if (bfManager.policy == TWO_Q && from == BF_LIST_RECENT)
+  {
+    bfListRemove(e);
+    bfListPush(e, BF_LIST_GHOST_RECENT, 1);
+    while (bfManager.lists[BF_LIST_GHOST_RECENT].size > bfManager.ghostMax)
+      bfDropEntry(bfManager.lists[BF_LIST_GHOST_RECENT].tail);
+  }
+  else if (bfManager.policy == ARC)
+  {
+    bfListRemove(e);
+    bfListPush(e, from == BF_LIST_RECENT ? BF_LIST_GHOST_RECENT : BF_LIST_GHOST_FREQUENT, 1);
+  }
+  else
+    bfDropEntry(e);
+
+  return BF_OK;
+}
+
+/*
+  Returns the least recently used unpinned page of list 'id' (the most recently used one with 'fromHead' 1), or -1.
+*/
+int bfUnpinnedPage(BFListId id, int fromHead)
+{
+  int e = fromHead ? bfManager.lists[id].head : bfManager.lists[id].tail;
+  while (e != -1 && bfManager.pages[e].pins > 0)
+    e = fromHead ? bfManager.pages[e].next : bfManager.pages[e].prev;
+  return e;
+}
+
+/*
+  CLOCK: moves the hand around BF_LIST_FREQUENT, clearing the reference bits it passes, until it finds an unpinned page
+  that was not used since the last round. Returns it, or -1 if every page is pinned.
+*/
+int bfClockVictim()
+{
+  BFList *list = &bfManager.lists[BF_LIST_FREQUENT];
+  for (int steps = 0; steps < 2 * list->size + 1; steps++)
+  {
+    int e = bfManager.hand != -1 ? bfManager.hand : list->head;
+    if (e == -1)
+      return -1;
+    bfManager.hand = bfManager.pages[e].next;
+
+    BFPage *page = &bfManager.pages[e];
+    if (page->pins > 0)
+      continue;
+    if (page->ref)
+    {
+      page->ref = 0;
+      continue;
+    }
+    return e;
+  }
+  return -1;
+}
+
+/*
+  Chooses the page to evict with the policy of BF_Init. 'ghost' is the ghost list the page that is read was found in
+  (BF_LIST_FREE if it was not a ghost), which ARC takes into account. Returns the page, or -1 if every page is pinned.
+*/
+int bfChooseVictim(BFListId ghost)
+{
+  int first, second;
+  switch (bfManager.policy)
+  {
+  case MRU:
+    return bfUnpinnedPage(BF_LIST_FREQUENT, 1);
+  case CLOCK:
+    return bfClockVictim();
+  case TWO_Q:
+    // A1in is evicted first while it is over its share, so a scan can not push out the pages of Am
+    first = bfManager.lists[BF_LIST_RECENT].size > bfManager.recentMax ? BF_LIST_RECENT : BF_LIST_FREQUENT;
+    break;
+  case ARC:
+  {
+    int t1 = bfManager.lists[BF_LIST_RECENT].size;
+    first = t1 > 0 && (t1 > bfManager.arcTarget || (ghost == BF_LIST_GHOST_FREQUENT && t1 == bfManager.arcTarget)) ? BF_LIST_RECENT : BF_LIST_FREQUENT;
+    break;
+  }
+  default:
+    return bfUnpinnedPage(BF_LIST_FREQUENT, 0);
+  }
+
+  second = first == BF_LIST_RECENT ? BF_LIST_FREQUENT : BF_LIST_RECENT;
+  int e = bfUnpinnedPage(first, 0);
+  return e != -1 ? e : bfUnpinnedPage(second, 0);
+}
+
+/*
+  Returns a buffer of 'size' bytes in 'data' for a new page, evicting a page if there are as many as the frames.
+  The buffer of the evicted page is used again when it has the same size.
+*/
+BF_ErrorCode bfGetBuffer(BFListId ghost, int size, char **data)
+{
+  if (bfManager.residentN == bfManager.frames)
+  {
+    int victim = bfChooseVictim(ghost);
+    if (victim == -1)
+      return BF_FULL_MEMORY_ERROR;
+
+    char *victimData;
+    int victimSize;
+    BF_ErrorCode code = bfEvict(victim, &victimData, &victimSize);
+    if (code != BF_OK)
+      return code;
+    if (victimSize == size)
+    {
+      *data = victimData;
+      return BF_OK;
+    }
+    free(victimData);
+    bfManager.residentN--;
+  }
+
+  *data = malloc(size);
+  if (*data == NULL)
+    return BF_ERROR;
+  bfManager.residentN++;
+  return BF_OK;
+}
+
+/*
+  ARC: keeps T1 + B1 at most as many as the frames and all four lists at most twice as many, forgetting the oldest ghosts.
+*/
+void bfTrimArcGhosts()
+{
+  BFList *lists = bfManager.lists;
+  while (lists[BF_LIST_GHOST_RECENT].size > 0 &&
+         lists[BF_LIST_RECENT].size + lists[BF_LIST_GHOST_RECENT].size > bfManager.frames)
+    bfDropEntry(lists[BF_LIST_GHOST_RECENT].tail);
+  while (lists[BF_LIST_GHOST_FREQUENT].size > 0 &&
+         lists[BF_LIST_RECENT].size + lists[BF_LIST_FREQUENT].size + lists[BF_LIST_GHOST_RECENT].size +
+                 lists[BF_LIST_GHOST_FREQUENT].size > 2 * bfManager.frames)
+    bfDropEntry(lists[BF_LIST_GHOST_FREQUENT].tail);
+}
+
+/*
+  Gets a buffer for block 'block_num' of 'file', that is not in memory, in 'data'. If the block was a ghost it is forgotten
+  first, so that the eviction for the buffer can not drop it, and its list is returned in 'ghost' (BF_LIST_FREE if it was not).
+*/
+BF_ErrorCode bfPageBuffer(int file, int block_num, BFListId *ghost, char **data)
+{
+  *ghost = BF_LIST_FREE;
+  int g = bfFindPage(file, block_num);
+  if (g != -1)
+  {
+    *ghost = bfManager.pages[g].list;
+    BFList *lists = bfManager.lists;
+    if (*ghost == BF_LIST_GHOST_RECENT && bfManager.policy == ARC)
+    {
+      int delta = lists[BF_LIST_GHOST_FREQUENT].size / lists[BF_LIST_GHOST_RECENT].size;
+      bfManager.arcTarget += delta > 1 ? delta : 1;
+      if (bfManager.arcTarget > bfManager.frames)
+        bfManager.arcTarget = bfManager.frames;
+    }
+    else if (*ghost == BF_LIST_GHOST_FREQUENT)
+    {
+      int delta = lists[BF_LIST_GHOST_RECENT].size / lists[BF_LIST_GHOST_FREQUENT].size;
+      bfManager.arcTarget -= delta > 1 ? delta : 1;
+      if (bfManager.arcTarget < 0)
+        bfManager.arcTarget = 0;
+    }
+    bfDropEntry(g);
+  }
+
+  return bfGetBuffer(*ghost, bfManager.files[file].pageSize, data);
+}
+
+/*
+  Gives back a buffer of bfPageBuffer that did not become a page.
+*/
+void bfFreeBuffer(char *data)
+{
+  free(data);
+  bfManager.residentN--;
+}
+
+/*
+  Makes 'data' (from bfPageBuffer) the page of block 'block_num' of 'file', pinned once, and returns its entry.
+  'ghost' is the list bfPageBuffer found the block in.
+*/
+int bfInsertPage(int file, int block_num, BFListId ghost, char *data, int dirty)
+{
+  int e = bfNewEntry();
+  BFPage *page = &bfManager.pages[e];
+  page->file = file;
+  page->block_num = block_num;
+  page->pins = 1;
+  page->dirty = dirty;
+  page->loading = 0;
+  page->ref = 1;
+  page->data = data;
+  bfHashInsert(e);
+
+  // a page seen again soon after it was evicted is used often
+  switch (bfManager.policy)
+  {
+  case CLOCK:
+    bfListPush(e, BF_LIST_FREQUENT, 0);
+    break;
+  case TWO_Q:
+    bfListPush(e, ghost == BF_LIST_GHOST_RECENT ? BF_LIST_FREQUENT : BF_LIST_RECENT, 1);
+    break;
+  case ARC:
+    bfListPush(e, ghost != BF_LIST_FREE ? BF_LIST_FREQUENT : BF_LIST_RECENT, 1);
+    bfTrimArcGhosts();
+    break;
+  default:
+    bfListPush(e, BF_LIST_FREQUENT, 1);
+  }
+
+  return e;
+}
+
+/*
+  Brings block 'block_num' of 'file' into memory (reading it from the disk if 'read' is 1, else zeroed) and pins it.
+  The page must not be in memory already. Returns its entry in 'e'.
+  The read is done with bfLatch released: the page is already pinned and marked as loading, so it can not be evicted
+  and other threads wait for it. If the read fails the page is forgotten again.
+*/
+BF_ErrorCode bfLoadPage(int file, int block_num, int read, int *e)
+{
+  BFListId ghost;
+  char *data;
+  BF_ErrorCode code = bfPageBuffer(file, block_num, &ghost, &data);
+  if (code != BF_OK)
+    return code;
+
+  int pageSize = bfManager.files[file].pageSize;
+  if (!read)
+  {
+    memset(data, 0, pageSize);
+    *e = bfInsertPage(file, block_num, ghost, data, 1);
+    return BF_OK;
+  }
+
+  *e = bfInsertPage(file, block_num, ghost, data, 0);
+  BFPage *page = &bfManager.pages[*e];
+  page->loading = 1;
+  int os_fd = bfManager.files[file].os_fd;
+  pthread_mutex_unlock(&bfLatch);
+  code = bfRead(os_fd, data, pageSize, (off_t)block_num * pageSize);
+  pthread_mutex_lock(&bfLatch);
+  page->loading = 0;
+  pthread_cond_broadcast(&bfLoaded);
+
+  if (code != BF_OK)
+  {
+    page->pins = 0;
+    page->data = NULL;
+    bfFreeBuffer(data);
+    bfDropEntry(*e);
+  }
+  return code;
+}
+
+/*
+  Returns 1 if another thread is reading one of the 'n' blocks 'block_nums' of 'file' (bfLoadPage).
+*/
+int bfIsLoading(int file, const int *block_nums, int n)
+{
+  for (int i = 0; i < n; i++)
+  {
+    int e = bfFindPage(file, block_nums[i]);
+    if (e != -1 && bfManager.pages[e].data != NULL && bfManager.pages[e].loading)
+      return 1;
+  }
+  return 0;
+}
+
+/*
+  Brings the 'count' adjacent blocks of 'file' from 'first' on, that are not in memory, into memory with one read (bfReadv)
+  and pins each of them once. Returns their entries in 'entries'.
+*/
+BF_ErrorCode bfLoadRun(int file, int first, int count, int *entries)
+{
+  BFListId ghosts[BF_MAX_RUN];
+  char *data[BF_MAX_RUN];
+  BF_ErrorCode code = BF_OK;
+  int buffers = 0;
+  while (buffers < count && code == BF_OK)
+  {
+    code = bfPageBuffer(file, first + buffers, &ghosts[buffers], &data[buffers]);
+    if (code == BF_OK)
+      buffers++;
+  }
+  if (code == BF_OK)
+  {
+    int pageSize = bfManager.files[file].pageSize;
+    code = bfReadv(bfManager.files[file].os_fd, data, count, pageSize, (off_t)first * pageSize);
+  }
+  if (code != BF_OK)
+  {
+    for (int k = 0; k < buffers; k++)
+      bfFreeBuffer(data[k]);
+    return code;
+  }
+
+  for (int k = 0; k < count; k++)
+    entries[k] = bfInsertPage(file, first + k, ghosts[k], data[k], 0);
+  return BF_OK;
+}
+
+/*
+  Records a use of page 'e' that is already in memory, with the policy of BF_Init.
+*/
+void bfTouchPage(int e)
+{
+  BFPage *page = &bfManager.pages[e];
+  switch (bfManager.policy)
+  {
+  case CLOCK:
+    page->ref = 1;
+    break;
+  case TWO_Q:
+    // a second use while in A1in is still the same burst of uses, only Am is kept in LRU order
+    if (page->list == BF_LIST_FREQUENT)
+    {
+      bfListRemove(e);
+      bfListPush(e, BF_LIST_FREQUENT, 1);
+    }
+    break;
+  case ARC:
+    bfListRemove(e);
+    bfListPush(e, BF_LIST_FREQUENT, 1);
+    break;
+  default:
+    bfListRemove(e);
+    bfListPush(e, BF_LIST_FREQUENT, 1);
+  }
+}
+
+/*
+  Writes the pages of 'file' that are in memory and forgets them, and its ghosts. None of them may be pinned.
+*/
+BF_ErrorCode bfDropFilePages(int file)
+{
+  BF_ErrorCode code = BF_OK;
+  for (int e = 0; e < bfManager.entriesN; e++)
+  {
+    BFPage *page = &bfManager.pages[e];
+    if (page->file != file)
+      continue;
+    if (page->data != NULL)
+    {
+      BF_ErrorCode flushCode = bfFlushPage(e);
+      if (flushCode != BF_OK)
+        code = flushCode;
+      free(page->data);
+      bfManager.residentN--;
+    }
+    bfDropEntry(e);
+  }
+  return code;
+}
+
+/*
+  Returns 1 if a page of 'file' is pinned.
+*/
+int bfHasPinnedPages(int file)
+{
+  if (bfManager.files[file].mapPins > 0)
+    return 1;
+  for (int e = 0; e < bfManager.entriesN; e++)
+    if (bfManager.pages[e].file == file && bfManager.pages[e].pins > 0 && bfManager.pages[e].data != NULL)
+      return 1;
+  return 0;
+}
+
+/*
+  Makes the mapping of 'file' cover its first 'size' bytes, and the file as long as them. The mapping grows in place when
+  it can. Else it moves, only while none of its blocks is pinned, to an address space twice as big.
+*/
+BF_ErrorCode bfGrowMap(int file, size_t size)
+{
+  BFFile *bfFile = &bfManager.files[file];
+  if (ftruncate(bfFile->os_fd, (off_t)size) != 0)
+    return BF_ERROR;
+  if (size <= bfFile->mapSize)
+    return BF_OK;
+
+  size_t mapSize = 2 * bfFile->mapSize > size ? 2 * bfFile->mapSize : size;
+  void *map = mremap(bfFile->map, bfFile->mapSize, mapSize, 0);
+  if (map == MAP_FAILED && bfFile->mapPins == 0)
+    map = mremap(bfFile->map, bfFile->mapSize, mapSize, MREMAP_MAYMOVE);
+  if (map == MAP_FAILED)
+    return bfFile->mapPins > 0 ? BF_AVAILABLE_PIN_BLOCKS_ERROR : BF_ERROR;
+
+  bfFile->map = map;
+  bfFile->mapSize = mapSize;
+  return BF_OK;
+}
+
+/*
+  Pins block 'block_num' of the mapping of 'file' through 'block'.
+*/
+void bfPinMapped(int file, int block_num, BF_Block *block)
+{
+  BFFile *bfFile = &bfManager.files[file];
+  bfFile->mapPins++;
+  block->page = -1;
+  block->file = file;
+  block->data = bfFile->map + (size_t)block_num * bfFile->pageSize;
+}
+
+int bfCompareBlocks(const void *a, const void *b)
+{
+  return *(const int *)a - *(const int *)b;
+}
+
+/*
+  Asks the kernel to start reading the blocks [first, last] of 'file' in the background: the part of its mapping, or of the
+  file that the next bfRead of them finds in the page cache.
+*/
+void bfAdviseRun(int file, int first, int last)
+{
+  BFFile *bfFile = &bfManager.files[file];
+  size_t offset = (size_t)first * bfFile->pageSize;
+  size_t size = (size_t)(last - first + 1) * bfFile->pageSize;
+  if (bfFile->map != NULL)
+  {
+    // madvise wants an address at the start of a page of the system
+    size_t start = offset & ~((size_t)sysconf(_SC_PAGESIZE) - 1);
+    madvise(bfFile->map + start, size + offset - start, MADV_WILLNEED);
+  }
+  else
+    posix_fadvise(bfFile->os_fd, (off_t)offset, (off_t)size, POSIX_FADV_WILLNEED);
+}
+
+/*
+  Checks that 'file_desc' is open in an active BF level and returns its file in 'file'.
+*/
+BF_ErrorCode bfCheckFile(int file_desc, int *file)
+{
+  if (!bfManager.active || file_desc < 0 || file_desc >= BF_MAX_OPEN_FILES || bfManager.handles[file_desc] == -1)
+    return BF_INVALID_FILE_ERROR;
+  *file = bfManager.handles[file_desc];
+  return BF_OK;
+}
+
+void BF_Block_Init(BF_Block **block)
+{
+  *block = malloc(sizeof(BF_Block));
+  (*block)->page = -1;
+  (*block)->file = -1;
+  (*block)->data = NULL;
+}
+
+void BF_Block_Destroy(BF_Block **block)
+{
+  free(*block);
+  *block = NULL;
+}
+
+void BF_Block_SetDirty(BF_Block *block)
+{
+  pthread_mutex_lock(&bfLatch);
+  if (block->page != -1)
+    bfManager.pages[block->page].dirty = 1;
+  pthread_mutex_unlock(&bfLatch);
+}
+
+char *BF_Block_GetData(const BF_Block *block)
+{
+  return block->data;
+}
+
+BF_ErrorCode bfInitPool(const ReplacementAlgorithm repl_alg, int frames)
+{
+  if (bfManager.active)
+    return BF_ACTIVE_ERROR;
+  if (frames < 1 || repl_alg < LRU || repl_alg > ARC)
+    return BF_ERROR;
+
+  bfManager.policy = repl_alg;
+  bfManager.frames = frames;
+  bfManager.entriesN = 2 * frames + 1;
+  bfManager.pages = malloc(bfManager.entriesN * sizeof(BFPage));
+  bfManager.hashSize = 1;
+  while (bfManager.hashSize < 2 * bfManager.entriesN)
+    bfManager.hashSize *= 2;
+  bfManager.hash = malloc(bfManager.hashSize * sizeof(int));
+  if (bfManager.pages == NULL || bfManager.hash == NULL)
+  {
+    free(bfManager.pages);
+    free(bfManager.hash);
+    return BF_ERROR;
+  }
+
+  for (int h = 0; h < bfManager.hashSize; h++)
+    bfManager.hash[h] = -1;
+  for (int l = 0; l < BF_LISTS; l++)
+  {
+    bfManager.lists[l].head = bfManager.lists[l].tail = -1;
+    bfManager.lists[l].size = 0;
+  }
+  for (int e = 0; e < bfManager.entriesN; e++)
+  {
+    bfManager.pages[e].file = -1;
+    bfManager.pages[e].data = NULL;
+    bfListPush(e, BF_LIST_FREE, 0);
+  }
+  bfManager.residentN = 0;
+  for (int i = 0; i < BF_MAX_OPEN_FILES; i++)
+  {
+    bfManager.files[i].refs = 0;
+    bfManager.handles[i] = -1;
+  }
+
+  bfManager.hand = -1;
+  bfManager.arcTarget = 0;
+  bfManager.recentMax = frames / 4 > 1 ? frames / 4 : 1;
+  bfManager.ghostMax = frames / 2 > 1 ? frames / 2 : 1;
+  bfManager.active = 1;
+  return BF_OK;
+}
+
+BF_ErrorCode BF_InitPool(const ReplacementAlgorithm repl_alg, int frames)
+{
+  pthread_mutex_lock(&bfLatch);
+  BF_ErrorCode code = bfInitPool(repl_alg, frames);
+  pthread_mutex_unlock(&bfLatch);
+  return code;
+}
+
+BF_ErrorCode BF_Init(const ReplacementAlgorithm repl_alg)
+{
+  return BF_InitPool(repl_alg, BF_BUFFER_SIZE);
+}
+
+BF_ErrorCode bfGetPoolSize(int *frames)
+{
+  if (!bfManager.active)
+    return BF_ERROR;
+
+  *frames = bfManager.frames;
+  return BF_OK;
+}
+
+BF_ErrorCode BF_GetPoolSize(int *frames)
+{
+  pthread_mutex_lock(&bfLatch);
+  BF_ErrorCode code = bfGetPoolSize(frames);
+  pthread_mutex_unlock(&bfLatch);
+  return code;
+}
+
+BF_ErrorCode BF_CreateFile(const char *filename)
+{
+  int os_fd = open(filename, O_RDWR | O_CREAT | O_EXCL, 0644);
+  if (os_fd < 0)
+    return errno == EEXIST ? BF_FILE_ALREADY_EXISTS : BF_ERROR;
+  close(os_fd);
+  return BF_OK;
+}
+
+BF_ErrorCode bfOpenFile(const char *filename, int *file_desc)
+{
+  if (!bfManager.active)
+    return BF_ERROR;
+
+  int fd = 0;
+  while (fd < BF_MAX_OPEN_FILES && bfManager.handles[fd] != -1)
+    fd++;
+  if (fd == BF_MAX_OPEN_FILES)
+    return BF_OPEN_FILES_LIMIT_ERROR;
+
+  int os_fd = open(filename, O_RDWR);
+  if (os_fd < 0)
+    return BF_ERROR;
+  struct stat st;
+  if (fstat(os_fd, &st) != 0)
+  {
+    close(os_fd);
+    return BF_ERROR;
+  }
+
+  // a file that is already open shares its pages with the new file_desc
+  int file = -1, freeFile = -1;
+  for (int i = 0; i < BF_MAX_OPEN_FILES && file == -1; i++)
+  {
+    if (bfManager.files[i].refs == 0)
+    {
+      if (freeFile == -1)
+        freeFile = i;
+    }
+    else if (bfManager.files[i].dev == st.st_dev && bfManager.files[i].ino == st.st_ino)
+      file = i;
+  }
+
+  if (file != -1)
+    close(os_fd);
+  else
+  {
+    file = freeFile;
+    bfManager.files[file].os_fd = os_fd;
+    bfManager.files[file].dev = st.st_dev;
+    bfManager.files[file].ino = st.st_ino;
+    bfManager.files[file].blocks = (int)(st.st_size / BF_BLOCK_SIZE);
+    bfManager.files[file].pageSize = BF_BLOCK_SIZE;
+    bfManager.files[file].map = NULL;
+    bfManager.files[file].mapSize = 0;
+    bfManager.files[file].mapPins = 0;
+  }
+
+  bfManager.files[file].refs++;
+  bfManager.handles[fd] = file;
+  *file_desc = fd;
+  return BF_OK;
+}
+
+BF_ErrorCode BF_OpenFile(const char *filename, int *file_desc)
+{
+  pthread_mutex_lock(&bfLatch);
+  BF_ErrorCode code = bfOpenFile(filename, file_desc);
+  pthread_mutex_unlock(&bfLatch);
+  return code;
+}
+
+BF_ErrorCode bfCloseFile(const int file_desc)
+{
+  int file;
+  BF_ErrorCode code = bfCheckFile(file_desc, &file);
+  if (code != BF_OK)
+    return code;
+
+  if (bfHasPinnedPages(file))
+    return BF_AVAILABLE_PIN_BLOCKS_ERROR;
+
+  bfManager.handles[file_desc] = -1;
+  if (--bfManager.files[file].refs > 0)
+    return BF_OK;
+
+  // the last file_desc of the file
+  BFFile *bfFile = &bfManager.files[file];
+  code = bfDropFilePages(file);
+  if (bfFile->map != NULL)
+  {
+    if (msync(bfFile->map, (size_t)bfFile->blocks * bfFile->pageSize, MS_SYNC) != 0)
+      code = BF_ERROR;
+    munmap(bfFile->map, bfFile->mapSize);
+    bfFile->map = NULL;
+  }
+  if (close(bfFile->os_fd) != 0)
+    code = BF_ERROR;
+  return code;
+}
+
+BF_ErrorCode BF_CloseFile(const int file_desc)
+{
+  pthread_mutex_lock(&bfLatch);
+  BF_ErrorCode code = bfCloseFile(file_desc);
+  pthread_mutex_unlock(&bfLatch);
+  return code;
+}
+
+BF_ErrorCode bfMapFile(const int file_desc)
+{
+  int file;
+  BF_ErrorCode code = bfCheckFile(file_desc, &file);
+  if (code != BF_OK)
+    return code;
+  BFFile *bfFile = &bfManager.files[file];
+  if (bfFile->map != NULL)
+    return BF_OK;
+  if (bfHasPinnedPages(file))
+    return BF_AVAILABLE_PIN_BLOCKS_ERROR;
+
+  // the pages in memory are written first, the mapping sees the file as it is on the disk
+  code = bfDropFilePages(file);
+  if (code != BF_OK)
+    return code;
+  size_t size = (size_t)bfFile->blocks * bfFile->pageSize;
+  if (ftruncate(bfFile->os_fd, (off_t)size) != 0)
+    return BF_ERROR;
+
+  size_t mapSize = size > BF_MAP_MIN_SIZE ? size : BF_MAP_MIN_SIZE;
+  void *map = mmap(NULL, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, bfFile->os_fd, 0);
+  if (map == MAP_FAILED)
+    return BF_ERROR;
+
+  bfFile->map = map;
+  bfFile->mapSize = mapSize;
+  bfFile->mapPins = 0;
+  return BF_OK;
+}
+
+BF_ErrorCode BF_MapFile(const int file_desc)
+{
+  pthread_mutex_lock(&bfLatch);
+  BF_ErrorCode code = bfMapFile(file_desc);
+  pthread_mutex_unlock(&bfLatch);
+  return code;
+}
+
+BF_ErrorCode bfSetPageSize(const int file_desc, const int page_size)
+{
+  int file;
+  BF_ErrorCode code = bfCheckFile(file_desc, &file);
+  if (code != BF_OK)
+    return code;
+  if (page_size < BF_BLOCK_SIZE || page_size > BF_MAX_PAGE_SIZE || (page_size & (page_size - 1)) != 0)
+    return BF_ERROR;
+  if (bfManager.files[file].pageSize == page_size)
+    return BF_OK;
+  if (bfHasPinnedPages(file))
+    return BF_AVAILABLE_PIN_BLOCKS_ERROR;
+
+  // the pages in memory have the old size, they are written and read again with the new one
+  code = bfDropFilePages(file);
+  if (code != BF_OK)
+    return code;
+  struct stat st;
+  if (fstat(bfManager.files[file].os_fd, &st) != 0)
+    return BF_ERROR;
+
+  bfManager.files[file].pageSize = page_size;
+  bfManager.files[file].blocks = (int)((st.st_size + page_size - 1) / page_size);
+
+  // a mapped file must be as long as its blocks
+  if (bfManager.files[file].map != NULL)
+    return bfGrowMap(file, (size_t)bfManager.files[file].blocks * page_size);
+  return BF_OK;
+}
+
+BF_ErrorCode BF_SetPageSize(const int file_desc, const int page_size)
+{
+  pthread_mutex_lock(&bfLatch);
+  BF_ErrorCode code = bfSetPageSize(file_desc, page_size);
+  pthread_mutex_unlock(&bfLatch);
+  return code;
+}
+
+BF_ErrorCode bfGetPageSize(const int file_desc, int *page_size)
+{
+  int file;
+  BF_ErrorCode code = bfCheckFile(file_desc, &file);
+  if (code != BF_OK)
+    return code;
+
+  *page_size = bfManager.files[file].pageSize;
+  return BF_OK;
+}
+
+BF_ErrorCode BF_GetPageSize(const int file_desc, int *page_size)
+{
+  pthread_mutex_lock(&bfLatch);
+  BF_ErrorCode code = bfGetPageSize(file_desc, page_size);
+  pthread_mutex_unlock(&bfLatch);
+  return code;
+}
+
+BF_ErrorCode bfGetBlockCounter(const int file_desc, int *blocks_num)
+{
+  int file;
+  BF_ErrorCode code = bfCheckFile(file_desc, &file);
+  if (code != BF_OK)
+    return code;
+
+  *blocks_num = bfManager.files[file].blocks;
+  return BF_OK;
+}
+
+BF_ErrorCode BF_GetBlockCounter(const int file_desc, int *blocks_num)
+{
+  pthread_mutex_lock(&bfLatch);
+  BF_ErrorCode code = bfGetBlockCounter(file_desc, blocks_num);
+  pthread_mutex_unlock(&bfLatch);
+  return code;
+}
+
+BF_ErrorCode bfAllocateBlock(const int file_desc, BF_Block *block)
+{
+  int file;
+  BF_ErrorCode code = bfCheckFile(file_desc, &file);
+  if (code != BF_OK)
+    return code;
+
+  // a mapped file grows by a block, that is zeroed like the rest of the file after ftruncate
+  BFFile *bfFile = &bfManager.files[file];
+  if (bfFile->map != NULL)
+  {
+    code = bfGrowMap(file, (size_t)(bfFile->blocks + 1) * bfFile->pageSize);
+    if (code != BF_OK)
+      return code;
+    bfPinMapped(file, bfFile->blocks, block);
+    bfFile->blocks++;
+    return BF_OK;
+  }
+
+  // the block is new, nothing is read: it is zeroed and written when it is evicted or the file closes
+  int e;
+  code = bfLoadPage(file, bfManager.files[file].blocks, 0, &e);
+  if (code != BF_OK)
+    return code;
+
+  bfManager.files[file].blocks++;
+  block->page = e;
+  block->file = -1;
+  block->data = bfManager.pages[e].data;
+  return BF_OK;
+}
+
+BF_ErrorCode BF_AllocateBlock(const int file_desc, BF_Block *block)
+{
+  pthread_mutex_lock(&bfLatch);
+  BF_ErrorCode code = bfAllocateBlock(file_desc, block);
+  pthread_mutex_unlock(&bfLatch);
+  return code;
+}
+
+BF_ErrorCode bfPrefetch(const int file_desc, const int *block_nums, const int n)
+{
+  int file;
+  BF_ErrorCode code = bfCheckFile(file_desc, &file);
+  if (code != BF_OK)
+    return code;
+  if (n <= 0)
+    return BF_OK;
+
+  // only the blocks that a BF_GetBlock would read, in the order of the file
+  BFFile *bfFile = &bfManager.files[file];
+  int *blocks = malloc(n * sizeof(int));
+  if (blocks == NULL)
+    return BF_ERROR;
+  int m = 0;
+  for (int i = 0; i < n; i++)
+  {
+    if (block_nums[i] < 0 || block_nums[i] >= bfFile->blocks)
+      continue;
+    if (bfFile->map == NULL)
+    {
+      int e = bfFindPage(file, block_nums[i]);
+      if (e != -1 && bfManager.pages[e].data != NULL)
+        continue;
+    }
+    blocks[m++] = block_nums[i];
+  }
+  qsort(blocks, m, sizeof(int), bfCompareBlocks);
+
+  // one request for each run of adjacent blocks
+  for (int i = 0, j; i < m; i = j + 1)
+  {
+    for (j = i; j + 1 < m && blocks[j + 1] <= blocks[j] + 1; j++)
+      ;
+    bfAdviseRun(file, blocks[i], blocks[j]);
+  }
+
+  free(blocks);
+  return BF_OK;
+}
+
+BF_ErrorCode BF_Prefetch(const int file_desc, const int *block_nums, const int n)
+{
+  pthread_mutex_lock(&bfLatch);
+  BF_ErrorCode code = bfPrefetch(file_desc, block_nums, n);
+  pthread_mutex_unlock(&bfLatch);
+  return code;
+}
+
+BF_ErrorCode bfGetBlock(const int file_desc, const int block_num, BF_Block *block)
+{
+  int file;
+  BF_ErrorCode code = bfCheckFile(file_desc, &file);
+  if (code != BF_OK)
+    return code;
+  if (block_num < 0 || block_num >= bfManager.files[file].blocks)
+    return BF_INVALID_BLOCK_NUMBER_ERROR;
+
+  // no read and no copy, the block is where the file is mapped
+  if (bfManager.files[file].map != NULL)
+  {
+    bfPinMapped(file, block_num, block);
+    return BF_OK;
+  }
+
+  // a block that another thread is reading is looked up again once it is read (or the read failed)
+  int e = bfFindPage(file, block_num);
+  while (e != -1 && bfManager.pages[e].data != NULL && bfManager.pages[e].loading)
+  {
+    pthread_cond_wait(&bfLoaded, &bfLatch);
+    e = bfFindPage(file, block_num);
+  }
+  if (e != -1 && bfManager.pages[e].data != NULL)
+  {
+    bfManager.pages[e].pins++;
+    bfTouchPage(e);
+  }
+  else
+  {
+    code = bfLoadPage(file, block_num, 1, &e);
+    if (code != BF_OK)
+      return code;
+  }
+
+  block->page = e;
+  block->file = -1;
+  block->data = bfManager.pages[e].data;
+  return BF_OK;
+}
+
+BF_ErrorCode BF_GetBlock(const int file_desc, const int block_num, BF_Block *block)
+{
+  pthread_mutex_lock(&bfLatch);
+  BF_ErrorCode code = bfGetBlock(file_desc, block_num, block);
+  pthread_mutex_unlock(&bfLatch);
+  return code;
+}
+
+BF_ErrorCode bfGetBlocks(const int file_desc, const int *block_nums, const int n, BF_Block **blocks)
+{
+  int file;
+  BF_ErrorCode code = bfCheckFile(file_desc, &file);
+  if (code != BF_OK)
+    return code;
+  for (int i = 0; i < n; i++)
+    if (block_nums[i] < 0 || block_nums[i] >= bfManager.files[file].blocks)
+      return BF_INVALID_BLOCK_NUMBER_ERROR;
+  if (n <= 0)
+    return BF_OK;
+
+  if (bfManager.files[file].map != NULL)
+  {
+    for (int i = 0; i < n; i++)
+      bfPinMapped(file, block_nums[i], blocks[i]);
+    return BF_OK;
+  }
+
+  // the blocks that other threads are reading are waited for, the rest of the call keeps bfLatch
+  while (bfIsLoading(file, block_nums, n))
+    pthread_cond_wait(&bfLoaded, &bfLatch);
+
+  // the blocks in memory are pinned first, so that reading the others can not evict them
+  int *missing = malloc(2 * n * sizeof(int));
+  if (missing == NULL)
+    return BF_ERROR;
+  int *entries = missing + n;
+  int m = 0;
+  for (int i = 0; i < n; i++)
+  {
+    int e = bfFindPage(file, block_nums[i]);
+    if (e != -1 && bfManager.pages[e].data != NULL)
+    {
+      bfManager.pages[e].pins++;
+      bfTouchPage(e);
+      blocks[i]->page = e;
+      blocks[i]->file = -1;
+      blocks[i]->data = bfManager.pages[e].data;
+    }
+    else
+    {
+      blocks[i]->page = -1;
+      missing[m++] = block_nums[i];
+    }
+  }
+  qsort(missing, m, sizeof(int), bfCompareBlocks);
+  int distinct = 0;
+  for (int i = 0; i < m; i++)
+    if (distinct == 0 || missing[i] != missing[distinct - 1])
+      missing[distinct++] = missing[i];
+  m = distinct;
+
+  // one preadv for each run of adjacent blocks
+  int loaded = 0;
+  for (int i = 0, j; i < m && code == BF_OK; i = j + 1)
+  {
+    for (j = i; j + 1 < m && missing[j + 1] == missing[j] + 1 && j + 1 - i < BF_MAX_RUN; j++)
+      ;
+    code = bfLoadRun(file, missing[i], j - i + 1, entries + i);
+    if (code == BF_OK)
+      loaded = j + 1;
+  }
+
+  if (code == BF_OK)
+    for (int i = 0; i < n; i++)
+      if (blocks[i]->page == -1)
+      {
+        int e = bfFindPage(file, block_nums[i]);
+        bfManager.pages[e].pins++;
+        blocks[i]->page = e;
+        blocks[i]->file = -1;
+        blocks[i]->data = bfManager.pages[e].data;
+      }
+
+  // the pins of the reading, and after an error every pin of this call, are dropped
+  for (int k = 0; k < loaded; k++)
+    bfManager.pages[entries[k]].pins--;
+  if (code != BF_OK)
+    for (int i = 0; i < n; i++)
+      if (blocks[i]->page != -1)
+      {
+        bfManager.pages[blocks[i]->page].pins--;
+        blocks[i]->page = -1;
+        blocks[i]->data = NULL;
+      }
+
+  free(missing);
+  return code;
+}
+
+BF_ErrorCode BF_GetBlocks(const int file_desc, const int *block_nums, const int n, BF_Block **blocks)
+{
+  pthread_mutex_lock(&bfLatch);
+  BF_ErrorCode code = bfGetBlocks(file_desc, block_nums, n, blocks);
+  pthread_mutex_unlock(&bfLatch);
+  return code;
+}
+
+BF_ErrorCode bfUnpinBlock(BF_Block *block)
+{
+  if (block->file != -1)
+  {
+    if (bfManager.files[block->file].mapPins == 0)
+      return BF_ERROR;
+    bfManager.files[block->file].mapPins--;
+    block->file = -1;
+    block->data = NULL;
+    return BF_OK;
+  }
+  if (block->page == -1 || bfManager.pages[block->page].pins == 0)
+    return BF_ERROR;
+
+  bfManager.pages[block->page].pins--;
+  block->page = -1;
+  block->data = NULL;
+  return BF_OK;
+}
+
+BF_ErrorCode BF_UnpinBlock(BF_Block *block)
+{
+  pthread_mutex_lock(&bfLatch);
+  BF_ErrorCode code = bfUnpinBlock(block);
+  pthread_mutex_unlock(&bfLatch);
+  return code;
+}
+
+BF_ErrorCode bfUnpinBlocks(BF_Block **blocks, const int n)
+{
+  BF_ErrorCode code = BF_OK;
+  for (int i = 0; i < n; i++)
+  {
+    BF_ErrorCode unpinCode = bfUnpinBlock(blocks[i]);
+    if (unpinCode != BF_OK)
+      code = unpinCode;
+  }
+  return code;
+}
+
+BF_ErrorCode BF_UnpinBlocks(BF_Block **blocks, const int n)
+{
+  pthread_mutex_lock(&bfLatch);
+  BF_ErrorCode code = bfUnpinBlocks(blocks, n);
+  pthread_mutex_unlock(&bfLatch);
+  return code;
+}
+
+void BF_PrintError(BF_ErrorCode err)
+{
+  const char *message;
+  switch (err)
+  {
+  case BF_OK:
+    return;
+  case BF_OPEN_FILES_LIMIT_ERROR:
+    message = "The max number of open files has been reached";
+    break;
+  case BF_INVALID_FILE_ERROR:
+    message = "The file has not been openned";
+    break;
+  case BF_ACTIVE_ERROR:
+    message = "The BF level is already active";
+    break;
+  case BF_FILE_ALREADY_EXISTS:
+    message = "The file is already being used";
+    break;
+  case BF_FULL_MEMORY_ERROR:
+    message = "BF memory is full";
+    break;
+  case BF_INVALID_BLOCK_NUMBER_ERROR:
+    message = "The block number doesn't exists into the file";
+    break;
+  case BF_AVAILABLE_PIN_BLOCKS_ERROR:
+    message = "The file can not be closed because there are available pin blocks";
+    break;
+  default:
+    message = "Unknown error";
+  }
+  fprintf(stderr, "BF Error: %s\n", message);
+}
+
+BF_ErrorCode bfClose()
+{
+  if (!bfManager.active)
+    return BF_ERROR;
+
+  // close every file that is still open, even with pinned blocks, so nothing is lost
+  BF_ErrorCode code = BF_OK;
+  for (int fd = 0; fd < BF_MAX_OPEN_FILES; fd++)
+  {
+    if (bfManager.handles[fd] == -1)
+      continue;
+    for (int e = 0; e < bfManager.entriesN; e++)
+      if (bfManager.pages[e].file == bfManager.handles[fd])
+        bfManager.pages[e].pins = 0;
+    bfManager.files[bfManager.handles[fd]].mapPins = 0;
+    if (bfCloseFile(fd) != BF_OK)
+      code = BF_ERROR;
+  }
+
+  free(bfManager.pages);
+  free(bfManager.hash);
+  bfManager.active = 0;
+  return code;
+}
+
+BF_ErrorCode BF_Close()
+{
+  pthread_mutex_lock(&bfLatch);
+  BF_ErrorCode code = bfClose();
+  pthread_mutex_unlock(&bfLatch);
+  return code;
+}
@@ -17,27 +17,91 @@
     }                         \
   }
 
-typedef struct
+IndexNode indexArray[MAX_OPEN_FILES];
+int htPageSize = BF_BLOCK_SIZE;
+
+/*
+  returns the slot of the record at position 'index' of block 'blockId', for a file with 'recordsN' records per bucket
+*/
+tid getTid(int blockId, int index, int recordsN)
 {
-  int size;
-} HashHeader;
+  tid temp = (blockId + 1) * recordsN + index;
+  return temp;
+}
 
-typedef struct
+/*
+  Returns the size of the blocks of the open file 'fd'. Only the BF level of src/bf.c (BF_SRC) has blocks bigger than BF_BLOCK_SIZE.
+*/
+int getPageSize(int fd)
 {
-  int value;
-  int block_num;
-} HashNode;
+  int pageSize = BF_BLOCK_SIZE;
+#ifdef BF_SRC
+  if (BF_GetPageSize(fd, &pageSize) != BF_OK)
+    return BF_BLOCK_SIZE;
+#else
+  (void)fd;
+#endif
+  return pageSize;
+}
 
-typedef struct
+/*
+  Sets the size of the blocks of the open file 'fd' to 'pageSize', before any of its blocks is read.
+*/
+HT_ErrorCode setPageSize(int fd, int pageSize)
+{
+  if (pageSize == getPageSize(fd))
+    return HT_OK;
+#ifdef BF_SRC
+  CALL_BF(BF_SetPageSize(fd, pageSize));
+  return HT_OK;
+#else
+  printf("Blocks of %d bytes need the BF level of src/bf.c (make ... BF=src)!\n", pageSize);
+  return HT_ERROR;
+#endif
+}
+
+/*
+  block: previously initialized BF_Block pointer (does not get destroyed)
+  Sets the size of the blocks of the file with fileDesc 'fd', that was just opened, to the page_size of its info block.
+  The info block starts at the start of the file whatever the size of the blocks, so it is read with the default one first.
+*/
+HT_ErrorCode loadPageSize(int fd, BF_Block *block)
 {
-  HashHeader header;
-  HashNode hashNode[MAX_HNODES];
-} HashEntry;
+  CALL_BF(BF_GetBlock(fd, 0, block));
+  int pageSize = ((InfoHeader *)BF_Block_GetData(block))->page_size;
+  CALL_BF(BF_UnpinBlock(block));
+
+  // files written before page_size was kept have 0 there
+  return setPageSize(fd, pageSize == 0 ? BF_BLOCK_SIZE : pageSize);
+}
 
-tid getTid(int blockId, int index)
+/*
+  Asks the BF level to start reading the 'n' blocks of 'blocks' of the file 'fd' in the background (BF_Prefetch), before a
+  loop pins them one by one. Only the BF level of src/bf.c (BF_SRC) reads ahead, with lib/libbf.so it does nothing.
+*/
+void prefetchBlocks(int fd, int *blocks, int n)
 {
-  tid temp = (blockId + 1) * MAX_RECORDS + index;
-  return temp;
+#ifdef BF_SRC
+  BF_Prefetch(fd, blocks, n);
+#else
+  (void)fd;
+  (void)blocks;
+  (void)n;
+#endif
+}
+
+/*
+  Prefetches every bucket of 'hashTable' once, for a loop over all its buckets. The hash values of a bucket are next to each other.
+*/
+void prefetchBuckets(int fd, HashTable *hashTable)
+{
+  int *blocks = malloc(hashTable->size * sizeof(int));
+  int n = 0;
+  for (int i = 0; i < hashTable->size; i++)
+    if (n == 0 || hashTable->hashNode[i].block_num != blocks[n - 1])
+      blocks[n++] = hashTable->hashNode[i].block_num;
+  prefetchBlocks(fd, blocks, n);
+  free(blocks);
 }
 
 /*
@@ -48,7 +112,7 @@ void printUpdateArray(UpdateRecordArray *array)
   if (array[0].oldTupleId == -1)
     return;
   printf("\n\n");
-  for (int i = 0; i < MAX_RECORDS; i++)
+  for (int i = 0; i < (int)MAX_UPDATES && !(array[i].oldTupleId == -1 && array[i].newTupleId == -1); i++)
     printf("city: %s, surname: %s, oldTid: %i, newTid: %i\n",
            array[i].city, array[i].surname, array[i].oldTupleId, array[i].newTupleId);
 }
@@ -65,9 +129,9 @@ void printRecord(Record record)
 /*
   prints the contents of a 'hashNode'
 */
-void printHashNode(HashNode hashNode)
+void printHashNode(int value, HashNode hashNode)
 {
-  printf("HashNode with value : %i, and block_num : %i\n", hashNode.value, hashNode.block_num);
+  printf("HashNode with value : %i, and block_num : %i\n", value, hashNode.block_num);
 }
 
 /*
@@ -80,6 +144,10 @@ unsigned int hashFunction(int id, int depth)
   unsigned int h = 0x811c9dc5;
   int i;
 
+  // a table of depth 0 has a single hash value (and >> 32 is undefined)
+  if (depth == 0)
+    return 0;
+
   for (i = 0; i < sizeof(int); i++)
     h = (h ^ p[i]) * 0x01000193;
   h = h >> (32 - depth);
@@ -87,6 +155,83 @@ unsigned int hashFunction(int id, int depth)
   return h;
 }
 
+/*
+  returns the full (32 bit) hash value of the string 'str', the secondary index keeps its first bits (hashAttr)
+*/
+unsigned int hashString(const char *str)
+{
+  unsigned int hash = 5381;
+  int c;
+
+  while ((c = *str++) != '\0')
+    hash = ((hash << 5) + hash) + c; /* hash * 33 + c */
+
+  return hash;
+}
+
+/*
+  returns the hash value that the grace join partitions 'key' with, at repartitioning 'level'.
+  Level 0 is hashString, every other level is a differently seeded FNV-1a hash, so keys that fell in the same
+  partition (even keys with the same hashString) are spread again.
+*/
+unsigned int joinHash(const char *key, int level)
+{
+  if (level == 0)
+    return hashString(key);
+
+  unsigned int hash = 2166136261u ^ ((unsigned int)level * 0x9e3779b9u);
+  int c;
+
+  while ((c = *key++) != '\0')
+    hash = (hash ^ (unsigned char)c) * 16777619u;
+
+  return hash;
+}
+
+HT_ErrorCode HT_SetPageSize(int pageSize)
+{
+  if (pageSize < BF_BLOCK_SIZE || pageSize > BF_MAX_PAGE_SIZE || (pageSize & (pageSize - 1)) != 0)
+  {
+    printf("The page size must be a power of 2 from %d to %d bytes!\n", BF_BLOCK_SIZE, BF_MAX_PAGE_SIZE);
+    return HT_ERROR;
+  }
+#ifndef BF_SRC
+  if (pageSize != BF_BLOCK_SIZE)
+  {
+    printf("Blocks of %d bytes need the BF level of src/bf.c (make ... BF=src)!\n", pageSize);
+    return HT_ERROR;
+  }
+#endif
+  htPageSize = pageSize;
+  return HT_OK;
+}
+
+HT_ErrorCode HT_InitBF(const ReplacementAlgorithm repl_alg, int frames)
+{
+  if (frames < 1)
+  {
+    printf("The BF level needs at least one block in memory!\n");
+    return HT_ERROR;
+  }
+#ifdef BF_SRC
+  CALL_BF(BF_InitPool(repl_alg, frames));
+#else
+  // lib/libbf.so knows only LRU and MRU, and has BF_BUFFER_SIZE blocks
+  if (repl_alg != LRU && repl_alg != MRU)
+  {
+    printf("Only LRU and MRU are available without the BF level of src/bf.c (make ... BF=src)!\n");
+    return HT_ERROR;
+  }
+  if (frames != BF_BUFFER_SIZE)
+  {
+    printf("%d blocks in memory need the BF level of src/bf.c (make ... BF=src)!\n", frames);
+    return HT_ERROR;
+  }
+  CALL_BF(BF_Init(repl_alg));
+#endif
+  return HT_OK;
+}
+
 HT_ErrorCode HT_Init()
 {
   if (MAX_OPEN_FILES <= 0)
@@ -116,65 +261,254 @@ HT_ErrorCode checkCreateIndex(const char *filename, int depth)
     printf("Depth input is wrong! Please give a NON-NEGATIVE number!\n");
     return HT_ERROR;
   }
+  if (depth > HT_MAX_DEPTH)
+  {
+    printf("Depth input is wrong! Please give at most %d!\n", HT_MAX_DEPTH);
+    return HT_ERROR;
+  }
   return HT_OK;
 }
 
 /*
   block: previously initialized BF_Block pointer (does not get destroyed)
-  allocates and stores to the first block of the file with fileDesc 'fd', the global 'depht'
+  allocates and stores to the first block of the file with fileDesc 'fd', the global 'depht' and an empty list of free blocks
 */
 HT_ErrorCode createInfoBlock(int fd, BF_Block *block, int depth)
 {
   CALL_BF(BF_AllocateBlock(fd, block));
-  char *data = BF_Block_GetData(block);
-  memcpy(data, &depth, sizeof(int));
+  InfoHeader *info = (InfoHeader *)BF_Block_GetData(block);
+  info->depth = depth;
+  info->free_block = -1;
+  info->tid_map = -1;
+  info->page_size = getPageSize(fd);
   BF_Block_SetDirty(block);
   CALL_BF(BF_UnpinBlock(block));
   return HT_OK;
 }
 
+/*
+  Returns how many directory blocks are needed for a HashTable with 'size' hash values, 'nodesN' in each block.
+*/
+int getHashTablePagesN(int size, int nodesN)
+{
+  return (size + nodesN - 1) / nodesN;
+}
+
+/*
+  Marks the directory blocks that hold hash values [first, last] as changed.
+*/
+void markHashTableDirty(HashTable *hashTable, int first, int last)
+{
+  for (int p = first / hashTable->nodesN; p <= last / hashTable->nodesN; p++)
+    hashTable->dirtyPages[p] = 1;
+}
+
+/*
+  Frees the memory held by an in-memory HashTable.
+*/
+void freeHashTable(HashTable *hashTable)
+{
+  free(hashTable->hashNode);
+  free(hashTable->pages);
+  free(hashTable->dirtyPages);
+  hashTable->hashNode = NULL;
+  hashTable->pages = NULL;
+  hashTable->dirtyPages = NULL;
+  hashTable->size = hashTable->pagesN = 0;
+}
+
+/*
+  Returns how many blocks are needed for a TidMap with 'size' tuple ids, 'slotsN' in each block.
+*/
+int getTidMapPagesN(int size, int slotsN)
+{
+  return (size + slotsN - 1) / slotsN;
+}
+
+/*
+  Marks the blocks of the TidMap that hold tuple ids [first, last] as changed.
+*/
+void markTidMapDirty(TidMap *tidMap, int first, int last)
+{
+  for (int p = first / tidMap->slotsN; p <= last / tidMap->slotsN; p++)
+    tidMap->dirtyPages[p] = 1;
+}
+
+/*
+  Initializes an empty in-memory TidMap of a file with blocks of 'pageSize' bytes, with room for 'capacity' tuple ids.
+  It has no blocks at the disk yet.
+*/
+void initTidMap(TidMap *tidMap, int capacity, int pageSize)
+{
+  tidMap->slotsN = MAX_TID_SLOTS(pageSize);
+  tidMap->recordsN = MAX_RECORDS(pageSize);
+  if (capacity < tidMap->slotsN)
+    capacity = tidMap->slotsN;
+
+  tidMap->size = 0;
+  tidMap->capacity = capacity;
+  tidMap->slot = malloc(capacity * sizeof(tid));
+  tidMap->freeN = 0;
+  tidMap->freeTids = malloc(capacity * sizeof(tid));
+  tidMap->ownerN = 0;
+  tidMap->owner = NULL;
+  tidMap->pagesN = 0;
+  tidMap->pages = NULL;
+  tidMap->dirtyPages = calloc(getTidMapPagesN(capacity, tidMap->slotsN), sizeof(char));
+}
+
+/*
+  Frees the memory held by an in-memory TidMap.
+*/
+void freeTidMap(TidMap *tidMap)
+{
+  free(tidMap->slot);
+  free(tidMap->freeTids);
+  free(tidMap->owner);
+  free(tidMap->pages);
+  free(tidMap->dirtyPages);
+  tidMap->slot = tidMap->freeTids = tidMap->owner = NULL;
+  tidMap->pages = NULL;
+  tidMap->dirtyPages = NULL;
+  tidMap->size = tidMap->capacity = tidMap->freeN = tidMap->ownerN = tidMap->pagesN = 0;
+}
+
+/*
+  Sets the tuple id of the record at slot 'slot' (getTid(block, index, recordsN)) to 'tupleId', growing 'owner' if needed.
+*/
+void setSlotOwner(TidMap *tidMap, tid slot, tid tupleId)
+{
+  if (slot >= tidMap->ownerN)
+  {
+    int size = tidMap->ownerN == 0 ? 1024 : tidMap->ownerN;
+    while (slot >= size)
+      size *= 2;
+    tidMap->owner = realloc(tidMap->owner, size * sizeof(tid));
+    for (int i = tidMap->ownerN; i < size; i++)
+      tidMap->owner[i] = -1;
+    tidMap->ownerN = size;
+  }
+  tidMap->owner[slot] = tupleId;
+}
+
+/*
+  Returns the tuple id of the record at slot 'slot', or -1 if there is none.
+*/
+tid getSlotOwner(TidMap *tidMap, tid slot)
+{
+  return slot < tidMap->ownerN ? tidMap->owner[slot] : -1;
+}
+
+/*
+  Gives a tuple id to the new record at slot 'slot': the last one freed by a delete, else the next unused one.
+*/
+tid newTupleId(TidMap *tidMap, tid slot)
+{
+  tid tupleId;
+  if (tidMap->freeN > 0)
+    tupleId = tidMap->freeTids[--tidMap->freeN];
+  else
+  {
+    if (tidMap->size == tidMap->capacity)
+    {
+      int capacity = tidMap->capacity * 2;
+      tidMap->slot = realloc(tidMap->slot, capacity * sizeof(tid));
+      tidMap->freeTids = realloc(tidMap->freeTids, capacity * sizeof(tid));
+      int pagesN = getTidMapPagesN(tidMap->capacity, tidMap->slotsN);
+      int newPagesN = getTidMapPagesN(capacity, tidMap->slotsN);
+      tidMap->dirtyPages = realloc(tidMap->dirtyPages, newPagesN * sizeof(char));
+      memset(tidMap->dirtyPages + pagesN, 0, newPagesN - pagesN);
+      tidMap->capacity = capacity;
+    }
+    tupleId = tidMap->size++;
+  }
+
+  tidMap->slot[tupleId] = slot;
+  setSlotOwner(tidMap, slot, tupleId);
+  markTidMapDirty(tidMap, tupleId, tupleId);
+  return tupleId;
+}
+
+/*
+  The record at slot 'oldSlot' moved to 'newSlot' (split, merge or delete), only the TidMap changes, its tuple id stays the same.
+*/
+void moveTupleId(TidMap *tidMap, tid oldSlot, tid newSlot)
+{
+  tid tupleId = getSlotOwner(tidMap, oldSlot);
+  if (tupleId == -1 || oldSlot == newSlot)
+    return;
+
+  tidMap->owner[oldSlot] = -1;
+  setSlotOwner(tidMap, newSlot, tupleId);
+  tidMap->slot[tupleId] = newSlot;
+  markTidMapDirty(tidMap, tupleId, tupleId);
+}
+
+/*
+  The record with tuple id 'tupleId' was deleted, its tuple id can be given to a new record.
+*/
+void freeTupleId(TidMap *tidMap, tid tupleId)
+{
+  tid slot = tidMap->slot[tupleId];
+  if (getSlotOwner(tidMap, slot) == tupleId)
+    tidMap->owner[slot] = -1;
+
+  tidMap->slot[tupleId] = -1;
+  tidMap->freeTids[tidMap->freeN++] = tupleId;
+  markTidMapDirty(tidMap, tupleId, tupleId);
+}
+
+/*
+  Returns the slot (getTid(block, index, recordsN)) of the record with tuple id 'tupleId' at the index 'node', or -1 if there is no such record.
+*/
+tid getTidSlot(IndexNode *node, tid tupleId)
+{
+  if (tupleId < 0 || tupleId >= node->tidMap.size)
+    return -1;
+  return node->tidMap.slot[tupleId];
+}
+
 /*
   block: previously initialized BF_Block pointer (does not get destroyed)
-  allocates and stores to the second block of the file with fileDesc 'fd', a HashTable with 2^'depht' values.
+  allocates the second block of the file with fileDesc 'fd' and stores there (and in as many blocks as needed after it),
+  a HashTable with 2^'depht' values.
 */
 HT_ErrorCode createHashTable(int fd, BF_Block *block, int depth)
 {
-  HashEntry hashEntry;
+  HashTable hashTable;
   int hashN = pow(2.0, (double)depth);
   int blockN;
-  char *data;
 
-  // allocate space for the HashTable
+  // allocate space for the first block of the HashTable, the rest are allocated when stored
   CALL_BF(BF_AllocateBlock(fd, block));
   CALL_BF(BF_UnpinBlock(block));
 
-  // set empty entry header
-  Entry empty;
-  empty.header.local_depth = depth;
-  empty.header.size = 0;
+  hashTable.size = hashN;
+  hashTable.hashNode = malloc(hashN * sizeof(HashNode));
+  hashTable.pagesN = 1;
+  hashTable.pages = malloc(sizeof(int));
+  hashTable.pages[0] = 1;
+  hashTable.nodesN = MAX_HNODES(getPageSize(fd));
+  hashTable.dirtyPages = calloc(getHashTablePagesN(hashN, hashTable.nodesN), sizeof(char));
 
   // Link every hash value an empty data block
-  hashEntry.header.size = hashN;
   for (int i = 0; i < hashN; i++)
   {
-    hashEntry.hashNode[i].value = i;
-    BF_GetBlockCounter(fd, &blockN);
-    CALL_BF(BF_AllocateBlock(fd, block));
-    data = BF_Block_GetData(block);
-    memcpy(data, &empty, sizeof(Entry));
-    BF_Block_SetDirty(block);
-    CALL_BF(BF_UnpinBlock(block));
-    hashEntry.hashNode[i].block_num = blockN;
+    Entry *empty;
+    CALL_OR_DIE(pinNewEntry(fd, block, &blockN, &empty));
+    empty->header.local_depth = depth;
+    empty->header.size = 0;
+    empty->header.next_block = -1;
+    CALL_OR_DIE(unpinPage(block, 1));
+    hashTable.hashNode[i].block_num = blockN;
   }
 
   // Store HashTable
-  BF_GetBlock(fd, 1, block);
-  data = BF_Block_GetData(block);
-  memcpy(data, &hashEntry, sizeof(HashEntry));
-  BF_Block_SetDirty(block);
-  CALL_BF(BF_UnpinBlock(block));
+  markHashTableDirty(&hashTable, 0, hashN - 1);
+  HT_ErrorCode code = setHashTable(fd, block, &hashTable);
+  freeHashTable(&hashTable);
 
-  return HT_OK;
+  return code;
 }
 
 HT_ErrorCode HT_CreateIndex(const char *filename, int depth)
@@ -186,11 +520,10 @@ HT_ErrorCode HT_CreateIndex(const char *filename, int depth)
   BF_Block *block;
   BF_Block_Init(&block);
 
-  // open file
-  int id;
-  HT_OpenIndex(filename, &id);
-  int fd = indexArray[id].fd;
-  strcpy(indexArray[id].filename, filename);
+  // open file (HT_OpenIndex expects an already initialized file)
+  int fd;
+  CALL_BF(BF_OpenFile(filename, &fd));
+  CALL_OR_DIE(setPageSize(fd, htPageSize));
 
   // Create Info block and HashTable
   CALL_OR_DIE(createInfoBlock(fd, block, depth));
@@ -198,7 +531,7 @@ HT_ErrorCode HT_CreateIndex(const char *filename, int depth)
 
   // destroy block
   BF_Block_Destroy(&block);
-  HT_CloseFile(id);
+  CALL_BF(BF_CloseFile(fd));
 
   return HT_OK;
 }
@@ -227,10 +560,52 @@ HT_ErrorCode HT_OpenIndex(const char *fileName, int *indexDesc)
 
   int fd;
   CALL_BF(BF_OpenFile(fileName, &fd));
+  int blocks;
+  CALL_BF(BF_GetBlockCounter(fd, &blocks));
+  if (blocks == 0)
+  {
+    printf("File %s is not an index file!\n", fileName);
+    CALL_BF(BF_CloseFile(fd));
+    return HT_ERROR;
+  }
   int pos = (*indexDesc);   // Get position
   indexArray[pos].fd = fd;  // Store fileDesc
   indexArray[pos].used = 1; // Set position to used
+  strncpy(indexArray[pos].filename, fileName, MAX_NAME_LEN - 1);
+  indexArray[pos].filename[MAX_NAME_LEN - 1] = '\0';
+
+  // load global depth, HashTable and TidMap once, inserts work on this copy
+  BF_Block *block;
+  BF_Block_Init(&block);
+  CALL_OR_DIE(loadPageSize(fd, block));
+  CALL_OR_DIE(getDepth(fd, block, &indexArray[pos].depth));
+  CALL_OR_DIE(getHashTable(fd, block, &indexArray[pos].hashTable));
+  CALL_OR_DIE(getTidMap(fd, block, &indexArray[pos].tidMap));
+  indexArray[pos].dirty = 0;
+  BF_Block_Destroy(&block);
+
+  return HT_OK;
+}
+
+HT_ErrorCode HT_SyncIndex(int indexDesc)
+{
+  IndexNode *node = &indexArray[indexDesc];
+  if (node->used == 0)
+  {
+    printf("Trying to sync a closed file!\n");
+    return HT_ERROR;
+  }
+  if (node->dirty == 0)
+    return HT_OK;
+
+  BF_Block *block;
+  BF_Block_Init(&block);
+  CALL_OR_DIE(setDepth(node->fd, block, node->depth));
+  CALL_OR_DIE(setHashTable(node->fd, block, &node->hashTable));
+  CALL_OR_DIE(setTidMap(node->fd, block, &node->tidMap));
+  BF_Block_Destroy(&block);
 
+  node->dirty = 0;
   return HT_OK;
 }
 
@@ -242,6 +617,11 @@ HT_ErrorCode HT_CloseFile(int indexDesc)
     return HT_ERROR;
   }
 
+  // write back cached depth, HashTable and TidMap
+  CALL_OR_DIE(HT_SyncIndex(indexDesc));
+  freeHashTable(&indexArray[indexDesc].hashTable);
+  freeTidMap(&indexArray[indexDesc].tidMap);
+
   int fd = indexArray[indexDesc].fd;
   indexArray[indexDesc].used = 0; // Free up position
 
@@ -265,27 +645,53 @@ HT_ErrorCode getDepth(int fd, BF_Block *block, int *depth)
 
 /*
   block: previously initialized BF_Block pointer (does not get destroyed)
-  stores the HashTable from file with fileDesc 'fd', to 'hashEntry' variable.
+  loads the HashTable from file with fileDesc 'fd', to 'hashTable' variable, by following the
+  chain of directory blocks that starts at block 1. 'hashTable' must be freed with freeHashTable.
 */
-HT_ErrorCode getHashTable(int fd, BF_Block *block, HashEntry *hashEntry)
+HT_ErrorCode getHashTable(int fd, BF_Block *block, HashTable *hashTable)
 {
-  CALL_BF(BF_GetBlock(fd, 1, block));
-  char *data = BF_Block_GetData(block);
-  memcpy(hashEntry, data, sizeof(HashEntry));
-  CALL_BF(BF_UnpinBlock(block));
+  HashEntry *hashEntry;
+  hashTable->nodesN = MAX_HNODES(getPageSize(fd));
+  int capacity = hashTable->nodesN;
+  int pagesCapacity = 1;
+
+  hashTable->size = 0;
+  hashTable->pagesN = 0;
+  hashTable->hashNode = malloc(capacity * sizeof(HashNode));
+  hashTable->pages = malloc(pagesCapacity * sizeof(int));
+
+  int block_num = 1;
+  do
+  {
+    CALL_BF(BF_GetBlock(fd, block_num, block));
+    hashEntry = (HashEntry *)BF_Block_GetData(block);
+
+    // make room for this block's hash values
+    if (hashTable->pagesN == pagesCapacity)
+    {
+      pagesCapacity *= 2;
+      capacity = pagesCapacity * hashTable->nodesN;
+      hashTable->pages = realloc(hashTable->pages, pagesCapacity * sizeof(int));
+      hashTable->hashNode = realloc(hashTable->hashNode, capacity * sizeof(HashNode));
+    }
+
+    hashTable->pages[hashTable->pagesN++] = block_num;
+    memcpy(&hashTable->hashNode[hashTable->size], hashEntry->hashNode, hashEntry->header.size * sizeof(HashNode));
+    hashTable->size += hashEntry->header.size;
+    block_num = hashEntry->header.next_hblock;
+    CALL_BF(BF_UnpinBlock(block));
+  } while (block_num != -1);
 
+  hashTable->dirtyPages = calloc(hashTable->pagesN, sizeof(char));
   return HT_OK;
 }
 
 /*
-  Returns the block_num of the data block that hash 'value' from HashTable 'hashEntry' points to.
+  Returns the block_num of the data block that hash 'value' from HashTable 'hashTable' points to.
 */
-int getBucket(int value, HashEntry hashEntry)
+int getBucket(int value, HashTable *hashTable)
 {
-  int pos = -1;
-  for (pos = 0; pos < hashEntry.header.size; pos++)
-    if (hashEntry.hashNode[pos].value == value)
-      return hashEntry.hashNode[pos].block_num;
+  return hashTable->hashNode[value].block_num;
 }
 
 /*
@@ -308,340 +714,1947 @@ HT_ErrorCode checkInsertEntry(int indexDesc, UpdateRecordArray *updateArray)
 }
 
 /*
-  block: previously initialized BF_Block pointer (does not get destroyed)
-  Stores the Entry from block with block_num 'bucket' at file with fileDesc 'fd', at 'entry' variable.
+  block: previously initialized BF_Block pointer, that is not pinned (does not get destroyed)
+  Pins the block with block_num 'bucket' at file with fileDesc 'fd' and points 'entry' at its data, without copying it.
+  The calling function reads or changes the Entry in place, then calls unpinPage.
 */
-HT_ErrorCode getEntry(int fd, BF_Block *block, int bucket, Entry *entry)
+HT_ErrorCode pinEntry(int fd, BF_Block *block, int bucket, Entry **entry)
 {
-  BF_GetBlock(fd, bucket, block);
-  char *data = BF_Block_GetData(block);
-  memcpy(entry, data, sizeof(Entry));
-  CALL_BF(BF_UnpinBlock(block));
+  CALL_BF(BF_GetBlock(fd, bucket, block));
+  *entry = (Entry *)BF_Block_GetData(block);
 
   return HT_OK;
 }
 
 /*
-  block: previously initialized BF_Block pointer (does not get destroyed).
-  fd: fileDesc of file we want.
-  Updates the value of the global depth at the disk. (calling function must update memory, if need to)
+  block: previously initialized BF_Block pointer, that is not pinned (does not get destroyed)
+  Allocates a new block (as allocateBlock), stores its 'block_num' and keeps it pinned, with 'entry' pointing at its data.
+  The calling function fills the Entry, then calls unpinPage with dirty = 1.
 */
-HT_ErrorCode setDepth(int fd, BF_Block *block, int depth)
+HT_ErrorCode pinNewEntry(int fd, BF_Block *block, int *block_num, Entry **entry)
 {
-  CALL_BF(BF_GetBlock(fd, 0, block));
-  char *data = BF_Block_GetData(block);
-  memcpy(data, &depth, sizeof(int));
-  BF_Block_SetDirty(block);
-  CALL_BF(BF_UnpinBlock(block));
+  CALL_OR_DIE(allocateBlock(fd, block, block_num));
+  *entry = (Entry *)BF_Block_GetData(block);
 
   return HT_OK;
 }
 
 /*
-  block: previously initialized BF_Block pointer (does not get destroyed).
-  fd: fileDesc of file we want.
-  Saves the HashTable 'hashEntry' at the disk.
+  Unpins a block pinned by pinEntry (or any of its siblings). If 'dirty' is 1, the block was changed and is marked as dirty first.
 */
-HT_ErrorCode setHashTable(int fd, BF_Block *block, HashEntry *hashEntry)
+HT_ErrorCode unpinPage(BF_Block *block, int dirty)
 {
-  CALL_BF(BF_GetBlock(fd, 1, block));
-  char *data = BF_Block_GetData(block);
-  memcpy(data, hashEntry, sizeof(HashEntry));
-  BF_Block_SetDirty(block);
+  if (dirty)
+    BF_Block_SetDirty(block);
   CALL_BF(BF_UnpinBlock(block));
+
   return HT_OK;
 }
 
 /*
-  'hashEntry' : hash table.
-  'bucket' : block we are interested in.
-  'depth' : global depth of the hash table.
-  'local_depth' : local depth of bucket.
-   Stores at first and end the first and last index of the hash table, that points to the bucket. Stores at half the medium of [first, last].
+  blocks: 'n' previously initialized BF_Block pointers, that are not pinned (do not get destroyed)
+  Pins the blocks with block_nums 'buckets' together and points entries[i] at the data of blocks[i], as 'n' pinEntry calls.
+  With the BF level of src/bf.c (BF_SRC) this is one BF_GetBlocks, that reads the adjacent blocks that are not in memory
+  with one preadv, with lib/libbf.so the blocks are pinned one by one. The calling function then calls unpinPages.
 */
-HT_ErrorCode getEndPoints(int *first, int *half, int *end, int local_depth, int depth, int bucket, HashEntry hashEntry)
+HT_ErrorCode pinEntries(int fd, BF_Block **blocks, int *buckets, int n, Entry **entries)
 {
-  // int local_depth = entry.header.local_depth;
-  int dif = depth - local_depth;
-  int numOfHashes = pow(2.0, (double)dif);
-  for (int pos = 0; pos < hashEntry.header.size; pos++)
-    if (hashEntry.hashNode[pos].block_num == bucket)
+#ifdef BF_SRC
+  CALL_BF(BF_GetBlocks(fd, buckets, n, blocks));
+#else
+  // as BF_GetBlocks, nothing stays pinned after an error
+  for (int i = 0; i < n; i++)
+  {
+    BF_ErrorCode code = BF_GetBlock(fd, buckets[i], blocks[i]);
+    if (code != BF_OK)
     {
-      *first = pos;
-      break;
+      BF_PrintError(code);
+      for (int j = 0; j < i; j++)
+        BF_UnpinBlock(blocks[j]);
+      return HT_ERROR;
     }
+  }
+#endif
+  for (int i = 0; i < n; i++)
+    entries[i] = (Entry *)BF_Block_GetData(blocks[i]);
 
-  *half = (*first) + numOfHashes / 2 - 1;
-  *end = (*first) + numOfHashes - 1;
   return HT_OK;
 }
 
 /*
-  block: previously initialized BF_Block pointer (does not get destroyed).
-  fd: fileDesc of file we want.
-  Allocates a new block at the end of the file, and stores it's 'block_num'.
+  Unpins the 'n' blocks pinned by pinEntries. blocks[i] is marked as dirty first if dirty[i] is not 0 ('dirty' may be NULL).
 */
-HT_ErrorCode getNewBlock(int fd, BF_Block *block, int *block_num)
+HT_ErrorCode unpinPages(BF_Block **blocks, int n, int *dirty)
 {
-  BF_GetBlockCounter(fd, block_num);
-  CALL_BF(BF_AllocateBlock(fd, block));
-  CALL_BF(BF_UnpinBlock(block));
+  for (int i = 0; i < n; i++)
+    if (dirty != NULL && dirty[i])
+      BF_Block_SetDirty(blocks[i]);
+#ifdef BF_SRC
+  CALL_BF(BF_UnpinBlocks(blocks, n));
+#else
+  for (int i = 0; i < n; i++)
+    CALL_BF(BF_UnpinBlock(blocks[i]));
+#endif
 
   return HT_OK;
 }
 
 /*
-  Reassigns records from one block to two. Used when need to split. !It doesn't split, it reassigns!
-  The two new blocks consist of the old block and a new one that has been allocated.
   block: previously initialized BF_Block pointer (does not get destroyed).
   fd: fileDesc of file we want.
-  entry: the Entry that was in the block we are reassigning from.
-  old: address of the entry that will remain in the old block.
-  new: address of the entry that will be in the new block.
-  blockOld: block_num of old block.
-  blockNew: block_num of new block.
-  depth: global depth.
-  half: medium of [first, end]. first is the first index of the hash table that points to the old block and end is the last.
-  updateArray: the array we stores record updates.
+  Updates the value of the global depth at the disk. (calling function must update memory, if need to)
 */
-
-int getBlockNumFromTID(tid td)
+HT_ErrorCode setDepth(int fd, BF_Block *block, int depth)
 {
+  CALL_BF(BF_GetBlock(fd, 0, block));
+  char *data = BF_Block_GetData(block);
+  memcpy(data, &depth, sizeof(int));
+  BF_Block_SetDirty(block);
+  CALL_BF(BF_UnpinBlock(block));
 
-  return (td / MAX_RECORDS) - 1;
+  return HT_OK;
 }
 
-int getIndexFromTID(tid td)
+/*
+  block: previously initialized BF_Block pointer (does not get destroyed).
+  fd: fileDesc of file we want.
+  Saves the changed blocks of the HashTable 'hashTable' at the disk. If the table has grown,
+  new directory blocks are allocated and linked at the end of the chain.
+*/
+HT_ErrorCode setHashTable(int fd, BF_Block *block, HashTable *hashTable)
 {
+  int pagesN = getHashTablePagesN(hashTable->size, hashTable->nodesN);
 
-  return td % MAX_RECORDS;
-}
-
-HT_ErrorCode reassignRecords(int fd, BF_Block *block, Entry entry, int blockOld, int blockNew, int half, int depth, UpdateRecordArray *updateArray, Entry *old, Entry *new)
-{
-  for (int i = 0; i < entry.header.size; i++)
+  // allocate missing directory blocks first, so every block knows its next one
+  if (pagesN > hashTable->pagesN)
   {
-    if (hashFunction(entry.record[i].id, depth) <= half)
+    int last = hashTable->pagesN - 1;
+    hashTable->pages = realloc(hashTable->pages, pagesN * sizeof(int));
+    while (hashTable->pagesN < pagesN)
     {
-      // reassign to new position in old block
-      old->record[old->header.size] = entry.record[i];
-
-      // update array
-      if (i < MAX_RECORDS)
-      {
-        strcpy(updateArray[i].city, entry.record[i].city);
-        strcpy(updateArray[i].surname, entry.record[i].surname);
-        updateArray[i].oldTupleId = getTid(blockOld, i);
-        updateArray[i].newTupleId = getTid(blockOld, old->header.size);
-      }
-      old->header.size++;
+      CALL_OR_DIE(getNewBlock(fd, block, &hashTable->pages[hashTable->pagesN]));
+      hashTable->dirtyPages[hashTable->pagesN] = 1;
+      hashTable->pagesN++;
     }
-    else
-    {
-      // assign to new block
-      new->record[new->header.size] = entry.record[i];
+    // the previous last block must now point to the first new one
+    hashTable->dirtyPages[last] = 1;
+  }
 
-      // update array
-      if (i < MAX_RECORDS)
+  for (int p = 0; p < pagesN; p++)
+  {
+    if (hashTable->dirtyPages[p] == 0)
+      continue;
+
+    int first = p * hashTable->nodesN;
+    int count = hashTable->size - first;
+    if (count > hashTable->nodesN)
+      count = hashTable->nodesN;
+
+    CALL_BF(BF_GetBlock(fd, hashTable->pages[p], block));
+    HashEntry *hashEntry = (HashEntry *)BF_Block_GetData(block);
+    hashEntry->header.size = count;
+    hashEntry->header.next_hblock = (p + 1 < pagesN) ? hashTable->pages[p + 1] : -1;
+    memcpy(hashEntry->hashNode, &hashTable->hashNode[first], count * sizeof(HashNode));
+    CALL_OR_DIE(unpinPage(block, 1));
+
+    hashTable->dirtyPages[p] = 0;
+  }
+
+  return HT_OK;
+}
+
+/*
+  block: previously initialized BF_Block pointer (does not get destroyed)
+  loads the TidMap from file with fileDesc 'fd', to 'tidMap' variable, by following the chain of blocks that starts at
+  the info block's tid_map. The slots of the records and the free tuple ids are rebuilt from it. 'tidMap' must be freed with freeTidMap.
+*/
+HT_ErrorCode getTidMap(int fd, BF_Block *block, TidMap *tidMap)
+{
+  initTidMap(tidMap, 0, getPageSize(fd));
+  int pagesCapacity = 1;
+  tidMap->pages = malloc(pagesCapacity * sizeof(int));
+
+  CALL_BF(BF_GetBlock(fd, 0, block));
+  int block_num = ((InfoHeader *)BF_Block_GetData(block))->tid_map;
+  CALL_BF(BF_UnpinBlock(block));
+
+  while (block_num != -1)
+  {
+    CALL_BF(BF_GetBlock(fd, block_num, block));
+    TidMapEntry *mapEntry = (TidMapEntry *)BF_Block_GetData(block);
+
+    // make room for this block's tuple ids
+    if (tidMap->pagesN == pagesCapacity)
+    {
+      pagesCapacity *= 2;
+      tidMap->pages = realloc(tidMap->pages, pagesCapacity * sizeof(int));
+    }
+    if (tidMap->size + mapEntry->header.size > tidMap->capacity)
+    {
+      tidMap->capacity = pagesCapacity * tidMap->slotsN;
+      tidMap->slot = realloc(tidMap->slot, tidMap->capacity * sizeof(tid));
+      tidMap->freeTids = realloc(tidMap->freeTids, tidMap->capacity * sizeof(tid));
+    }
+
+    tidMap->pages[tidMap->pagesN++] = block_num;
+    memcpy(&tidMap->slot[tidMap->size], mapEntry->slot, mapEntry->header.size * sizeof(tid));
+    tidMap->size += mapEntry->header.size;
+    block_num = mapEntry->header.next_block;
+    CALL_BF(BF_UnpinBlock(block));
+  }
+
+  free(tidMap->dirtyPages);
+  tidMap->dirtyPages = calloc(getTidMapPagesN(tidMap->capacity, tidMap->slotsN), sizeof(char));
+
+  // the tuple id of every slot, deleted tuple ids are given again from the smallest
+  for (tid t = tidMap->size - 1; t >= 0; t--)
+  {
+    if (tidMap->slot[t] == -1)
+      tidMap->freeTids[tidMap->freeN++] = t;
+    else
+      setSlotOwner(tidMap, tidMap->slot[t], t);
+  }
+
+  return HT_OK;
+}
+
+/*
+  block: previously initialized BF_Block pointer (does not get destroyed).
+  fd: fileDesc of file we want.
+  Saves the changed blocks of the TidMap 'tidMap' at the disk. If the map has grown, new blocks are allocated
+  and linked at the end of the chain (or at the info block, for the first one).
+*/
+HT_ErrorCode setTidMap(int fd, BF_Block *block, TidMap *tidMap)
+{
+  int pagesN = getTidMapPagesN(tidMap->size, tidMap->slotsN);
+
+  // allocate missing blocks first, so every block knows its next one
+  if (pagesN > tidMap->pagesN)
+  {
+    int last = tidMap->pagesN - 1;
+    tidMap->pages = realloc(tidMap->pages, pagesN * sizeof(int));
+    while (tidMap->pagesN < pagesN)
+    {
+      CALL_OR_DIE(getNewBlock(fd, block, &tidMap->pages[tidMap->pagesN]));
+      tidMap->dirtyPages[tidMap->pagesN] = 1;
+      tidMap->pagesN++;
+    }
+
+    // the previous last block (or the info block) must now point to the first new one
+    if (last >= 0)
+      tidMap->dirtyPages[last] = 1;
+    else
+    {
+      CALL_BF(BF_GetBlock(fd, 0, block));
+      ((InfoHeader *)BF_Block_GetData(block))->tid_map = tidMap->pages[0];
+      CALL_OR_DIE(unpinPage(block, 1));
+    }
+  }
+
+  for (int p = 0; p < pagesN; p++)
+  {
+    if (tidMap->dirtyPages[p] == 0)
+      continue;
+
+    int first = p * tidMap->slotsN;
+    int count = tidMap->size - first;
+    if (count > tidMap->slotsN)
+      count = tidMap->slotsN;
+
+    CALL_BF(BF_GetBlock(fd, tidMap->pages[p], block));
+    TidMapEntry *mapEntry = (TidMapEntry *)BF_Block_GetData(block);
+    mapEntry->header.size = count;
+    mapEntry->header.next_block = (p + 1 < pagesN) ? tidMap->pages[p + 1] : -1;
+    memcpy(mapEntry->slot, &tidMap->slot[first], count * sizeof(tid));
+    CALL_OR_DIE(unpinPage(block, 1));
+
+    tidMap->dirtyPages[p] = 0;
+  }
+
+  return HT_OK;
+}
+
+/*
+  'value' : any hash value that points to the bucket we are interested in.
+  'depth' : global depth of the hash table.
+  'local_depth' : local depth of bucket.
+   Stores at first and end the first and last index of the hash table, that points to the bucket. Stores at half the medium of [first, last].
+   The 2^(depth - local_depth) hash values of a bucket share their first local_depth bits, so first is 'value' with the rest cleared.
+*/
+HT_ErrorCode getEndPoints(int *first, int *half, int *end, int local_depth, int depth, int value)
+{
+  int dif = depth - local_depth;
+  int numOfHashes = 1 << dif;
+  *first = (value >> dif) << dif;
+
+  *half = (*first) + numOfHashes / 2 - 1;
+  *end = (*first) + numOfHashes - 1;
+  return HT_OK;
+}
+
+/*
+  block: previously initialized BF_Block pointer, that is not pinned (does not get destroyed).
+  fd: fileDesc of file we want.
+  Takes the first block of the file's free list if there is one, else allocates a new block at the end of the file.
+  Stores it's 'block_num' and keeps it pinned, the calling function unpins it.
+*/
+HT_ErrorCode allocateBlock(int fd, BF_Block *block, int *block_num)
+{
+  BF_Block *infoBlock;
+  BF_Block_Init(&infoBlock);
+  CALL_BF(BF_GetBlock(fd, 0, infoBlock));
+  InfoHeader *info = (InfoHeader *)BF_Block_GetData(infoBlock);
+
+  if (info->free_block == -1)
+  {
+    CALL_BF(BF_UnpinBlock(infoBlock));
+    CALL_BF(BF_GetBlockCounter(fd, block_num));
+    CALL_BF(BF_AllocateBlock(fd, block));
+  }
+  else
+  {
+    // a free block keeps the next free one at its start
+    *block_num = info->free_block;
+    CALL_BF(BF_GetBlock(fd, *block_num, block));
+    memcpy(&info->free_block, BF_Block_GetData(block), sizeof(int));
+    CALL_OR_DIE(unpinPage(infoBlock, 1));
+  }
+
+  BF_Block_Destroy(&infoBlock);
+  return HT_OK;
+}
+
+/*
+  block: previously initialized BF_Block pointer (does not get destroyed).
+  fd: fileDesc of file we want.
+  Allocates a new block (reusing a freed one if there is one), and stores it's 'block_num'.
+*/
+HT_ErrorCode getNewBlock(int fd, BF_Block *block, int *block_num)
+{
+  CALL_OR_DIE(allocateBlock(fd, block, block_num));
+  CALL_BF(BF_UnpinBlock(block));
+
+  return HT_OK;
+}
+
+/*
+  block: previously initialized BF_Block pointer, that is not pinned (does not get destroyed).
+  fd: fileDesc of file we want.
+  Adds the block 'block_num' (that nothing points to anymore) at the start of the file's free list, so that allocateBlock reuses it.
+*/
+HT_ErrorCode freeBlock(int fd, BF_Block *block, int block_num)
+{
+  BF_Block *infoBlock;
+  BF_Block_Init(&infoBlock);
+  CALL_BF(BF_GetBlock(fd, 0, infoBlock));
+  InfoHeader *info = (InfoHeader *)BF_Block_GetData(infoBlock);
+
+  CALL_BF(BF_GetBlock(fd, block_num, block));
+  memcpy(BF_Block_GetData(block), &info->free_block, sizeof(int));
+  CALL_OR_DIE(unpinPage(block, 1));
+
+  info->free_block = block_num;
+  CALL_OR_DIE(unpinPage(infoBlock, 1));
+  BF_Block_Destroy(&infoBlock);
+
+  return HT_OK;
+}
+
+/*
+  Reassigns records from one block to two. Used when need to split. !It doesn't split, it reassigns!
+  The two new blocks consist of the old block and a new one that has been allocated.
+  old: the pinned Entry of the block we are reassigning from, the records that remain are compacted in place.
+  new: the pinned (empty) Entry of the new block.
+  blockOld: block_num of old block.
+  blockNew: block_num of new block.
+  depth: global depth.
+  half: medium of [first, end]. first is the first index of the hash table that points to the old block and end is the last.
+  tidMap: the TidMap of the index, the slots of the records that move are updated (their tuple ids stay the same).
+*/
+
+int getBlockNumFromTID(tid td, int recordsN)
+{
+
+  return (td / recordsN) - 1;
+}
+
+int getIndexFromTID(tid td, int recordsN)
+{
+
+  return td % recordsN;
+}
+
+HT_ErrorCode reassignRecords(int blockOld, int blockNew, int half, int depth, TidMap *tidMap, Entry *old, Entry *new)
+{
+  // a record never moves to a later position of the old block, so it can be compacted in place
+  int size = old->header.size;
+  old->header.size = 0;
+  for (int i = 0; i < size; i++)
+  {
+    Record *record = &old->record[i];
+    if (hashFunction(record->id, depth) <= half)
+    {
+      // update tuple id's slot
+      moveTupleId(tidMap, getTid(blockOld, i, tidMap->recordsN), getTid(blockOld, old->header.size, tidMap->recordsN));
+
+      // reassign to new position in old block
+      if (old->header.size != i)
+        old->record[old->header.size] = *record;
+      old->header.size++;
+    }
+    else
+    {
+      // update tuple id's slot
+      moveTupleId(tidMap, getTid(blockOld, i, tidMap->recordsN), getTid(blockNew, new->header.size, tidMap->recordsN));
+
+      // assign to new block
+      new->record[new->header.size] = *record;
+      new->header.size++;
+    }
+  }
+
+  return HT_OK;
+}
+
+/*
+  Inserts a record after the block it should go, was splitted.
+  The two new blocks (after spliting) consist of the old block and a new one that has been allocated.
+  record: the record we're inserting.
+  depth: the global depth.
+  half: medium of [first, end]. first is the first index of the hash table that points to the old block and end is the last.
+  slot: the slot (getTid(block, index, recordsN)) of the record after insertion.
+  recordsN: the records that fit in a bucket.
+  old: address of the entry that will remain in the old block.
+  new: address of the entry that will be in the new block.
+  blockOld: block_num of old block.
+  blockNew: block_num of new block.
+  Returns 2 without inserting, if every record went to the half the new record belongs to.
+*/
+HT_ErrorCode insertRecordAfterSplit(Record record, int depth, int half, tid *slot, int recordsN, int blockOld, int blockNew, Entry *old, Entry *new)
+{
+  int toOld = hashFunction(record.id, depth) <= half;
+  if ((toOld && old->header.size >= recordsN) || (!toOld && new->header.size >= recordsN))
+    return 2;
+
+  // store given record
+  if (toOld)
+  {
+    old->record[old->header.size] = record;
+    *slot = getTid(blockOld, old->header.size, recordsN);
+    old->header.size++;
+  }
+  else
+  {
+    new->record[new->header.size] = record;
+    *slot = getTid(blockNew, new->header.size, recordsN);
+    new->header.size++;
+  }
+
+  return HT_OK;
+}
+
+/*
+  Doubles the HashTable 'hashTable' in memory. The caller marks the index dirty,
+  the table reaches the disk at the next HT_SyncIndex.
+  If there is no memory the table keeps its old size and contents, and so does the depth of the caller.
+*/
+HT_ErrorCode doubleHashTable(HashTable *hashTable)
+{
+  if (hashTable->size >= 1 << HT_MAX_DEPTH)
+  {
+    printf("The HashTable can't grow deeper than %d!\n", HT_MAX_DEPTH);
+    return HT_ERROR;
+  }
+  int size = hashTable->size * 2;
+
+  // a successful realloc may move the old buffer, keep each one as soon as it is got
+  HashNode *hashNode = realloc(hashTable->hashNode, size * sizeof(HashNode));
+  if (hashNode == NULL)
+  {
+    printf("Not enough memory to double the HashTable!\n");
+    return HT_ERROR;
+  }
+  hashTable->hashNode = hashNode;
+  char *dirtyPages = realloc(hashTable->dirtyPages, getHashTablePagesN(size, hashTable->nodesN) * sizeof(char));
+  if (dirtyPages == NULL)
+  {
+    printf("Not enough memory to double the HashTable!\n");
+    return HT_ERROR;
+  }
+  hashTable->dirtyPages = dirtyPages;
+
+  // double table, from the end so that i >> 1 is still unchanged
+  for (int i = size - 1; i >= 0; i--)
+  {
+    hashNode[i].block_num = hashNode[i >> 1].block_num;
+  }
+
+  // update changes in memory
+  hashTable->size = size;
+  markHashTableDirty(hashTable, 0, size - 1);
+  return HT_OK;
+}
+
+/*
+  Returns 1 if the HashTable 'hashTable' can be halved, that is if no bucket has local depth equal to the global depth.
+  A bucket of lower local depth has an even number of hash values, so every hash value 2i points to the same block as 2i+1.
+*/
+int canHalveHashTable(HashTable *hashTable)
+{
+  if (hashTable->size < 2)
+    return 0;
+
+  for (int i = 0; i < hashTable->size; i += 2)
+    if (hashTable->hashNode[i].block_num != hashTable->hashNode[i + 1].block_num)
+      return 0;
+  return 1;
+}
+
+/*
+  Halves the HashTable 'hashTable' in memory, the directory blocks it does not need anymore are freed.
+  block: previously initialized BF_Block pointer, that is not pinned (does not get destroyed).
+  The caller marks the index dirty, the table reaches the disk at the next HT_SyncIndex.
+*/
+HT_ErrorCode halveHashTable(int fd, BF_Block *block, HashTable *hashTable)
+{
+  int size = hashTable->size / 2;
+  for (int i = 0; i < size; i++)
+  {
+    hashTable->hashNode[i].block_num = hashTable->hashNode[2 * i].block_num;
+  }
+  hashTable->size = size;
+
+  // the last block left must end the chain, it is rewritten with the rest
+  int pagesN = getHashTablePagesN(size, hashTable->nodesN);
+  while (hashTable->pagesN > pagesN)
+  {
+    hashTable->pagesN--;
+    CALL_OR_DIE(freeBlock(fd, block, hashTable->pages[hashTable->pagesN]));
+  }
+  markHashTableDirty(hashTable, 0, size - 1);
+  return HT_OK;
+}
+
+/*
+  Splits a HashTable's block, reassigns records, and stores updated data.
+  fd: fileDesc of file we are interested in.
+  depth: global depth.
+  bucket: the block_num of the block we are spliting.
+  record: the record that when added caused the spliting. Inserted at the end.
+  slot: the slot (getTid(block, index, recordsN)) of the record after it is inserted.
+  tidMap: the TidMap of the index, the slots of the records that move are updated.
+  entry: the pinned Entry of the block we are spliting, changed in place (the calling function unpins it).
+  hashEntry: the in-memory HashTable of the index, updated in place.
+  Returns 2 if the record was not inserted, because the split did not free space for it.
+  A bucket with overflow blocks has records of a single hash: its chain is not split, the new block takes the half it is not in.
+*/
+HT_ErrorCode splitHashTable(int fd, int depth, int bucket, Record record, tid *slot, TidMap *tidMap, Entry *entry, HashTable *hashEntry)
+{
+  // get end points
+  int local_depth = entry->header.local_depth;
+  int first, half, end;
+  CALL_OR_DIE(getEndPoints(&first, &half, &end, local_depth, depth, hashFunction(record.id, depth)));
+
+  // get a new block, pinned while it is filled
+  BF_Block *blockNewPage;
+  BF_Block_Init(&blockNewPage);
+  int blockNew;
+  Entry *new;
+  CALL_OR_DIE(pinNewEntry(fd, blockNewPage, &blockNew, &new));
+  new->header.local_depth = local_depth + 1;
+  new->header.size = 0;
+  new->header.next_block = -1;
+
+  entry->header.local_depth++;
+
+  int res;
+  if (entry->header.next_block != -1)
+  {
+    // the chain stays where its records hash, the record goes to the new block if it hashes to the other half
+    int chainLow = hashFunction(entry->record[0].id, depth) <= half;
+    int from = chainLow ? half + 1 : first;
+    int to = chainLow ? end : half;
+    for (int i = from; i <= to; i++)
+      hashEntry->hashNode[i].block_num = blockNew;
+    markHashTableDirty(hashEntry, from, to);
+
+    res = 2;
+    if ((hashFunction(record.id, depth) <= half) != chainLow)
+    {
+      new->record[0] = record;
+      new->header.size = 1;
+      *slot = getTid(blockNew, 0, tidMap->recordsN);
+      res = HT_OK;
+    }
+  }
+  else
+  {
+    for (int i = half + 1; i <= end; i++)
+      hashEntry->hashNode[i].block_num = blockNew;
+    markHashTableDirty(hashEntry, half + 1, end);
+
+    // re-assing records
+    CALL_OR_DIE(reassignRecords(bucket, blockNew, half, depth, tidMap, entry, new));
+
+    // insert new record (after splitting)
+    res = insertRecordAfterSplit(record, depth, half, slot, tidMap->recordsN, bucket, blockNew, entry, new);
+  }
+
+  // the old entry was changed in place, store the new one
+  CALL_OR_DIE(unpinPage(blockNewPage, 1));
+  BF_Block_Destroy(&blockNewPage);
+
+  return res;
+}
+
+/*
+  Returns 1 if every record of the pinned 'entry' has the full (32 bit) hash 'hash', so that no split can separate them.
+*/
+int isSameHashBucket(Entry *entry, unsigned int hash)
+{
+  for (int i = 0; i < entry->header.size; i++)
+    if (hashFunction(entry->record[i].id, 32) != hash)
+      return 0;
+  return 1;
+}
+
+/*
+  Adds 'record' to the overflow chain of a bucket, whose first block 'blockN' is pinned in 'block' with its data at 'entry'.
+  Every block of a chain but the last one is full, so the record goes to the last block, or to a new one linked after it.
+  The blocks are unpinned before returning.
+  slot: the slot (getTid(block, index, recordsN)) of the record after it is inserted.
+*/
+HT_ErrorCode appendOverflowRecord(IndexNode *node, BF_Block *block, int blockN, Entry *entry, Record record, tid *slot)
+{
+  while (entry->header.next_block != -1)
+  {
+    blockN = entry->header.next_block;
+    CALL_OR_DIE(unpinPage(block, 0));
+    CALL_OR_DIE(pinEntry(node->fd, block, blockN, &entry));
+  }
+
+  if (entry->header.size < node->tidMap.recordsN)
+  {
+    entry->record[entry->header.size] = record;
+    *slot = getTid(blockN, entry->header.size, node->tidMap.recordsN);
+    entry->header.size++;
+    CALL_OR_DIE(unpinPage(block, 1));
+    return HT_OK;
+  }
+
+  // the last block is full, link a new one after it
+  BF_Block *newBlock;
+  BF_Block_Init(&newBlock);
+  int newN;
+  Entry *new;
+  CALL_OR_DIE(pinNewEntry(node->fd, newBlock, &newN, &new));
+  new->header.local_depth = entry->header.local_depth;
+  new->header.next_block = -1;
+  new->record[0] = record;
+  new->header.size = 1;
+  *slot = getTid(newN, 0, node->tidMap.recordsN);
+  entry->header.next_block = newN;
+  CALL_OR_DIE(unpinPage(newBlock, 1));
+  CALL_OR_DIE(unpinPage(block, 1));
+  BF_Block_Destroy(&newBlock);
+
+  return HT_OK;
+}
+
+/*
+  Inserts 'record' at the index 'node', splitting its bucket (and doubling the HashTable) until the record fits.
+  A full bucket that can't be split, because its records and the new one share their full hash or its local depth is HT_MAX_DEPTH,
+  gets the record in its overflow chain instead.
+  block: previously initialized BF_Block pointer (does not get destroyed).
+  tupleId: the tupleId of the record after insertion, given by the TidMap of the index.
+  Records that move because of a split keep their tuple ids, only their slots in the TidMap change.
+*/
+HT_ErrorCode insertRecord(IndexNode *node, BF_Block *block, Record record, tid *tupleId)
+{
+  int depth = node->depth;
+  int fd = node->fd;
+  unsigned int hash = hashFunction(record.id, 32);
+
+  // get bucket
+  int value = hashFunction(record.id, depth);
+  int blockN = getBucket(value, &node->hashTable);
+
+  // get bucket's entry, pinned until the record is inserted
+  Entry *entry;
+  CALL_OR_DIE(pinEntry(fd, block, blockN, &entry));
+
+  // check for available space, split until the record fits
+  while (entry->header.size >= node->tidMap.recordsN)
+  {
+    if (entry->header.local_depth >= HT_MAX_DEPTH || isSameHashBucket(entry, hash))
+    {
+      tid slot;
+      CALL_OR_DIE(appendOverflowRecord(node, block, blockN, entry, record, &slot));
+      *tupleId = newTupleId(&node->tidMap, slot);
+      node->dirty = 1;
+      return HT_OK;
+    }
+
+    // check local depth
+    if (entry->header.local_depth == depth)
+    {
+      // double HashTable, the depth grows only if it was doubled
+      if (doubleHashTable(&node->hashTable) != HT_OK)
+      {
+        CALL_OR_DIE(unpinPage(block, 0));
+        return HT_ERROR;
+      }
+      depth++;
+      node->depth = depth;
+    }
+    // spit hashTable's pointers
+    node->dirty = 1;
+    tid slot;
+    int res = splitHashTable(fd, depth, blockN, record, &slot, &node->tidMap, entry, &node->hashTable);
+    CALL_OR_DIE(unpinPage(block, 1));
+    if (res == HT_OK)
+    {
+      *tupleId = newTupleId(&node->tidMap, slot);
+      return HT_OK;
+    }
+    if (res != 2)
+      return HT_ERROR;
+
+    // every record stayed on the record's side, split that bucket again
+    value = hashFunction(record.id, depth);
+    blockN = getBucket(value, &node->hashTable);
+    CALL_OR_DIE(pinEntry(fd, block, blockN, &entry));
+  }
+
+  // insert new record (whithout splitting)
+  entry->record[entry->header.size] = record;
+  *tupleId = newTupleId(&node->tidMap, getTid(blockN, entry->header.size, node->tidMap.recordsN));
+  (entry->header.size)++;
+  node->dirty = 1;
+
+  CALL_OR_DIE(unpinPage(block, 1));
+  return HT_OK;
+}
+
+/*
+  Sets the first 'n' updates of 'updateArray' to "no update". The readers of an updateArray stop at the first of them,
+  so only the entries up to it are set: tuple ids never move, an insert fills none and a delete only the first.
+*/
+void clearUpdates(UpdateRecordArray *updateArray, int n)
+{
+  for (int i = 0; i < n; i++)
+  {
+    updateArray[i].oldTupleId = -1;
+    updateArray[i].newTupleId = updateArray[i].oldTupleId;
+    strcpy(updateArray[i].city, "DUMBVILLE");
+    strcpy(updateArray[i].surname, "DUMMY");
+  }
+}
+
+HT_ErrorCode HT_InsertEntry(int indexDesc, Record record, tid *tupleId, UpdateRecordArray *updateArray)
+{
+  CALL_OR_DIE(checkInsertEntry(indexDesc, updateArray));
+  clearUpdates(updateArray, 1);
+
+  // Initialize block
+  BF_Block *block;
+  BF_Block_Init(&block);
+
+  // depth and HashTable are cached in the index node
+  CALL_OR_DIE(insertRecord(&indexArray[indexDesc], block, record, tupleId));
+
+  BF_Block_Destroy(&block);
+  return HT_OK;
+}
+
+/*
+  checks the input of HT_DeleteEntry
+*/
+HT_ErrorCode checkDeleteEntry(int indexDesc, UpdateRecordArray *updateArray)
+{
+  if (indexArray[indexDesc].used == 0)
+  {
+    printf("Trying to delete from a closed file!\n");
+    return HT_ERROR;
+  }
+  if (updateArray == NULL)
+  {
+    printf("updateArray is NULL\n");
+    return HT_ERROR;
+  }
+
+  return HT_OK;
+}
+
+/*
+  Merges the bucket 'bucket' with its buddy (the bucket its hash values were split from), while the two fit in one block.
+  The bucket with the fewer records moves to the other one, and its block is freed. Buckets with overflow blocks are not merged.
+  node: the index, its HashTable is updated in memory.
+  block: previously initialized BF_Block pointer, that is not pinned (does not get destroyed).
+  id: an id that hashes to the bucket.
+  The records that move keep their tuple ids, only their slots in the TidMap of the index change.
+*/
+HT_ErrorCode mergeBuckets(IndexNode *node, BF_Block *block, int bucket, int id)
+{
+  BF_Block *buddyBlock;
+  BF_Block_Init(&buddyBlock);
+
+  while (1)
+  {
+    Entry *entry;
+    CALL_OR_DIE(pinEntry(node->fd, block, bucket, &entry));
+    int local_depth = entry->header.local_depth;
+    if (local_depth == 0)
+    {
+      CALL_OR_DIE(unpinPage(block, 0));
+      break;
+    }
+
+    // the buddy's hash values differ only at the last bit of the local depth
+    int depth = node->depth;
+    int first, half, end;
+    CALL_OR_DIE(getEndPoints(&first, &half, &end, local_depth, depth, hashFunction(id, depth)));
+    int numOfHashes = end - first + 1;
+    int buddyFirst = first ^ numOfHashes;
+    int buddy = getBucket(buddyFirst, &node->hashTable);
+
+    Entry *other;
+    CALL_OR_DIE(pinEntry(node->fd, buddyBlock, buddy, &other));
+
+    if (other->header.local_depth != local_depth || entry->header.next_block != -1 || other->header.next_block != -1 ||
+        entry->header.size + other->header.size > node->tidMap.recordsN)
+    {
+      CALL_OR_DIE(unpinPage(buddyBlock, 0));
+      CALL_OR_DIE(unpinPage(block, 0));
+      break;
+    }
+
+    // keep the bucket with the most records
+    Entry *keep = entry, *gone = other;
+    int keepN = bucket, goneN = buddy;
+    if (entry->header.size < other->header.size)
+    {
+      keep = other;
+      gone = entry;
+      keepN = buddy;
+      goneN = bucket;
+    }
+
+    for (int i = 0; i < gone->header.size; i++)
+    {
+      keep->record[keep->header.size] = gone->record[i];
+      moveTupleId(&node->tidMap, getTid(goneN, i, node->tidMap.recordsN), getTid(keepN, keep->header.size, node->tidMap.recordsN));
+      keep->header.size++;
+    }
+    keep->header.local_depth--;
+
+    CALL_OR_DIE(unpinPage(keepN == bucket ? block : buddyBlock, 1));
+    CALL_OR_DIE(unpinPage(keepN == bucket ? buddyBlock : block, 0));
+    CALL_OR_DIE(freeBlock(node->fd, block, goneN));
+
+    // every hash value of the two buckets points to the one kept
+    int from = first < buddyFirst ? first : buddyFirst;
+    for (int i = from; i < from + 2 * numOfHashes; i++)
+      node->hashTable.hashNode[i].block_num = keepN;
+    markHashTableDirty(&node->hashTable, from, from + 2 * numOfHashes - 1);
+    node->dirty = 1;
+
+    bucket = keepN;
+  }
+
+  BF_Block_Destroy(&buddyBlock);
+  return HT_OK;
+}
+
+/*
+  Moves the last record of the overflow chain that starts after the pinned 'entry' (block 'blockN') to position 'pos' of 'entry',
+  keeping its tuple id. The last block of the chain is unlinked and freed if it empties. 'entry' stays pinned.
+*/
+HT_ErrorCode fillFromChain(IndexNode *node, int blockN, Entry *entry, int pos)
+{
+  BF_Block *lastBlock;
+  BF_Block_Init(&lastBlock);
+
+  // find the last block of the chain, and the one before it
+  int prevN = blockN;
+  int lastN = entry->header.next_block;
+  Entry *last;
+  CALL_OR_DIE(pinEntry(node->fd, lastBlock, lastN, &last));
+  while (last->header.next_block != -1)
+  {
+    prevN = lastN;
+    lastN = last->header.next_block;
+    CALL_OR_DIE(unpinPage(lastBlock, 0));
+    CALL_OR_DIE(pinEntry(node->fd, lastBlock, lastN, &last));
+  }
+
+  int index = last->header.size - 1;
+  entry->record[pos] = last->record[index];
+  moveTupleId(&node->tidMap, getTid(lastN, index, node->tidMap.recordsN), getTid(blockN, pos, node->tidMap.recordsN));
+  last->header.size--;
+  if (last->header.size > 0)
+  {
+    CALL_OR_DIE(unpinPage(lastBlock, 1));
+    BF_Block_Destroy(&lastBlock);
+    return HT_OK;
+  }
+
+  // the emptied block leaves the chain
+  CALL_OR_DIE(unpinPage(lastBlock, 0));
+  if (prevN == blockN)
+    entry->header.next_block = -1;
+  else
+  {
+    Entry *prev;
+    CALL_OR_DIE(pinEntry(node->fd, lastBlock, prevN, &prev));
+    prev->header.next_block = -1;
+    CALL_OR_DIE(unpinPage(lastBlock, 1));
+  }
+  CALL_OR_DIE(freeBlock(node->fd, lastBlock, lastN));
+  BF_Block_Destroy(&lastBlock);
+  return HT_OK;
+}
+
+/*
+  Deletes the record with 'id' from the index 'node': the last record of its bucket (the last one of its overflow chain
+  if it has one) takes its place, keeping its tuple id, then the bucket is merged and the HashTable halved while possible.
+  block: previously initialized BF_Block pointer, that is not pinned (does not get destroyed).
+  deleted: a copy of the deleted record.
+  tupleId: the tuple id of the deleted record, freed for a later insertion.
+*/
+HT_ErrorCode deleteRecord(IndexNode *node, BF_Block *block, int id, Record *deleted, tid *tupleId)
+{
+  int fd = node->fd;
+
+  // get bucket
+  int bucket = getBucket(hashFunction(id, node->depth), &node->hashTable);
+  int blockN = bucket;
+  Entry *entry;
+  CALL_OR_DIE(pinEntry(fd, block, blockN, &entry));
+
+  // find the record, in the bucket or its overflow chain
+  int pos;
+  int prevN = -1;
+  while (1)
+  {
+    for (pos = 0; pos < entry->header.size; pos++)
+      if (entry->record[pos].id == id)
+        break;
+    if (pos < entry->header.size)
+      break;
+
+    int next = entry->header.next_block;
+    CALL_OR_DIE(unpinPage(block, 0));
+    if (next == -1)
+    {
+      printf("There is no record with id %i!\n", id);
+      return HT_ERROR;
+    }
+    prevN = blockN;
+    blockN = next;
+    CALL_OR_DIE(pinEntry(fd, block, blockN, &entry));
+  }
+
+  *deleted = entry->record[pos];
+  *tupleId = getSlotOwner(&node->tidMap, getTid(blockN, pos, node->tidMap.recordsN));
+  freeTupleId(&node->tidMap, *tupleId);
+  node->dirty = 1;
+
+  // the last record of the bucket takes its place, keeping its tuple id
+  if (entry->header.next_block != -1)
+  {
+    CALL_OR_DIE(fillFromChain(node, blockN, entry, pos));
+  }
+  else
+  {
+    int last = entry->header.size - 1;
+    if (pos != last)
+    {
+      entry->record[pos] = entry->record[last];
+      moveTupleId(&node->tidMap, getTid(blockN, last, node->tidMap.recordsN), getTid(blockN, pos, node->tidMap.recordsN));
+    }
+    entry->header.size--;
+  }
+  int emptied = prevN != -1 && entry->header.size == 0;
+  CALL_OR_DIE(unpinPage(block, 1));
+
+  // an overflow block that emptied leaves the chain
+  if (emptied)
+  {
+    Entry *prev;
+    CALL_OR_DIE(pinEntry(fd, block, prevN, &prev));
+    prev->header.next_block = -1;
+    CALL_OR_DIE(unpinPage(block, 1));
+    CALL_OR_DIE(freeBlock(fd, block, blockN));
+  }
+
+  // merge buckets, then halve the HashTable while no bucket uses the last bit of the global depth
+  CALL_OR_DIE(mergeBuckets(node, block, bucket, id));
+  while (canHalveHashTable(&node->hashTable))
+  {
+    CALL_OR_DIE(halveHashTable(fd, block, &node->hashTable));
+    node->depth--;
+    node->dirty = 1;
+  }
+
+  return HT_OK;
+}
+
+HT_ErrorCode HT_DeleteEntry(int indexDesc, int id, UpdateRecordArray *updateArray)
+{
+  CALL_OR_DIE(checkDeleteEntry(indexDesc, updateArray));
+  clearUpdates(updateArray, 2);
+
+  // Initialize block
+  BF_Block *block;
+  BF_Block_Init(&block);
+
+  Record deleted;
+  tid tupleId;
+  HT_ErrorCode code = deleteRecord(&indexArray[indexDesc], block, id, &deleted, &tupleId);
+  BF_Block_Destroy(&block);
+  if (code != HT_OK)
+    return code;
+
+  // the deleted record is the only update, it has no new tupleId
+  strcpy(updateArray[0].city, deleted.city);
+  strcpy(updateArray[0].surname, deleted.surname);
+  updateArray[0].oldTupleId = tupleId;
+  updateArray[0].newTupleId = -1;
+
+  return HT_OK;
+}
+
+HT_ErrorCode HT_InsertEntryDelta(int indexDesc, Record record, tid *tupleId, int *deltasN)
+{
+  *deltasN = 0;
+  if (indexArray[indexDesc].used == 0)
+  {
+    printf("Trying to insert into a closed file!\n");
+    return HT_ERROR;
+  }
+
+  // Initialize block
+  BF_Block *block;
+  BF_Block_Init(&block);
+
+  // tuple ids of moved records do not change, so there is nothing to report
+  CALL_OR_DIE(insertRecord(&indexArray[indexDesc], block, record, tupleId));
+
+  BF_Block_Destroy(&block);
+  return HT_OK;
+}
+
+HT_ErrorCode HT_DeleteEntryDelta(int indexDesc, int id, TupleDelta *deltas, int *deltasN)
+{
+  *deltasN = 0;
+  if (indexArray[indexDesc].used == 0)
+  {
+    printf("Trying to delete from a closed file!\n");
+    return HT_ERROR;
+  }
+
+  // Initialize block
+  BF_Block *block;
+  BF_Block_Init(&block);
+
+  Record deleted;
+  tid tupleId;
+  HT_ErrorCode code = deleteRecord(&indexArray[indexDesc], block, id, &deleted, &tupleId);
+  BF_Block_Destroy(&block);
+  if (code != HT_OK)
+    return code;
+
+  deltas[0].cityHash = hashString(deleted.city);
+  deltas[0].surnameHash = hashString(deleted.surname);
+  deltas[0].oldTupleId = tupleId;
+  deltas[0].newTupleId = -1;
+  *deltasN = 1;
+
+  return HT_OK;
+}
+
+// a record of a batch, with the full hash of its id
+typedef struct
+{
+  unsigned int hash;
+  int index;
+} BatchRecord;
+
+int compareBatchRecords(const void *a, const void *b)
+{
+  unsigned int ha = ((const BatchRecord *)a)->hash;
+  unsigned int hb = ((const BatchRecord *)b)->hash;
+  if (ha != hb)
+    return ha < hb ? -1 : 1;
+  return ((const BatchRecord *)a)->index - ((const BatchRecord *)b)->index;
+}
+
+HT_ErrorCode HT_InsertBatch(int indexDesc, Record *records, int n, tid *tupleIds, UpdateRecordArray **updates, int *updatesN)
+{
+  *updates = NULL;
+  *updatesN = 0;
+
+  if (indexArray[indexDesc].used == 0)
+  {
+    printf("Trying to insert into a closed file!\n");
+    return HT_ERROR;
+  }
+  if (n < 0 || (n > 0 && (records == NULL || tupleIds == NULL)))
+  {
+    printf("Wrong batch input!\n");
+    return HT_ERROR;
+  }
+
+  // Initialize block
+  BF_Block *block;
+  BF_Block_Init(&block);
+
+  IndexNode *node = &indexArray[indexDesc];
+  int fd = node->fd;
+
+  // order the batch by the full hash of the ids, so that the records of a bucket are next to each other at any depth
+  BatchRecord *batch = malloc((n + 1) * sizeof(BatchRecord));
+  for (int i = 0; i < n; i++)
+  {
+    batch[i].hash = hashFunction(records[i].id, 32);
+    batch[i].index = i;
+  }
+  qsort(batch, n, sizeof(BatchRecord), compareBatchRecords);
+
+  BF_Block *window[PIN_WINDOW];
+  for (int k = 0; k < PIN_WINDOW; k++)
+    BF_Block_Init(&window[k]);
+  int recordsN = node->tidMap.recordsN;
+  int i = 0;
+  while (i < n)
+  {
+    // the buckets of the next records, up to PIN_WINDOW of them, are pinned together (more records than they can take do not matter)
+    int buckets[PIN_WINDOW];
+    int count = 0;
+    for (int j = i; j < n && j < i + PIN_WINDOW * recordsN; j++)
+    {
+      int blockN = getBucket(hashFunction(records[batch[j].index].id, node->depth), &node->hashTable);
+      if (count > 0 && buckets[count - 1] == blockN)
+        continue;
+      if (count == PIN_WINDOW)
+        break;
+      buckets[count++] = blockN;
+    }
+    Entry *entries[PIN_WINDOW];
+    CALL_OR_DIE(pinEntries(fd, window, buckets, count, entries));
+
+    // fill them in place with the records of the batch that go to them, in order, until one is full
+    int added[PIN_WINDOW] = {0};
+    int full = 0;
+    for (int k = 0; k < count && !full; k++)
+      while (i < n && getBucket(hashFunction(records[batch[i].index].id, node->depth), &node->hashTable) == buckets[k])
+      {
+        Entry *entry = entries[k];
+        if (entry->header.size == recordsN)
+        {
+          full = 1;
+          break;
+        }
+        int index = batch[i].index;
+        entry->record[entry->header.size] = records[index];
+        tupleIds[index] = newTupleId(&node->tidMap, getTid(buckets[k], entry->header.size, recordsN));
+        entry->header.size++;
+        added[k]++;
+        i++;
+      }
+    CALL_OR_DIE(unpinPages(window, count, added));
+    for (int k = 0; k < count; k++)
+      if (added[k] > 0)
+        node->dirty = 1;
+
+    // the bucket is full and the next record goes to it, split it or add to its overflow chain (the tuple ids of the batch do not change)
+    if (full)
+    {
+      int index = batch[i].index;
+      CALL_OR_DIE(insertRecord(node, block, records[index], &tupleIds[index]));
+      i++;
+    }
+  }
+
+  free(batch);
+  for (int k = 0; k < PIN_WINDOW; k++)
+    BF_Block_Destroy(&window[k]);
+  BF_Block_Destroy(&block);
+  return HT_OK;
+}
+
+// a bucket of a bulk load: the sorted batch records [from, to), that share the first 'local_depth' bits of their hash
+typedef struct
+{
+  int from;
+  int to;
+  unsigned int prefix;
+  int local_depth;
+} BulkBucket;
+
+/*
+  Plans the buckets of a bulk load for the records batch[from..to) (sorted by hash), that all start with the 'local_depth' bits of 'prefix'.
+  The records become one bucket if they fit in a block ('recordsN' records) and 'local_depth' is at least the requested 'depth',
+  else they are split in two by the next bit of their hash. If they don't fit but splitting can not separate them
+  (same hash, or HT_MAX_DEPTH reached), the bucket gets overflow blocks as in insertRecord.
+  buckets: grows (realloc) when 'capacity' is reached, 'bucketsN' is its number of buckets.
+*/
+HT_ErrorCode planBulkBuckets(BatchRecord *batch, int from, int to, unsigned int prefix, int local_depth, int depth, int recordsN, BulkBucket **buckets, int *bucketsN, int *capacity)
+{
+  int sameHash = to - from > 0 && batch[from].hash == batch[to - 1].hash;
+  if (local_depth >= depth && (to - from <= recordsN || local_depth == HT_MAX_DEPTH || sameHash))
+  {
+    if (*bucketsN == *capacity)
+    {
+      *capacity *= 2;
+      *buckets = realloc(*buckets, *capacity * sizeof(BulkBucket));
+    }
+    BulkBucket *bucket = &(*buckets)[(*bucketsN)++];
+    bucket->from = from;
+    bucket->to = to;
+    bucket->prefix = prefix;
+    bucket->local_depth = local_depth;
+    return HT_OK;
+  }
+
+  // the records with the next bit 0 come first
+  unsigned int bit = 1u << (31 - local_depth);
+  int mid = from;
+  while (mid < to && (batch[mid].hash & bit) == 0)
+    mid++;
+
+  CALL_OR_DIE(planBulkBuckets(batch, from, mid, prefix << 1, local_depth + 1, depth, recordsN, buckets, bucketsN, capacity));
+  CALL_OR_DIE(planBulkBuckets(batch, mid, to, (prefix << 1) | 1, local_depth + 1, depth, recordsN, buckets, bucketsN, capacity));
+  return HT_OK;
+}
+
+HT_ErrorCode HT_BulkCreateIndex(const char *filename, int depth, Record *records, int n, tid *tupleIds)
+{
+  CALL_OR_DIE(checkCreateIndex(filename, depth));
+  if (n < 0 || (n > 0 && records == NULL))
+  {
+    printf("Wrong bulk input!\n");
+    return HT_ERROR;
+  }
+
+  // order the records by the full hash of their ids and pick the buckets, and the global depth, before writing anything
+  BatchRecord *batch = malloc((n + 1) * sizeof(BatchRecord));
+  for (int i = 0; i < n; i++)
+  {
+    batch[i].hash = hashFunction(records[i].id, 32);
+    batch[i].index = i;
+  }
+  qsort(batch, n, sizeof(BatchRecord), compareBatchRecords);
+
+  int capacity = 16, bucketsN = 0;
+  BulkBucket *buckets = malloc(capacity * sizeof(BulkBucket));
+  if (planBulkBuckets(batch, 0, n, 0, 0, depth, MAX_RECORDS(htPageSize), &buckets, &bucketsN, &capacity) != HT_OK)
+  {
+    free(batch);
+    free(buckets);
+    return HT_ERROR;
+  }
+
+  // planBulkBuckets never goes deeper than HT_MAX_DEPTH, so 1 << finalDepth fits the directory in an int
+  int finalDepth = depth;
+  for (int b = 0; b < bucketsN; b++)
+    if (buckets[b].local_depth > finalDepth)
+      finalDepth = buckets[b].local_depth;
+
+  CALL_BF(BF_CreateFile(filename));
+
+  BF_Block *block;
+  BF_Block_Init(&block);
+
+  int fd;
+  CALL_BF(BF_OpenFile(filename, &fd));
+  CALL_OR_DIE(setPageSize(fd, htPageSize));
+
+  // info block and the first block of the HashTable, the rest of the HashTable goes after the buckets
+  CALL_OR_DIE(createInfoBlock(fd, block, finalDepth));
+  CALL_BF(BF_AllocateBlock(fd, block));
+  CALL_BF(BF_UnpinBlock(block));
+
+  HashTable hashTable;
+  hashTable.size = 1 << finalDepth;
+  hashTable.hashNode = malloc(hashTable.size * sizeof(HashNode));
+  hashTable.pagesN = 1;
+  hashTable.pages = malloc(sizeof(int));
+  hashTable.pages[0] = 1;
+  hashTable.nodesN = MAX_HNODES(htPageSize);
+  hashTable.dirtyPages = calloc(getHashTablePagesN(hashTable.size, hashTable.nodesN), sizeof(char));
+
+  // records[i] gets tuple id i
+  TidMap tidMap;
+  initTidMap(&tidMap, n, htPageSize);
+  tidMap.size = n;
+
+  // write every bucket once, one after the other, a full block links the next one as overflow
+  BF_Block *nextBlock;
+  BF_Block_Init(&nextBlock);
+  for (int b = 0; b < bucketsN; b++)
+  {
+    int first, blockN;
+    Entry *entry;
+    CALL_OR_DIE(pinNewEntry(fd, block, &first, &entry));
+    blockN = first;
+    entry->header.local_depth = buckets[b].local_depth;
+    entry->header.size = 0;
+    entry->header.next_block = -1;
+    for (int i = buckets[b].from; i < buckets[b].to; i++)
+    {
+      if (entry->header.size == tidMap.recordsN)
+      {
+        Entry *next;
+        CALL_OR_DIE(pinNewEntry(fd, nextBlock, &entry->header.next_block, &next));
+        next->header.local_depth = buckets[b].local_depth;
+        next->header.size = 0;
+        next->header.next_block = -1;
+        blockN = entry->header.next_block;
+        CALL_OR_DIE(unpinPage(block, 1));
+        BF_Block *swap = block;
+        block = nextBlock;
+        nextBlock = swap;
+        entry = next;
+      }
+      entry->record[entry->header.size] = records[batch[i].index];
+      tidMap.slot[batch[i].index] = getTid(blockN, entry->header.size, tidMap.recordsN);
+      if (tupleIds != NULL)
+        tupleIds[batch[i].index] = batch[i].index;
+      entry->header.size++;
+    }
+    CALL_OR_DIE(unpinPage(block, 1));
+
+    // the bucket's hash values, as in getEndPoints
+    int dif = finalDepth - buckets[b].local_depth;
+    int value = buckets[b].prefix << dif;
+    for (int i = value; i < value + (1 << dif); i++)
+      hashTable.hashNode[i].block_num = first;
+  }
+  BF_Block_Destroy(&nextBlock);
+
+  // Store HashTable
+  markHashTableDirty(&hashTable, 0, hashTable.size - 1);
+  HT_ErrorCode code = setHashTable(fd, block, &hashTable);
+  freeHashTable(&hashTable);
+
+  // Store TidMap
+  if (code == HT_OK && n > 0)
+  {
+    markTidMapDirty(&tidMap, 0, n - 1);
+    code = setTidMap(fd, block, &tidMap);
+  }
+  freeTidMap(&tidMap);
+
+  free(batch);
+  free(buckets);
+  BF_Block_Destroy(&block);
+  CALL_BF(BF_CloseFile(fd));
+
+  return code;
+}
+
+HT_ErrorCode HT_Lookup(int indexDesc, int id, Record *out)
+{
+  if (indexArray[indexDesc].used == 0)
+  {
+    printf("Can't look up a closed file!\n");
+    return HT_ERROR;
+  }
+
+  BF_Block *block;
+  BF_Block_Init(&block);
+
+  // get bucket
+  IndexNode *node = &indexArray[indexDesc];
+  int blockN = getBucket(hashFunction(id, node->depth), &node->hashTable);
+  Entry *entry;
+  CALL_OR_DIE(pinEntry(node->fd, block, blockN, &entry));
+
+  // copy only the record asked for, looking in the overflow chain of the bucket too
+  HT_ErrorCode code = HT_ERROR;
+  while (1)
+  {
+    for (int i = 0; i < entry->header.size; i++)
+    {
+      if (entry->record[i].id == id)
       {
-        strcpy(updateArray[i].city, entry.record[i].city);
-        strcpy(updateArray[i].surname, entry.record[i].surname);
-        updateArray[i].oldTupleId = getTid(blockOld, i);
-        updateArray[i].newTupleId = getTid(blockNew, new->header.size);
+        *out = entry->record[i];
+        code = HT_OK;
+        break;
       }
-      new->header.size++;
     }
+
+    int next = entry->header.next_block;
+    CALL_OR_DIE(unpinPage(block, 0));
+    if (code == HT_OK || next == -1)
+      break;
+    CALL_OR_DIE(pinEntry(node->fd, block, next, &entry));
+  }
+
+  BF_Block_Destroy(&block);
+  return code;
+}
+
+// a tuple id of HT_FetchRecords, with where its record is and where it is asked for
+typedef struct
+{
+  tid slot;
+  int order;
+} TidFetch;
+
+int compareTidFetches(const void *a, const void *b)
+{
+  const TidFetch *x = a;
+  const TidFetch *y = b;
+  if (x->slot != y->slot)
+    return x->slot < y->slot ? -1 : 1;
+  return x->order - y->order;
+}
+
+HT_ErrorCode HT_FetchRecords(int indexDesc, const tid *tupleIds, int n, Record *records)
+{
+  if (indexArray[indexDesc].used == 0)
+  {
+    printf("Can't fetch from a closed file!\n");
+    return HT_ERROR;
+  }
+  if (n <= 0)
+    return HT_OK;
+
+  // sorted by slot, the records of a block are next to each other and the blocks are in file order
+  IndexNode *node = &indexArray[indexDesc];
+  TidFetch *fetches = malloc(n * sizeof(TidFetch));
+  for (int i = 0; i < n; i++)
+  {
+    fetches[i].slot = getTidSlot(node, tupleIds[i]);
+    fetches[i].order = i;
+    if (fetches[i].slot == -1)
+    {
+      printf("Tuple id %d doesn't exist!\n", tupleIds[i]);
+      free(fetches);
+      return HT_ERROR;
+    }
+  }
+  qsort(fetches, n, sizeof(TidFetch), compareTidFetches);
+
+  // the blocks are known before the first one is pinned
+  int *blocks = malloc(n * sizeof(int));
+  int blocksN = 0;
+  for (int i = 0; i < n; i++)
+  {
+    int block_num = getBlockNumFromTID(fetches[i].slot, node->tidMap.recordsN);
+    if (blocksN == 0 || blocks[blocksN - 1] != block_num)
+      blocks[blocksN++] = block_num;
+  }
+  prefetchBlocks(node->fd, blocks, blocksN);
+
+  // every block is pinned once, PIN_WINDOW of them together
+  BF_Block *window[PIN_WINDOW];
+  for (int k = 0; k < PIN_WINDOW; k++)
+    BF_Block_Init(&window[k]);
+  // an error is returned, not fatal, since the threads of SHT_ParallelInnerJoin fetch records too
+  HT_ErrorCode code = HT_OK;
+  int i = 0;
+  for (int first = 0; first < blocksN && code == HT_OK; first += PIN_WINDOW)
+  {
+    int count = blocksN - first < PIN_WINDOW ? blocksN - first : PIN_WINDOW;
+    Entry *entries[PIN_WINDOW];
+    code = pinEntries(node->fd, window, blocks + first, count, entries);
+    if (code != HT_OK)
+      break;
+    for (int k = 0; k < count; k++)
+      for (; i < n && getBlockNumFromTID(fetches[i].slot, node->tidMap.recordsN) == blocks[first + k]; i++)
+        records[fetches[i].order] = entries[k]->record[getIndexFromTID(fetches[i].slot, node->tidMap.recordsN)];
+    code = unpinPages(window, count, NULL);
+  }
+
+  for (int k = 0; k < PIN_WINDOW; k++)
+    BF_Block_Destroy(&window[k]);
+  free(blocks);
+  free(fetches);
+  return code;
+}
+
+HT_ErrorCode HT_ScanOpen(int indexDesc, HT_Scan *scan)
+{
+  if (indexArray[indexDesc].used == 0)
+  {
+    printf("Can't scan a closed file!\n");
+    return HT_ERROR;
+  }
+
+  scan->indexDesc = indexDesc;
+  scan->value = 0;
+  scan->block_num = -1;
+  scan->index = 0;
+  scan->entry = NULL;
+  BF_Block_Init(&scan->block);
+  prefetchBuckets(indexArray[indexDesc].fd, &indexArray[indexDesc].hashTable);
+
+  return HT_OK;
+}
+
+HT_ErrorCode HT_ScanNext(HT_Scan *scan, Record *record, tid *tupleId)
+{
+  IndexNode *node = &indexArray[scan->indexDesc];
+
+  while (1)
+  {
+    // pin the next bucket
+    if (scan->entry == NULL)
+    {
+      if (scan->value >= node->hashTable.size)
+      {
+        *tupleId = -1;
+        return HT_OK;
+      }
+      scan->block_num = getBucket(scan->value, &node->hashTable);
+      CALL_OR_DIE(pinEntry(node->fd, scan->block, scan->block_num, &scan->entry));
+      scan->local_depth = scan->entry->header.local_depth;
+      scan->index = 0;
+    }
+
+    if (scan->index < scan->entry->header.size)
+    {
+      *record = scan->entry->record[scan->index];
+      *tupleId = getSlotOwner(&node->tidMap, getTid(scan->block_num, scan->index, node->tidMap.recordsN));
+      scan->index++;
+      return HT_OK;
+    }
+
+    // the next overflow block of the bucket
+    int next = scan->entry->header.next_block;
+    CALL_OR_DIE(unpinPage(scan->block, 0));
+    if (next != -1)
+    {
+      scan->block_num = next;
+      CALL_OR_DIE(pinEntry(node->fd, scan->block, scan->block_num, &scan->entry));
+      scan->index = 0;
+      continue;
+    }
+
+    // skip hash values that point to the same block
+    scan->value += 1 << (node->depth - scan->local_depth);
+    scan->entry = NULL;
+  }
+}
+
+HT_ErrorCode HT_ScanClose(HT_Scan *scan)
+{
+  if (scan->entry != NULL)
+  {
+    scan->entry = NULL;
+    CALL_OR_DIE(unpinPage(scan->block, 0));
   }
+  BF_Block_Destroy(&scan->block);
 
   return HT_OK;
 }
 
 /*
-  Inserts a record after the block it should go, was splitted.
-  The two new blocks (after spliting) consist of the old block and a new one that has been allocated.
-  record: the record we're inserting.
-  depth: the global depth.
-  half: medium of [first, end]. first is the first index of the hash table that points to the old block and end is the last.
-  tupleId: the tupleId of the record after insertion.
-  old: address of the entry that will remain in the old block.
-  new: address of the entry that will be in the new block.
-  blockOld: block_num of old block.
-  blockNew: block_num of new block.
+  Returns the most blocks a grace join may use: half of the BF memory, as configured by BF_Init or BF_InitPool.
 */
-HT_ErrorCode insertRecordAfterSplit(Record record, int depth, int half, tid *tupleId, int blockOld, int blockNew, Entry *old, Entry *new)
+int getJoinMemoryMax(void)
 {
-  // store given record
-  if (hashFunction(record.id, depth) <= half)
+#ifdef BF_SRC
+  int frames;
+  if (BF_GetPoolSize(&frames) == BF_OK)
+    return frames / 2;
+#endif
+  return BF_BUFFER_SIZE / 2;
+}
+
+/*
+  checks the input of HT_GraceJoin
+*/
+HT_ErrorCode checkGraceJoin(int indexDesc1, int indexDesc2, const char *field, int memoryBlocks)
+{
+  if (indexDesc1 < 0 || indexDesc1 >= MAX_OPEN_FILES || indexArray[indexDesc1].used == 0 ||
+      indexDesc2 < 0 || indexDesc2 >= MAX_OPEN_FILES || indexArray[indexDesc2].used == 0)
   {
-    old->record[old->header.size] = record;
-    *tupleId = getTid(blockOld, old->header.size);
-    old->header.size++;
+    printf("Can't join a closed file!\n");
+    return HT_ERROR;
   }
-  else
+  if (field == NULL || (strcmp(field, "id") != 0 && strcmp(field, "name") != 0 &&
+                        strcmp(field, "surname") != 0 && strcmp(field, "city") != 0))
   {
-    new->record[new->header.size] = record;
-    *tupleId = getTid(blockNew, new->header.size);
-    new->header.size++;
+    printf("Can't join on that field! Please give id, name, surname or city.\n");
+    return HT_ERROR;
+  }
+  if (memoryBlocks < 3 || memoryBlocks > getJoinMemoryMax())
+  {
+    printf("Memory budget is wrong! Please give from 3 to %d blocks.\n", getJoinMemoryMax());
+    return HT_ERROR;
   }
-
   return HT_OK;
 }
 
 /*
-  Stores given Entry at a block.
-  fd: fileDesc of file we are interested in.
-  block: previously initialized BF_Block pointer (does not get destroyed).
-  dest_block_num: block_num of the block we are storing Entry at.
-  entry: the Entry.
+  key: at least sizeof(JoinTuple.key) chars
+  Copies the 'field' of 'record' into 'key' as a string (ids are written in decimal).
 */
-HT_ErrorCode setEntry(int fd, BF_Block *block, int dest_block_num, Entry *entry)
+HT_ErrorCode getRecordKey(Record *record, const char *field, char *key)
 {
-  CALL_BF(BF_GetBlock(fd, dest_block_num, block));
-  char *data = BF_Block_GetData(block);
-  memcpy(data, entry, sizeof(Entry));
-  BF_Block_SetDirty(block);
-  CALL_BF(BF_UnpinBlock(block));
+  int size = sizeof(((JoinTuple *)0)->key);
+
+  if (strcmp(field, "id") == 0)
+    snprintf(key, size, "%d", record->id);
+  else if (strcmp(field, "name") == 0)
+    snprintf(key, size, "%s", record->name);
+  else if (strcmp(field, "surname") == 0)
+    snprintf(key, size, "%s", record->surname);
+  else if (strcmp(field, "city") == 0)
+    snprintf(key, size, "%s", record->city);
+  else
+    return HT_ERROR;
 
   return HT_OK;
 }
 
 /*
-  block: previously initialized BF_Block pointer (does not get destroyed).
-  fd: fileDesc of file we want.
-  Doubles the HashTable 'hashEntry', updates memory and disk data at the end.
+  Returns how many partitions a grace join needs, so that each partition of the side with 'tuples' tuples fits in
+  'memoryBlocks' - 1 blocks (one block is left for the probe side). While partitioning, one output block stays pinned
+  per partition and one more for the scan, so there are never more than 'memoryBlocks' - 1 partitions; a partition
+  that is still too large is split again by joinPartitionPair.
+*/
+int getJoinPartitionsN(int tuples, int memoryBlocks)
+{
+  int pages = (tuples + MAX_JOIN_TUPLES - 1) / MAX_JOIN_TUPLES;
+  int n = (pages + memoryBlocks - 2) / (memoryBlocks - 1);
+
+  if (n < 1)
+    n = 1;
+  if (n > memoryBlocks - 1)
+    n = memoryBlocks - 1;
+  return n;
+}
+
+/*
+  Creates and opens a new temporary file for the 'n' partitions of one 'side' of a join, that split tuples with
+  joinHash at 'level'. Every partition starts empty.
 */
-HT_ErrorCode doubleHashTable(int fd, BF_Block *block, HashEntry *hashEntry)
+HT_ErrorCode openJoinPartitions(JoinPartitions *parts, int n, int side, int level)
 {
-  // double table
-  HashEntry new = (*hashEntry);
-  new.header.size = (*hashEntry).header.size * 2;
-  for (unsigned int i = 0; i < new.header.size; i++)
+  static int joinsN = 0;
+
+  if (side == 1)
+    joinsN++;
+  snprintf(parts->filename, MAX_NAME_LEN, "join%d_%d.tmp", joinsN, side);
+  remove(parts->filename);
+  CALL_BF(BF_CreateFile(parts->filename));
+  CALL_BF(BF_OpenFile(parts->filename, &parts->fd));
+
+  parts->n = n;
+  parts->level = level;
+  parts->first = malloc(n * sizeof(int));
+  parts->count = malloc(n * sizeof(int));
+  parts->block = malloc(n * sizeof(BF_Block *));
+  parts->page = malloc(n * sizeof(JoinPage *));
+  for (int i = 0; i < n; i++)
   {
-    new.hashNode[i].block_num = (*hashEntry).hashNode[i >> 1].block_num;
-    new.hashNode[i].value = i;
+    parts->first[i] = -1;
+    parts->count[i] = 0;
+    BF_Block_Init(&parts->block[i]);
+    parts->page[i] = NULL;
   }
 
-  // update changes in disk and memory
-  CALL_OR_DIE(setHashTable(fd, block, &new));
-  (*hashEntry) = new;
   return HT_OK;
 }
 
 /*
-  Splits a HashTable's block, reassigns records, and stores updated data.
-  fd: fileDesc of file we are interested in.
-  block: previously initialized BF_Block pointer (does not get destroyed).
-  depth: global depth.
-  bucket: the block_num of the block we are spliting.
-  record: the record that when added caused the spliting. Inserted at the end.
-  tupleId: the tupleId of the record after it is inserted.
-  updateArray: the array we are storing records' updates.
-  entry: the Entry of the block before it splitted.
+  Appends ('key', 'tupleId') to its partition, joinHash('key', level) % n. When the last block of the partition is full,
+  a new one is allocated and linked after it, and the full one is unpinned.
 */
-HT_ErrorCode splitHashTable(int fd, BF_Block *block, int depth, int bucket, Record record, tid *tupleId, UpdateRecordArray *updateArray, Entry entry)
+HT_ErrorCode addJoinTuple(JoinPartitions *parts, const char *key, tid tupleId)
 {
-  // get HashTable
-  HashEntry hashEntry;
-  CALL_OR_DIE(getHashTable(fd, block, &hashEntry));
-
-  // get end points
-  int local_depth = entry.header.local_depth;
-  int first, half, end;
-  CALL_OR_DIE(getEndPoints(&first, &half, &end, local_depth, depth, bucket, hashEntry));
+  int p = joinHash(key, parts->level) % parts->n;
+  JoinPage *page = parts->page[p];
 
-  // get a new block
-  int blockNew;
-  CALL_OR_DIE(getNewBlock(fd, block, &blockNew));
-
-  Entry old, new;
-  new.header.local_depth = local_depth + 1;
-  new.header.size = 0;
+  if (page == NULL || page->header.size == (int)MAX_JOIN_TUPLES)
+  {
+    int block_num;
+    BF_Block *block;
+    BF_Block_Init(&block);
+    CALL_BF(BF_GetBlockCounter(parts->fd, &block_num));
+    CALL_BF(BF_AllocateBlock(parts->fd, block));
+    JoinPage *newPage = (JoinPage *)BF_Block_GetData(block);
+    newPage->header.size = 0;
+    newPage->header.next_block = -1;
+
+    if (page == NULL)
+      parts->first[p] = block_num;
+    else
+    {
+      page->header.next_block = block_num;
+      CALL_OR_DIE(unpinPage(parts->block[p], 1));
+    }
+    BF_Block_Destroy(&parts->block[p]);
+    parts->block[p] = block;
+    parts->page[p] = page = newPage;
+  }
 
-  old = entry;
-  old.header.local_depth++;
-  old.header.size = 0;
+  JoinTuple *tuple = &page->tuple[page->header.size++];
+  strncpy(tuple->key, key, sizeof(tuple->key) - 1);
+  tuple->key[sizeof(tuple->key) - 1] = '\0';
+  tuple->tupleId = tupleId;
+  parts->count[p]++;
 
-  for (int i = half + 1; i <= end; i++)
-    hashEntry.hashNode[i].block_num = blockNew;
+  return HT_OK;
+}
 
-  // update HashTable and re-assing records
-  CALL_OR_DIE(setHashTable(fd, block, &hashEntry));
-  CALL_OR_DIE(reassignRecords(fd, block, entry, bucket, blockNew, half, depth, updateArray, &old, &new));
+/*
+  Unpins the last block of every partition, once all tuples of the side have been added.
+*/
+HT_ErrorCode flushJoinPartitions(JoinPartitions *parts)
+{
+  for (int i = 0; i < parts->n; i++)
+  {
+    if (parts->page[i] != NULL)
+    {
+      parts->page[i] = NULL;
+      CALL_OR_DIE(unpinPage(parts->block[i], 1));
+    }
+  }
 
-  // insert new record (after splitting)
-  CALL_OR_DIE(insertRecordAfterSplit(record, depth, half, tupleId, bucket, blockNew, &old, &new));
+  return HT_OK;
+}
 
-  // store created/modified entries
-  CALL_OR_DIE(setEntry(fd, block, bucket, &old));
-  CALL_OR_DIE(setEntry(fd, block, blockNew, &new));
+/*
+  Closes and deletes the temporary file of the partitions.
+*/
+HT_ErrorCode closeJoinPartitions(JoinPartitions *parts)
+{
+  CALL_OR_DIE(flushJoinPartitions(parts));
+  for (int i = 0; i < parts->n; i++)
+    BF_Block_Destroy(&parts->block[i]);
+  free(parts->first);
+  free(parts->count);
+  free(parts->block);
+  free(parts->page);
+  CALL_BF(BF_CloseFile(parts->fd));
+  remove(parts->filename);
 
   return HT_OK;
 }
 
-HT_ErrorCode HT_InsertEntry(int indexDesc, Record record, tid *tupleId, UpdateRecordArray *updateArray)
+/*
+  Joins partition 'p' of 'build' and 'probe'. Up to 'chunkPages' blocks of the build partition are copied into memory
+  and hashed, then the whole probe partition is streamed one block at a time against them. A build partition larger than
+  'chunkPages' blocks is joined one chunk at a time (block nested loops over the chunks); joinPartitionPair only lets
+  that happen for partitions that can't be split any more.
+  'buildFirst' is 1 if 'build' is the first side of the join, so that the callback always gets the tuple ids in order.
+*/
+HT_ErrorCode joinPartition(JoinPartitions *build, JoinPartitions *probe, int p, int chunkPages, int buildFirst,
+                           HT_JoinCallback callback, void *arg)
 {
-  for (int i = 0; i < MAX_RECORDS; i++)
+  int capacity = chunkPages * MAX_JOIN_TUPLES;
+  int bucketsN = 1;
+  while (bucketsN < capacity)
+    bucketsN <<= 1;
+
+  JoinTuple *tuples = malloc(capacity * sizeof(JoinTuple));
+  int *next = malloc(capacity * sizeof(int));
+  int *buckets = malloc(bucketsN * sizeof(int));
+  BF_Block *block;
+  BF_Block_Init(&block);
+
+  int build_num = build->first[p];
+  while (build_num != -1)
   {
-    updateArray[i].oldTupleId = -1;
-    updateArray[i].newTupleId = updateArray[i].oldTupleId;
-    strcpy(updateArray[i].city, "DUMBVILLE");
-    strcpy(updateArray[i].surname, "DUMMY");
+    // load the next chunk of the build partition
+    int tuplesN = 0;
+    for (int i = 0; i < bucketsN; i++)
+      buckets[i] = -1;
+    for (int pages = 0; pages < chunkPages && build_num != -1; pages++)
+    {
+      CALL_BF(BF_GetBlock(build->fd, build_num, block));
+      JoinPage *page = (JoinPage *)BF_Block_GetData(block);
+      for (int i = 0; i < page->header.size; i++)
+      {
+        // every tuple of this partition has the same hash % n, so the table is indexed by the rest of the hash
+        unsigned int b = (joinHash(page->tuple[i].key, build->level) / build->n) & (bucketsN - 1);
+        tuples[tuplesN] = page->tuple[i];
+        next[tuplesN] = buckets[b];
+        buckets[b] = tuplesN++;
+      }
+      build_num = page->header.next_block;
+      CALL_OR_DIE(unpinPage(block, 0));
+    }
+
+    // stream the probe partition against it
+    int probe_num = probe->first[p];
+    while (probe_num != -1)
+    {
+      CALL_BF(BF_GetBlock(probe->fd, probe_num, block));
+      JoinPage *page = (JoinPage *)BF_Block_GetData(block);
+      for (int i = 0; i < page->header.size; i++)
+      {
+        JoinTuple *tuple = &page->tuple[i];
+        unsigned int b = (joinHash(tuple->key, build->level) / build->n) & (bucketsN - 1);
+        for (int j = buckets[b]; j != -1; j = next[j])
+        {
+          if (strcmp(tuples[j].key, tuple->key) != 0)
+            continue;
+          if (buildFirst)
+            callback(tuple->key, tuples[j].tupleId, tuple->tupleId, arg);
+          else
+            callback(tuple->key, tuple->tupleId, tuples[j].tupleId, arg);
+        }
+      }
+      probe_num = page->header.next_block;
+      CALL_OR_DIE(unpinPage(block, 0));
+    }
   }
 
-  CALL_OR_DIE(checkInsertEntry(indexDesc, updateArray));
+  BF_Block_Destroy(&block);
+  free(tuples);
+  free(next);
+  free(buckets);
 
-  // Initialize block
+  return HT_OK;
+}
+
+/*
+  Adds every tuple of partition 'p' of 'parts' to 'sub', which splits them at the next level.
+*/
+HT_ErrorCode repartitionJoinPartition(JoinPartitions *parts, int p, JoinPartitions *sub)
+{
   BF_Block *block;
   BF_Block_Init(&block);
 
-  // get depth
-  int depth;
-  int fd = indexArray[indexDesc].fd;
-  CALL_OR_DIE(getDepth(fd, block, &depth));
-
-  // get HashTable
-  HashEntry hashEntry;
-  CALL_OR_DIE(getHashTable(fd, block, &hashEntry));
+  int block_num = parts->first[p];
+  while (block_num != -1)
+  {
+    CALL_BF(BF_GetBlock(parts->fd, block_num, block));
+    JoinPage *page = (JoinPage *)BF_Block_GetData(block);
+    for (int i = 0; i < page->header.size; i++)
+      CALL_OR_DIE(addJoinTuple(sub, page->tuple[i].key, page->tuple[i].tupleId));
+    block_num = page->header.next_block;
+    CALL_OR_DIE(unpinPage(block, 0));
+  }
 
-  // get bucket
-  int value = hashFunction(record.id, depth);
-  int blockN = getBucket(value, hashEntry);
+  BF_Block_Destroy(&block);
+  return flushJoinPartitions(sub);
+}
 
-  // get bucket's entry
-  Entry entry;
-  CALL_OR_DIE(getEntry(fd, block, blockN, &entry));
+/*
+  Joins partition 'p' of 'parts1' and 'parts2', building on the smaller side (on the second side if they are equal).
+  If the build side doesn't fit in 'memoryBlocks' - 1 blocks, both partitions are split again with joinHash at the next
+  level into two new temporary files, and every new pair is joined the same way. Only a pair that is at JOIN_MAX_LEVEL,
+  or that the new hash didn't split at all (one key), is joined in chunks by joinPartition.
+*/
+HT_ErrorCode joinPartitionPair(JoinPartitions *parts1, JoinPartitions *parts2, int p, int memoryBlocks,
+                               HT_JoinCallback callback, void *arg)
+{
+  int count1 = parts1->count[p];
+  int count2 = parts2->count[p];
+  if (count1 == 0 || count2 == 0)
+    return HT_OK;
 
-  char *data;
+  int buildFirst = count1 < count2;
+  int tuples = buildFirst ? count1 : count2;
+  int pages = (tuples + MAX_JOIN_TUPLES - 1) / MAX_JOIN_TUPLES;
+  if (pages <= memoryBlocks - 1 || parts1->level >= JOIN_MAX_LEVEL)
+  {
+    if (buildFirst)
+      return joinPartition(parts1, parts2, p, memoryBlocks - 1, 1, callback, arg);
+    return joinPartition(parts2, parts1, p, memoryBlocks - 1, 0, callback, arg);
+  }
 
-  // number of Records in the block
-  int size = entry.header.size;
-  int local_depth = entry.header.local_depth;
+  // one block of the partition being read stays pinned next to the last block of every new partition
+  JoinPartitions sub1, sub2;
+  int n = getJoinPartitionsN(tuples, memoryBlocks);
+  CALL_OR_DIE(openJoinPartitions(&sub1, n, 1, parts1->level + 1));
+  CALL_OR_DIE(openJoinPartitions(&sub2, n, 2, parts2->level + 1));
+  CALL_OR_DIE(repartitionJoinPartition(parts1, p, &sub1));
+  CALL_OR_DIE(repartitionJoinPartition(parts2, p, &sub2));
 
-  // check for available space
-  if (size >= MAX_RECORDS)
+  for (int q = 0; q < n; q++)
   {
-    // check local depth
-    if (local_depth == depth)
+    if (sub1.count[q] == count1 && sub2.count[q] == count2)
     {
-      // double HashTable
-      CALL_OR_DIE(doubleHashTable(fd, block, &hashEntry));
-      depth++;
-      CALL_OR_DIE(setDepth(fd, block, depth));
+      // nothing was split, so splitting again won't help either
+      if (buildFirst)
+      {
+        CALL_OR_DIE(joinPartition(&sub1, &sub2, q, memoryBlocks - 1, 1, callback, arg));
+      }
+      else
+      {
+        CALL_OR_DIE(joinPartition(&sub2, &sub1, q, memoryBlocks - 1, 0, callback, arg));
+      }
+    }
+    else
+    {
+      CALL_OR_DIE(joinPartitionPair(&sub1, &sub2, q, memoryBlocks, callback, arg));
     }
-    // spit hashTable's pointers
-    CALL_OR_DIE(splitHashTable(fd, block, depth, blockN, record, tupleId, updateArray, entry));
-    return HT_OK;
   }
 
-  // space available
-  CALL_OR_DIE(getEntry(fd, block, blockN, &entry));
+  CALL_OR_DIE(closeJoinPartitions(&sub1));
+  CALL_OR_DIE(closeJoinPartitions(&sub2));
 
-  // insert new record (whithout splitting)
-  entry.record[entry.header.size] = record;
-  *tupleId = getTid(blockN, entry.header.size);
-  (entry.header.size)++;
+  return HT_OK;
+}
+
+/*
+  Joins every pair of partitions of 'parts1' and 'parts2' (which must have the same n and level) with joinPartitionPair.
+*/
+HT_ErrorCode joinPartitions(JoinPartitions *parts1, JoinPartitions *parts2, int memoryBlocks, HT_JoinCallback callback, void *arg)
+{
+  for (int p = 0; p < parts1->n; p++)
+    CALL_OR_DIE(joinPartitionPair(parts1, parts2, p, memoryBlocks, callback, arg));
+
+  return HT_OK;
+}
+
+/*
+  Scans every record of the open file 'indexDesc' and adds its 'field' and tuple id to 'parts'.
+*/
+HT_ErrorCode partitionRecords(int indexDesc, const char *field, JoinPartitions *parts)
+{
+  HT_Scan scan;
+  Record record;
+  tid tupleId;
+  char key[sizeof(((JoinTuple *)0)->key)];
+
+  CALL_OR_DIE(HT_ScanOpen(indexDesc, &scan));
+  while (1)
+  {
+    CALL_OR_DIE(HT_ScanNext(&scan, &record, &tupleId));
+    if (tupleId == -1)
+      break;
+    CALL_OR_DIE(getRecordKey(&record, field, key));
+    CALL_OR_DIE(addJoinTuple(parts, key, tupleId));
+  }
+  CALL_OR_DIE(HT_ScanClose(&scan));
+
+  return flushJoinPartitions(parts);
+}
+
+HT_ErrorCode HT_GraceJoin(int indexDesc1, int indexDesc2, const char *field, int memoryBlocks, HT_JoinCallback callback, void *arg)
+{
+  if (checkGraceJoin(indexDesc1, indexDesc2, field, memoryBlocks) != HT_OK)
+    return HT_ERROR;
+
+  // partition for the smaller side, the one most partitions will build on
+  TidMap *tidMap1 = &indexArray[indexDesc1].tidMap;
+  TidMap *tidMap2 = &indexArray[indexDesc2].tidMap;
+  int tuples1 = tidMap1->size - tidMap1->freeN;
+  int tuples2 = tidMap2->size - tidMap2->freeN;
+  int n = getJoinPartitionsN(tuples1 < tuples2 ? tuples1 : tuples2, memoryBlocks);
+
+  JoinPartitions parts1, parts2;
+  CALL_OR_DIE(openJoinPartitions(&parts1, n, 1, 0));
+  CALL_OR_DIE(openJoinPartitions(&parts2, n, 2, 0));
+  CALL_OR_DIE(partitionRecords(indexDesc1, field, &parts1));
+  CALL_OR_DIE(partitionRecords(indexDesc2, field, &parts2));
+
+  CALL_OR_DIE(joinPartitions(&parts1, &parts2, memoryBlocks, callback, arg));
+
+  CALL_OR_DIE(closeJoinPartitions(&parts1));
+  CALL_OR_DIE(closeJoinPartitions(&parts2));
 
-  CALL_OR_DIE(setEntry(fd, block, blockN, &entry));
   return HT_OK;
 }
 
@@ -666,22 +2679,31 @@ HT_ErrorCode checkPrintAllEntries(int indexDesc)
   depth: the global depth.
   hashEntry: the hash table.
 */
-HT_ErrorCode printAllRecords(int fd, BF_Block *block, int depth, HashEntry hashEntry)
+HT_ErrorCode printAllRecords(int fd, BF_Block *block, int depth, HashTable *hashEntry)
 {
-  for (int i = 0; i < hashEntry.header.size; i++)
+  prefetchBuckets(fd, hashEntry);
+  for (int i = 0; i < hashEntry->size; i++)
   {
-    int blockN = hashEntry.hashNode[i].block_num;
+    int blockN = hashEntry->hashNode[i].block_num;
     printf("Records with hash value %i (block_num = %i)\n", i, blockN);
 
-    // print all records
-    Entry entry;
-    CALL_OR_DIE(getEntry(fd, block, blockN, &entry));
-    for (int i = 0; i < entry.header.size; i++)
-      printRecord(entry.record[i]);
+    // print all records, of the overflow chain too
+    Entry *entry;
+    CALL_OR_DIE(pinEntry(fd, block, blockN, &entry));
+    int dif = depth - entry->header.local_depth;
+    while (1)
+    {
+      for (int i = 0; i < entry->header.size; i++)
+        printRecord(entry->record[i]);
+      int next = entry->header.next_block;
+      CALL_OR_DIE(unpinPage(block, 0));
+      if (next == -1)
+        break;
+      CALL_OR_DIE(pinEntry(fd, block, next, &entry));
+    }
 
     // skip hash values that point to the same block
-    int dif = depth - entry.header.local_depth;
-    i += pow(2.0, (double)dif) - 1;
+    i += (1 << dif) - 1;
   }
 
   return HT_OK;
@@ -694,7 +2716,7 @@ HT_ErrorCode printAllRecords(int fd, BF_Block *block, int depth, HashEntry hashE
   depth: the global depth.
   hashEntry: the hash table.
 */
-HT_ErrorCode printSepcificRecord(int fd, BF_Block *block, int id, int depth, HashEntry hashEntry)
+HT_ErrorCode printSepcificRecord(int fd, BF_Block *block, int id, int depth, HashTable *hashEntry)
 {
   int value = hashFunction(id, depth);
   int blockN = getBucket(value, hashEntry);
@@ -706,12 +2728,17 @@ HT_ErrorCode printSepcificRecord(int fd, BF_Block *block, int id, int depth, Has
     return HT_ERROR;
   }
 
-  // print record with that id
-  Entry entry;
-  CALL_OR_DIE(getEntry(fd, block, blockN, &entry));
-  for (int i = 0; i < entry.header.size; i++)
-    if (entry.record[i].id == id)
-      printRecord(entry.record[i]);
+  // print records with that id, of the overflow chain too
+  while (blockN != -1)
+  {
+    Entry *entry;
+    CALL_OR_DIE(pinEntry(fd, block, blockN, &entry));
+    for (int i = 0; i < entry->header.size; i++)
+      if (entry->record[i].id == id)
+        printRecord(entry->record[i]);
+    blockN = entry->header.next_block;
+    CALL_OR_DIE(unpinPage(block, 0));
+  }
 
   return HT_OK;
 }
@@ -722,21 +2749,13 @@ HT_ErrorCode HT_PrintAllEntries(int indexDesc, int *id)
   BF_Block_Init(&block);
 
   CALL_OR_DIE(checkPrintAllEntries(indexDesc));
-  int fd = indexArray[indexDesc].fd;
-
-  // get depth
-  int depth;
-  CALL_OR_DIE(getDepth(fd, block, &depth));
-
-  // get HashTable
-  HashEntry hashEntry;
-  CALL_OR_DIE(getHashTable(fd, block, &hashEntry));
+  IndexNode *node = &indexArray[indexDesc];
 
   HT_ErrorCode htCode;
   if (id == NULL)
-    htCode = printAllRecords(fd, block, depth, hashEntry);
+    htCode = printAllRecords(node->fd, block, node->depth, &node->hashTable);
   else
-    htCode = printSepcificRecord(fd, block, (*id), depth, hashEntry);
+    htCode = printSepcificRecord(node->fd, block, (*id), node->depth, &node->hashTable);
 
   BF_Block_Destroy(&block);
   return htCode;
@@ -747,8 +2766,20 @@ HT_ErrorCode HashStatistics(char *filename)
   BF_Block *block;
   BF_Block_Init(&block);
 
-  int id;
-  HT_OpenIndex(filename, &id);
+  // an index that is open is read from memory, its directory on the disk may be older
+  int id = -1;
+  int opened = 0;
+  for (int i = 0; i < MAX_OPEN_FILES; i++)
+    if (indexArray[i].used == 1 && strcmp(indexArray[i].filename, filename) == 0)
+    {
+      id = i;
+      break;
+    }
+  if (id == -1)
+  {
+    CALL_OR_DIE(HT_OpenIndex(filename, &id));
+    opened = 1;
+  }
   int fd = indexArray[id].fd;
 
   // get number of blocks
@@ -756,35 +2787,51 @@ HT_ErrorCode HashStatistics(char *filename)
   CALL_BF(BF_GetBlockCounter(fd, &nblocks));
   printf("File %s has %d blocks.\n", filename, nblocks);
 
-  // get depth
-  int depth;
-  CALL_OR_DIE(getDepth(fd, block, &depth));
-
-  // get hash table
-  HashEntry hashEntry;
-  CALL_OR_DIE(getHashTable(fd, block, &hashEntry));
+  int depth = indexArray[id].depth;
+  HashTable *hashEntry = &indexArray[id].hashTable;
 
-  int iter = hashEntry.header.size;
+  prefetchBuckets(fd, hashEntry);
+  int iter = hashEntry->size;
   int dataN = iter;
   int min, max, total;
   max = total = 0;
   min = -1;
   for (int i = 0; i < iter; i++)
   {
-    int blockN = hashEntry.hashNode[i].block_num;
-    Entry entry;
-    CALL_OR_DIE(getEntry(fd, block, blockN, &entry));
+    int blockN = hashEntry->hashNode[i].block_num;
+    Entry *entry;
+    CALL_OR_DIE(pinEntry(fd, block, blockN, &entry));
+    int num = entry->header.size;
+    int dif = depth - entry->header.local_depth;
+    int next = entry->header.next_block;
+    CALL_OR_DIE(unpinPage(block, 0));
+
+    // the records of the overflow chain count for the bucket
+    while (next != -1)
+    {
+      CALL_OR_DIE(pinEntry(fd, block, next, &entry));
+      num += entry->header.size;
+      next = entry->header.next_block;
+      CALL_OR_DIE(unpinPage(block, 0));
+    }
+    if (dif < 0)
+    {
+      printf("Bucket %d is deeper than the index!\n", blockN);
+      BF_Block_Destroy(&block);
+      if (opened)
+        HT_CloseFile(id);
+      return HT_ERROR;
+    }
 
-    int num = entry.header.size;
     total += num;
     if (num > max)
       max = num;
     if (num < min || min == -1)
       min = num;
 
-    int dif = depth - entry.header.local_depth;
-    i += pow(2.0, (double)dif) - 1;
-    dataN -= pow(2.0, (double)dif) - 1;
+    // the bucket is pointed to by the next 2^dif hash values
+    i += (1 << dif) - 1;
+    dataN -= (1 << dif) - 1;
   }
 
   printf("Max number of records in bucket is %i\n", max);
@@ -792,6 +2839,7 @@ HT_ErrorCode HashStatistics(char *filename)
   printf("Mean number of records in bucket is %f\n", (double)total / (double)dataN);
 
   BF_Block_Destroy(&block);
-  HT_CloseFile(id);
+  if (opened)
+    HT_CloseFile(id);
   return HT_OK;
 }
\ No newline at end of file
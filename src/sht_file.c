@@ -1,7 +1,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
 #include <math.h>
+#include <pthread.h>
+#include <unistd.h>
 
 #include "bf.h"
 #include "sht_file.h"
@@ -46,15 +49,30 @@ typedef struct
 {
   int fd;
   int used;
-  char primary_name[255];
+  char primary_name[MAX_NAME_LEN]; // το πρωτεύον αρχείο, όπως είναι στο info block του ευρετηρίου
 } SecIndexNode;
 
+// the first block of a secondary index: the InfoHeader of every index file, then the file name of its primary index
+typedef struct
+{
+  InfoHeader info;
+  char primary_name[MAX_NAME_LEN];
+} SecInfoHeader;
+
+// a bucket's block: keys packed one after the other, each one a SecKeyHeader followed by 'count' tupleIds
 typedef struct
 {
   SecHeader secHeader;
-  SecondaryRecord secRecord[SEC_MAX_RECORDS];
+  char data[]; // SEC_DATA_SIZE(page_size)
 } SecEntry;
 
+// a block with the tupleIds of a key that did not fit in the key's SecEntry
+typedef struct
+{
+  SecPostingHeader header;
+  int tupleId[]; // SEC_MAX_POSTINGS(page_size)
+} SecPostingEntry;
+
 typedef struct
 {
   int size;
@@ -62,31 +80,63 @@ typedef struct
   char attribute[20]; // ο τύπος τιμών που κάνουμε hash (city or surname)
 } SecHashHeader;
 
+// hash value i is stored at position i of the HashTable, so only the block is kept
 typedef struct
 {
-  int h_value;
   int block_num;
 } SecHashNode;
 
 typedef struct
 {
   SecHashHeader secHeader;
-  SecHashNode secHashNode[SEC_MAX_NODES];
+  SecHashNode secHashNode[]; // SEC_MAX_NODES(page_size)
 } SecHashEntry;
 
 SecIndexNode secIndexArray[MAX_OPEN_FILES]; // πινακας μεα τα ανοικτα αρχεια δευτερευοντος ευρετηριου
+pthread_mutex_t secBFMutex = PTHREAD_MUTEX_INITIALIZER; // τα νήματα της SHT_ParallelInnerJoin καλούν τη lib/libbf.so (και τους sinks με usesBF) ένα τη φορά
+
+// a field of the records that a secondary index can be built on, found by the attribute stored at its HashTable
+typedef struct
+{
+  const char *attribute;
+  size_t updateOffset; // where the field is in an UpdateRecordArray
+  size_t deltaOffset;  // where the field's hash is in a TupleDelta
+} SecKeyField;
+
+const SecKeyField secKeyFields[] = {
+    {"city", offsetof(UpdateRecordArray, city), offsetof(TupleDelta, cityHash)},
+    {"cities", offsetof(UpdateRecordArray, city), offsetof(TupleDelta, cityHash)},
+    {"surname", offsetof(UpdateRecordArray, surname), offsetof(TupleDelta, surnameHash)},
+    {"surnames", offsetof(UpdateRecordArray, surname), offsetof(TupleDelta, surnameHash)}};
+
+// a move of an UpdateRecordArray, with the secondary bucket of its key
+typedef struct
+{
+  int bucket;
+  int order; // position in the UpdateRecordArray, moves of the same bucket are applied in this order
+  UpdateRecordArray *update;
+} SecBucketUpdate;
 
 unsigned int hashAttr(const char *str, int depth)
 {
-  unsigned int hash = 5381;
-  int c;
+  // a table of depth 0 has a single hash value (and >> 32 is undefined)
+  if (depth == 0)
+    return 0;
 
-  while (c = *str++)
-    hash = ((hash << 5) + hash) + c; /* hash * 33 + c */
+  return hashString(str) >> (32 - depth);
+}
 
-  hash = hash >> (32 - depth);
+/*
+  Returns the field that a secondary index with HashTable 'attribute' is built on, or NULL if the records have no such field.
+*/
+const SecKeyField *getSecKeyField(const char *attribute)
+{
+  for (int i = 0; i < sizeof(secKeyFields) / sizeof(SecKeyField); i++)
+    if (strcmp(secKeyFields[i].attribute, attribute) == 0)
+      return &secKeyFields[i];
 
-  return hash;
+  printf("There is no record field for attribute %s!\n", attribute);
+  return NULL;
 }
 
 HT_ErrorCode SHT_Init()
@@ -131,6 +181,12 @@ HT_ErrorCode checkShtCreate(const char *sfileName, char *attrName, int attrLengt
     return HT_ERROR;
   }
 
+  if (strlen(fileName) >= MAX_NAME_LEN)
+  {
+    printf("The name of the primary file is too long! Please give up to %d characters!\n", MAX_NAME_LEN - 1);
+    return HT_ERROR;
+  }
+
   if (attrName == NULL || strcmp(attrName, "") == 0)
   {
     printf("Please provide a name for the attribute!\n");
@@ -159,15 +215,140 @@ HT_ErrorCode primaryExists(char *fileName)
   return HT_ERROR;
 }
 
+/*
+  Finds the primary index with file name 'fileName' at the open files, so that the join sees its latest TidMap
+  (which may not be on the disk yet). If it is not open, it is opened and 'opened' is set to 1, so the caller closes it.
+*/
+HT_ErrorCode getPrimaryIndex(char *fileName, int *indexDesc, int *opened)
+{
+  *opened = 0;
+  if (strcmp(fileName, "") == 0)
+  {
+    printf("The secondary index doesn't know its primary file!\n");
+    return HT_ERROR;
+  }
+  for (int i = 0; i < MAX_OPEN_FILES; i++)
+  {
+    if (indexArray[i].used == 1 && strcmp(indexArray[i].filename, fileName) == 0)
+    {
+      *indexDesc = i;
+      return HT_OK;
+    }
+  }
+
+  // a missing file is an error here, not a new empty file
+  if (access(fileName, F_OK) != 0 || HT_OpenIndex(fileName, indexDesc) != HT_OK)
+  {
+    printf("Can't open the primary file %s!\n", fileName);
+    return HT_ERROR;
+  }
+  *opened = 1;
+  return HT_OK;
+}
+
+/*
+  Copies the file name 'fileName' to the 'primaryName' of a secondary index (MAX_NAME_LEN bytes), always terminated.
+*/
+void setSecPrimaryName(char *primaryName, const char *fileName)
+{
+  strncpy(primaryName, fileName, MAX_NAME_LEN - 1);
+  primaryName[MAX_NAME_LEN - 1] = '\0';
+}
+
+/*
+  block: previously initialized BF_Block pointer (does not get destroyed)
+  Loads the file name of the primary index, stored at the info block of the secondary index 'sfd', to 'primaryName'.
+*/
+HT_ErrorCode getSecPrimaryName(int sfd, BF_Block *block, char *primaryName)
+{
+  CALL_BF(BF_GetBlock(sfd, 0, block));
+  SecInfoHeader *info = (SecInfoHeader *)BF_Block_GetData(block);
+  setSecPrimaryName(primaryName, info->primary_name);
+  CALL_BF(BF_UnpinBlock(block));
+
+  return HT_OK;
+}
+
+/*
+  block: previously initialized BF_Block pointer, that is not pinned (does not get destroyed)
+  Pins the HashTable block 'block_num' of the file with fileDesc 'fd' and points 'hashEntry' at its data, without copying it.
+  The calling function reads or changes the HashTable in place, then calls unpinPage.
+*/
+HT_ErrorCode pinSecHashEntry(int fd, BF_Block *block, int block_num, SecHashEntry **hashEntry)
+{
+  CALL_BF(BF_GetBlock(fd, block_num, block));
+  *hashEntry = (SecHashEntry *)BF_Block_GetData(block);
+
+  return HT_OK;
+}
+
+/*
+  block: previously initialized BF_Block pointer, that is not pinned (does not get destroyed)
+  Pins the block with block_num 'bucket' at file with fileDesc 'fd' and points 'entry' at its data, without copying it.
+  The calling function reads or changes the SecEntry in place, then calls unpinPage.
+*/
+HT_ErrorCode pinSecEntry(int fd, BF_Block *block, int bucket, SecEntry **entry)
+{
+  CALL_BF(BF_GetBlock(fd, bucket, block));
+  *entry = (SecEntry *)BF_Block_GetData(block);
+
+  return HT_OK;
+}
+
+/*
+  block: previously initialized BF_Block pointer, that is not pinned (does not get destroyed)
+  Allocates a new block (as allocateBlock), stores its 'block_num' and keeps it pinned, with 'entry' pointing at its data.
+  The calling function fills the SecEntry, then calls unpinPage with dirty = 1.
+*/
+HT_ErrorCode pinNewSecEntry(int fd, BF_Block *block, int *block_num, SecEntry **entry)
+{
+  CALL_OR_DIE(allocateBlock(fd, block, block_num));
+  *entry = (SecEntry *)BF_Block_GetData(block);
+
+  return HT_OK;
+}
+
+/*
+  block: previously initialized BF_Block pointer, that is not pinned (does not get destroyed)
+  Pins the posting block with block_num 'block_num' and points 'posting' at its data, without copying it.
+  The calling function reads or changes it in place, then calls unpinPage.
+*/
+HT_ErrorCode pinSecPostingEntry(int fd, BF_Block *block, int block_num, SecPostingEntry **posting)
+{
+  CALL_BF(BF_GetBlock(fd, block_num, block));
+  *posting = (SecPostingEntry *)BF_Block_GetData(block);
+
+  return HT_OK;
+}
+
+/*
+  block: previously initialized BF_Block pointer, that is not pinned (does not get destroyed)
+  Allocates a new posting block, as pinNewSecEntry does.
+*/
+HT_ErrorCode pinNewSecPostingEntry(int fd, BF_Block *block, int *block_num, SecPostingEntry **posting)
+{
+  CALL_OR_DIE(allocateBlock(fd, block, block_num));
+  *posting = (SecPostingEntry *)BF_Block_GetData(block);
+
+  return HT_OK;
+}
+
+
 /*
   block: previously initialized BF_Block pointer (does not get destroyed)
-  allocates and stores to the first block of the file with fileDesc 'fd', the global 'depht'
+  allocates and stores to the first block of the file with fileDesc 'fd', the global 'depht', an empty list of free blocks
+  and the file name 'fileName' of the primary index
 */
-HT_ErrorCode createSecInfoBlock(int sfd, BF_Block *block, int depth)
+HT_ErrorCode createSecInfoBlock(int sfd, BF_Block *block, int depth, const char *fileName)
 {
   CALL_BF(BF_AllocateBlock(sfd, block));
-  char *data = BF_Block_GetData(block);
-  memcpy(data, &depth, sizeof(int));
+  SecInfoHeader *secInfo = (SecInfoHeader *)BF_Block_GetData(block);
+  InfoHeader *info = &secInfo->info;
+  info->depth = depth;
+  info->free_block = -1;
+  info->tid_map = -1;
+  info->page_size = getPageSize(sfd);
+  setSecPrimaryName(secInfo->primary_name, fileName);
   BF_Block_SetDirty(block);
   CALL_BF(BF_UnpinBlock(block));
   return HT_OK;
@@ -179,42 +360,34 @@ HT_ErrorCode createSecInfoBlock(int sfd, BF_Block *block, int depth)
 */
 HT_ErrorCode createSecHashTable(int sfd, BF_Block *block, int depth, char *attrName)
 {
-  SecHashEntry secHashEntry;
   int hashN = pow(2.0, (double)depth);
-  secHashEntry.secHeader.next_hblock = -1;
-  strcpy(secHashEntry.secHeader.attribute, attrName);
   int blockN;
-  char *data;
-
-  // allocate space for the HashTable
-  CALL_BF(BF_AllocateBlock(sfd, block));
-  CALL_BF(BF_UnpinBlock(block));
 
-  // set empty entry header
-  SecEntry empty;
-  empty.secHeader.local_depth = depth;
-  empty.secHeader.size = 0;
+  // allocate space for the HashTable, it stays pinned at its own block while the buckets are allocated
+  BF_Block *hashBlock;
+  BF_Block_Init(&hashBlock);
+  CALL_BF(BF_AllocateBlock(sfd, hashBlock));
+  SecHashEntry *secHashEntry = (SecHashEntry *)BF_Block_GetData(hashBlock);
+  secHashEntry->secHeader.next_hblock = -1;
+  strcpy(secHashEntry->secHeader.attribute, attrName);
 
   // Link every hash value an empty data block
-  secHashEntry.secHeader.size = hashN;
+  secHashEntry->secHeader.size = hashN;
   for (int i = 0; i < hashN; i++)
   {
-    secHashEntry.secHashNode[i].h_value = i;
-    BF_GetBlockCounter(sfd, &blockN);
-    CALL_BF(BF_AllocateBlock(sfd, block));
-    data = BF_Block_GetData(block);
-    memcpy(data, &empty, sizeof(SecEntry));
-    BF_Block_SetDirty(block);
-    CALL_BF(BF_UnpinBlock(block));
-    secHashEntry.secHashNode[i].block_num = blockN;
+    SecEntry *empty;
+    CALL_OR_DIE(pinNewSecEntry(sfd, block, &blockN, &empty));
+    empty->secHeader.local_depth = depth;
+    empty->secHeader.size = 0;
+    empty->secHeader.next_block = -1;
+    empty->secHeader.used = 0;
+    CALL_OR_DIE(unpinPage(block, 1));
+    secHashEntry->secHashNode[i].block_num = blockN;
   }
 
   // Store HashTable
-  BF_GetBlock(sfd, 1, block);
-  data = BF_Block_GetData(block);
-  memcpy(data, &secHashEntry, sizeof(SecHashEntry));
-  BF_Block_SetDirty(block);
-  CALL_BF(BF_UnpinBlock(block));
+  CALL_OR_DIE(unpinPage(hashBlock, 1));
+  BF_Block_Destroy(&hashBlock);
 
   return HT_OK;
 }
@@ -232,10 +405,10 @@ HT_ErrorCode SHT_CreateSecondaryIndex(const char *sfileName, char *attrName, int
   int id;
   SHT_OpenSecondaryIndex(sfileName, &id);
   int sfd = secIndexArray[id].fd;
-  memcpy(secIndexArray[id].primary_name, fileName, strlen(fileName));
+  setSecPrimaryName(secIndexArray[id].primary_name, fileName);
 
   // create info block and sec hash table
-  CALL_OR_DIE(createSecInfoBlock(sfd, block, depth));
+  CALL_OR_DIE(createSecInfoBlock(sfd, block, depth, fileName));
   CALL_OR_DIE(createSecHashTable(sfd, block, depth, attrName));
 
   BF_Block_Destroy(&block);
@@ -264,7 +437,26 @@ HT_ErrorCode SHT_OpenSecondaryIndex(const char *sfileName, int *indexDesc)
 
   int fd;
   CALL_BF(BF_OpenFile(sfileName, &fd));
-  int pos = (*indexDesc);      // Return position
+
+  // a new file gets the page size of HT_SetPageSize (and its primary at SHT_CreateSecondaryIndex), an existing one
+  // the page size and the primary of its info block
+  int pos = (*indexDesc);
+  int blocks;
+  CALL_BF(BF_GetBlockCounter(fd, &blocks));
+  if (blocks == 0)
+  {
+    CALL_OR_DIE(setPageSize(fd, htPageSize));
+    secIndexArray[pos].primary_name[0] = '\0';
+  }
+  else
+  {
+    BF_Block *block;
+    BF_Block_Init(&block);
+    CALL_OR_DIE(loadPageSize(fd, block));
+    CALL_OR_DIE(getSecPrimaryName(fd, block, secIndexArray[pos].primary_name));
+    BF_Block_Destroy(&block);
+  }
+
   secIndexArray[pos].fd = fd;  // Save fileDesc
   secIndexArray[pos].used = 1; // Set position to used
 
@@ -286,29 +478,44 @@ HT_ErrorCode SHT_CloseSecondaryIndex(int indexDesc)
   return HT_OK;
 }
 
-/*
-  block: previously initialized BF_Block pointer (does not get destroyed)
-  stores the HashTable from file with fileDesc 'fd', at 'block_num' to 'hashEntry' variable.
-*/
-HT_ErrorCode getSecHashTable(int fd, BF_Block *block, int block_num, SecHashEntry *hashEntry)
+HT_ErrorCode SHT_MapSecondaryIndex(int indexDesc)
 {
-  CALL_BF(BF_GetBlock(fd, block_num, block));
-  char *data = BF_Block_GetData(block);
-  memcpy(hashEntry, data, sizeof(SecHashEntry));
-  CALL_BF(BF_UnpinBlock(block));
+  if (indexDesc < 0 || indexDesc >= MAX_OPEN_FILES || secIndexArray[indexDesc].used == 0)
+  {
+    printf("Trying to map a closed file!\n");
+    return HT_ERROR;
+  }
 
+#ifdef BF_SRC
+  CALL_BF(BF_MapFile(secIndexArray[indexDesc].fd));
   return HT_OK;
+#else
+  printf("Mapping a file needs the BF level of src/bf.c (make ... BF=src)!\n");
+  return HT_ERROR;
+#endif
 }
 
 /*
   Returns the block_num of the data block that hash 'value' from HashTable 'hashEntry' points to.
 */
-int getSecBucket(int value, SecHashEntry hashEntry)
+int getSecBucket(int value, SecHashEntry *hashEntry)
+{
+  return hashEntry->secHashNode[value].block_num;
+}
+
+/*
+  Prefetches every bucket of the HashTable 'hashEntry' once (prefetchBlocks), for a loop over all its buckets.
+  The hash values of a bucket are next to each other.
+*/
+void prefetchSecBuckets(int fd, SecHashEntry *hashEntry)
 {
-  int pos = -1;
-  for (pos = 0; pos < hashEntry.secHeader.size; pos++)
-    if (hashEntry.secHashNode[pos].h_value == value)
-      return hashEntry.secHashNode[pos].block_num;
+  int *blocks = malloc(hashEntry->secHeader.size * sizeof(int));
+  int n = 0;
+  for (int i = 0; i < hashEntry->secHeader.size; i++)
+    if (n == 0 || hashEntry->secHashNode[i].block_num != blocks[n - 1])
+      blocks[n++] = hashEntry->secHashNode[i].block_num;
+  prefetchBlocks(fd, blocks, n);
+  free(blocks);
 }
 
 /*
@@ -326,685 +533,3291 @@ HT_ErrorCode checkSecInsertEntry(int indexDesc, SecondaryRecord record)
 }
 
 /*
-  block: previously initialized BF_Block pointer (does not get destroyed)
-  Stores the Entry from block with block_num 'bucket' at file with fileDesc 'fd', at 'entry' variable.
+  'value' : any hash value that points to the bucket we are interested in.
+  'depth' : global depth of the hash table.
+  'local_depth' : local depth of bucket.
+   Stores at first and end the first and last index of the hash table, that points to the bucket. Stores at half the medium of [first, last].
 */
-HT_ErrorCode getSecEntry(int fd, BF_Block *block, int bucket, SecEntry *entry)
+HT_ErrorCode getSecEndPoints(int *first, int *half, int *end, int local_depth, int depth, int value)
 {
-  BF_GetBlock(fd, bucket, block);
-  char *data = BF_Block_GetData(block);
-  memcpy(entry, data, sizeof(SecEntry));
-  CALL_BF(BF_UnpinBlock(block));
+  int dif = depth - local_depth;
+  int numOfHashes = 1 << dif;
+  *first = (value >> dif) << dif;
 
+  *half = (*first) + numOfHashes / 2 - 1;
+  *end = (*first) + numOfHashes - 1;
   return HT_OK;
 }
 
 /*
-  block: previously initialized BF_Block pointer (does not get destroyed).
-  fd: fileDesc of file we want.
-  Saves the HashTable 'hashEntry' at the disk at 'block_num'.
+  Returns the number of bytes 'key' occupies in a SecEntry: its header and the tupleIds stored right after it.
 */
-HT_ErrorCode setSecHashTable(int fd, BF_Block *block, int block_num, SecHashEntry *hashEntry)
+int getSecKeySize(SecKeyHeader *key)
 {
-  CALL_BF(BF_GetBlock(fd, block_num, block));
-  char *data = BF_Block_GetData(block);
-  memcpy(data, hashEntry, sizeof(SecHashEntry));
-  BF_Block_SetDirty(block);
-  CALL_BF(BF_UnpinBlock(block));
-  return HT_OK;
+  return sizeof(SecKeyHeader) + key->count * sizeof(int);
 }
 
 /*
-  'hashEntry' : hash table.
-  'bucket' : block we are interested in.
-  'depth' : global depth of the hash table.
-  'local_depth' : local depth of bucket.
-   Stores at first and end the first and last index of the hash table, that points to the bucket. Stores at half the medium of [first, last].
+  Returns the offset in entry's data of the key 'index_key', or -1 if the entry does not have it.
 */
-HT_ErrorCode getSecEndPoints(int *first, int *half, int *end, int local_depth, int depth, int bucket, SecHashEntry hashEntry)
+int findSecKey(SecEntry *entry, const char *index_key)
 {
-  int dif = depth - local_depth;
-  int numOfHashes = pow(2.0, (double)dif);
-  for (int pos = 0; pos < hashEntry.secHeader.size; pos++)
-    if (hashEntry.secHashNode[pos].block_num == bucket)
-    {
-      *first = pos;
-      break;
-    }
+  int offset = 0;
+  for (int i = 0; i < entry->secHeader.size; i++)
+  {
+    SecKeyHeader *key = (SecKeyHeader *)(entry->data + offset);
+    if (strcmp(key->index_key, index_key) == 0)
+      return offset;
+    offset += getSecKeySize(key);
+  }
 
-  *half = (*first) + numOfHashes / 2 - 1;
-  *end = (*first) + numOfHashes - 1;
-  return HT_OK;
+  return -1;
 }
 
 /*
-  Reassigns records from one block to two. Used when need to split. !It doesn't split, it reassigns!
-  The two new blocks consist of the old block and a new one that has been allocated.
-  block: previously initialized BF_Block pointer (does not get destroyed).
-  fd: fileDesc of file we want.
-  entry: the Entry that was in the block we are reassigning from.
-  old: address of the entry that will remain in the old block.
-  new: address of the entry that will be in the new block.
-  blockOld: block_num of old block.
-  blockNew: block_num of new block.
-  depth: global depth.
-  half: medium of [first, end]. first is the first index of the hash table that points to the old block and end is the last.
-  updateArray: the array we stores record updates.
+  Appends a SecondaryRecord for every tupleId of 'key' at 'records': the ones stored next to the key and the ones of its posting blocks.
+  key: a key of a pinned SecEntry, its tupleIds follow it in memory. Its posting blocks are pinned one at a time with a block of this function.
+  records: grows (realloc) when 'capacity' is reached.
+  n: number of records in 'records', updated.
 */
-HT_ErrorCode reassignSecRecords(int fd, BF_Block *block, SecEntry entry, int blockOld, int blockNew, int half, int depth, SecEntry *old, SecEntry *new)
+HT_ErrorCode loadSecKeyRecords(int fd, SecKeyHeader *key, SecondaryRecord **records, int *n, int *capacity)
 {
-  for (int i = 0; i < entry.secHeader.size; i++)
+  int *tupleIds = (int *)(key + 1);
+  int count = key->count;
+  int next = key->next_posting;
+  BF_Block *postingBlock = NULL;
+  SecPostingEntry *posting = NULL;
+
+  while (1)
   {
-    if (hashAttr(entry.secRecord[i].index_key, depth) <= half)
+    if (*n + count > *capacity)
     {
-      // reassign to new position in old block
-      old->secRecord[old->secHeader.size] = entry.secRecord[i];
-      old->secHeader.size++;
+      while (*n + count > *capacity)
+        *capacity *= 2;
+      *records = realloc(*records, *capacity * sizeof(SecondaryRecord));
     }
-    else
+    for (int i = 0; i < count; i++)
     {
-      // assign to new block
-      new->secRecord[new->secHeader.size] = entry.secRecord[i];
-      new->secHeader.size++;
+      strcpy((*records)[*n].index_key, key->index_key);
+      (*records)[(*n)++].tupleId = tupleIds[i];
     }
+
+    if (posting != NULL)
+      CALL_OR_DIE(unpinPage(postingBlock, 0));
+    if (next == -1)
+      break;
+
+    if (postingBlock == NULL)
+      BF_Block_Init(&postingBlock);
+    CALL_OR_DIE(pinSecPostingEntry(fd, postingBlock, next, &posting));
+    tupleIds = posting->tupleId;
+    count = posting->header.size;
+    next = posting->header.next_block;
   }
 
+  if (postingBlock != NULL)
+    BF_Block_Destroy(&postingBlock);
   return HT_OK;
 }
 
 /*
-  Inserts a record after the block it should go, was splitted.
-  The two new blocks (after spliting) consist of the old block and a new one that has been allocated.
-  record: the record we're inserting.
-  depth: the global depth.
-  half: medium of [first, end]. first is the first index of the hash table that points to the old block and end is the last.
-  tupleId: the tupleId of the record after insertion.
-  old: address of the entry that will remain in the old block.
-  new: address of the entry that will be in the new block.
-  blockOld: block_num of old block.
-  blockNew: block_num of new block.
+  Calls 'callback' with 'arg' for every tupleId of 'key': the ones stored next to the key and the ones of its posting blocks.
+  key: a key of a pinned SecEntry. Its posting blocks are pinned one at a time with a block of this function.
 */
-HT_ErrorCode insertSecRecordAfterSplit(SecondaryRecord secondaryRecord, int depth, int half, int blockOld, int blockNew, SecEntry *old, SecEntry *new)
+HT_ErrorCode visitSecKeyPostings(int fd, SecKeyHeader *key, SHT_LookupCallback callback, void *arg)
 {
-  // store given record
-  if (hashAttr(secondaryRecord.index_key, depth) <= half)
-  {
-    old->secRecord[old->secHeader.size] = secondaryRecord;
+  int *tupleIds = (int *)(key + 1);
+  for (int i = 0; i < key->count; i++)
+    callback(tupleIds[i], arg);
 
-    old->secHeader.size++;
-  }
-  else
-  {
-    new->secRecord[new->secHeader.size] = secondaryRecord;
+  int next = key->next_posting;
+  if (next == -1)
+    return HT_OK;
 
-    new->secHeader.size++;
+  BF_Block *postingBlock;
+  BF_Block_Init(&postingBlock);
+  while (next != -1)
+  {
+    SecPostingEntry *posting;
+    CALL_OR_DIE(pinSecPostingEntry(fd, postingBlock, next, &posting));
+    for (int i = 0; i < posting->header.size; i++)
+      callback(posting->tupleId[i], arg);
+    next = posting->header.next_block;
+    CALL_OR_DIE(unpinPage(postingBlock, 0));
   }
 
+  BF_Block_Destroy(&postingBlock);
   return HT_OK;
 }
 
 /*
-  Stores given Entry at a block.
+  Loads every SecondaryRecord of a bucket, following its chain of overflow blocks and the posting blocks of its keys.
   fd: fileDesc of file we are interested in.
-  block: previously initialized BF_Block pointer (does not get destroyed).
-  dest_block_num: block_num of the block we are storing Entry at.
-  entry: the Entry.
+  block: previously initialized BF_Block pointer, that is not pinned (does not get destroyed).
+  bucket: block_num of the bucket's first block.
+  records: allocated here, must be freed by the calling function.
+  n: number of records loaded.
+  local_depth: the local depth of the bucket (can be NULL).
 */
-HT_ErrorCode setSecEntry(int fd, BF_Block *block, int dest_block_num, SecEntry *entry)
+HT_ErrorCode getSecBucketRecords(int fd, BF_Block *block, int bucket, SecondaryRecord **records, int *n, int *local_depth)
 {
-  CALL_BF(BF_GetBlock(fd, dest_block_num, block));
-  char *data = BF_Block_GetData(block);
-  memcpy(data, entry, sizeof(SecEntry));
-  BF_Block_SetDirty(block);
-  CALL_BF(BF_UnpinBlock(block));
+  SecEntry *entry;
+  int capacity = SEC_MAX_POSTINGS(getPageSize(fd));
+  *records = malloc(capacity * sizeof(SecondaryRecord));
+  *n = 0;
+
+  // an error is returned (with 'records' freed), so that the threads of SHT_ParallelInnerJoin can stop without exiting
+  HT_ErrorCode code = HT_OK;
+  int block_num = bucket;
+  do
+  {
+    code = pinSecEntry(fd, block, block_num, &entry);
+    if (code != HT_OK)
+      break;
+    if (block_num == bucket && local_depth != NULL)
+      *local_depth = entry->secHeader.local_depth;
 
-  return HT_OK;
+    int offset = 0;
+    for (int i = 0; i < entry->secHeader.size && code == HT_OK; i++)
+    {
+      SecKeyHeader *key = (SecKeyHeader *)(entry->data + offset);
+      code = loadSecKeyRecords(fd, key, records, n, &capacity);
+      offset += getSecKeySize(key);
+    }
+    block_num = entry->secHeader.next_block;
+    if (unpinPage(block, 0) != HT_OK)
+      code = HT_ERROR;
+  } while (block_num != -1 && code == HT_OK);
+
+  if (code != HT_OK)
+  {
+    free(*records);
+    *records = NULL;
+    *n = 0;
+  }
+  return code;
 }
 
 /*
-  block: previously initialized BF_Block pointer (does not get destroyed).
-  fd: fileDesc of file we want.
-  Doubles the HashTable 'hashEntry', updates memory and disk data at the end.
+  Loads a SecondaryRecord for every tupleId of 'index_key', looking only at the bucket that starts at 'bucket'.
+  records: allocated here, must be freed by the calling function.
+  n: number of records loaded (0 if the key is not in the bucket).
 */
-HT_ErrorCode doubleSecHashTable(int fd, BF_Block *block, SecHashEntry *hashEntry)
+HT_ErrorCode getSecKeyRecords(int fd, BF_Block *block, int bucket, const char *index_key, SecondaryRecord **records, int *n)
 {
-  // double table
-  SecHashEntry new = (*hashEntry);
-  new.secHeader.size = (*hashEntry).secHeader.size * 2;
-  for (unsigned int i = 0; i < new.secHeader.size; i++)
+  SecEntry *entry;
+  int capacity = SEC_MAX_POSTINGS(getPageSize(fd));
+  *records = malloc(capacity * sizeof(SecondaryRecord));
+  *n = 0;
+
+  // a key is stored once in its bucket, so stop at the first block that has it
+  int block_num = bucket;
+  do
   {
-    new.secHashNode[i].block_num = (*hashEntry).secHashNode[i >> 1].block_num;
-    new.secHashNode[i].h_value = i;
-  }
+    CALL_OR_DIE(pinSecEntry(fd, block, block_num, &entry));
+    int offset = findSecKey(entry, index_key);
+    if (offset != -1)
+      CALL_OR_DIE(loadSecKeyRecords(fd, (SecKeyHeader *)(entry->data + offset), records, n, &capacity));
+
+    block_num = offset != -1 ? -1 : entry->secHeader.next_block;
+    CALL_OR_DIE(unpinPage(block, 0));
+  } while (block_num != -1);
 
-  // update changes in disk and memory
-  CALL_OR_DIE(setSecHashTable(fd, block, 1, &new));
-  (*hashEntry) = new;
   return HT_OK;
 }
 
 /*
-  Splits a HashTable's block, reassigns records, and stores updated data.
-  fd: fileDesc of file we are interested in.
-  block: previously initialized BF_Block pointer (does not get destroyed).
-  depth: global depth.
-  bucket: the block_num of the block we are spliting.
-  record: the record that when added caused the spliting. Inserted at the end.
-  tupleId: the tupleId of the record after it is inserted.
-  updateArray: the array we are storing records' updates.
-  entry: the Entry of the block before it splitted.
+  Loads every key of a bucket with the tupleIds stored next to it (not its posting blocks), following its chain of overflow blocks.
+  keys: allocated here, the keys one after the other as stored in a SecEntry. Must be freed by the calling function.
+  n: number of keys loaded.
+  bytes: number of bytes loaded.
 */
-HT_ErrorCode splitSecHashTable(int fd, BF_Block *block, int depth, int bucket, SecondaryRecord record, SecEntry entry)
+HT_ErrorCode getSecBucketKeys(int fd, BF_Block *block, int bucket, char **keys, int *n, int *bytes)
 {
-  // get HashTable
-  SecHashEntry hashEntry;
-  CALL_OR_DIE(getSecHashTable(fd, block, 1, &hashEntry));
-
-  // get end points
-  int local_depth = entry.secHeader.local_depth;
-  int first, half, end;
-  CALL_OR_DIE(getSecEndPoints(&first, &half, &end, local_depth, depth, bucket, hashEntry));
-
-  // get a new block
-  int blockNew;
-  CALL_OR_DIE(getNewBlock(fd, block, &blockNew));
-
-  SecEntry old, new;
-  new.secHeader.local_depth = local_depth + 1;
-  new.secHeader.size = 0;
-
-  old = entry;
-  old.secHeader.local_depth++;
-  old.secHeader.size = 0;
+  SecEntry *entry;
+  int capacity = SEC_DATA_SIZE(getPageSize(fd));
+  *keys = malloc(capacity);
+  *n = *bytes = 0;
 
-  for (int i = half + 1; i <= end; i++)
-    hashEntry.secHashNode[i].block_num = blockNew;
-
-  // update HashTable and re-assing records
-  CALL_OR_DIE(setSecHashTable(fd, block, 1, &hashEntry));
-  CALL_OR_DIE(reassignSecRecords(fd, block, entry, bucket, blockNew, half, depth, &old, &new));
-
-  if (new.secHeader.size == 0)
+  int block_num = bucket;
+  do
   {
-    printf("Reassign Records Error! No secRecords assigned to new\n");
-    CALL_OR_DIE(setSecEntry(fd, block, bucket, &old));
-    CALL_OR_DIE(setSecEntry(fd, block, blockNew, &new));
-    return 2;
-  }
+    CALL_OR_DIE(pinSecEntry(fd, block, block_num, &entry));
+    if (*bytes + entry->secHeader.used > capacity)
+    {
+      capacity *= 2;
+      *keys = realloc(*keys, capacity);
+    }
+    memcpy(*keys + *bytes, entry->data, entry->secHeader.used);
+    *bytes += entry->secHeader.used;
+    *n += entry->secHeader.size;
+    block_num = entry->secHeader.next_block;
+    CALL_OR_DIE(unpinPage(block, 0));
+  } while (block_num != -1);
 
-  if (old.secHeader.size == 0)
+  return HT_OK;
+}
+
+/*
+  Stores the block_nums of a bucket's overflow blocks (not the bucket itself) at 'blocks', and their number at 'n'.
+  blocks: allocated here, must be freed by the calling function.
+*/
+HT_ErrorCode getSecOverflowBlocks(int fd, BF_Block *block, int bucket, int **blocks, int *n)
+{
+  SecEntry *entry;
+  int capacity = 4;
+  *blocks = malloc(capacity * sizeof(int));
+  *n = 0;
+
+  CALL_OR_DIE(pinSecEntry(fd, block, bucket, &entry));
+  int next = entry->secHeader.next_block;
+  CALL_OR_DIE(unpinPage(block, 0));
+  while (next != -1)
   {
-    printf("Reassign Records Error! No secRecords assigned to old\n");
-    CALL_OR_DIE(setSecEntry(fd, block, bucket, &old));
-    CALL_OR_DIE(setSecEntry(fd, block, blockNew, &new));
-    return 2;
+    if (*n == capacity)
+    {
+      capacity *= 2;
+      *blocks = realloc(*blocks, capacity * sizeof(int));
+    }
+    (*blocks)[(*n)++] = next;
+    CALL_OR_DIE(pinSecEntry(fd, block, next, &entry));
+    next = entry->secHeader.next_block;
+    CALL_OR_DIE(unpinPage(block, 0));
   }
 
-  // insert new record (after splitting)
-  CALL_OR_DIE(insertSecRecordAfterSplit(record, depth, half, bucket, blockNew, &old, &new));
-
-  // store created/modified entries
-  CALL_OR_DIE(setSecEntry(fd, block, bucket, &old));
-  CALL_OR_DIE(setSecEntry(fd, block, blockNew, &new));
-
   return HT_OK;
 }
 
-HT_ErrorCode SHT_SecondaryInsertEntry(int indexDesc, SecondaryRecord record)
+/*
+  Writes 'keys' (as loaded by getSecBucketKeys) as the whole content of the bucket that starts at 'bucket'.
+  Keys that don't fit in the bucket go to overflow blocks, which are taken from 'spare' (blocks freed by a split) first,
+  and allocated at the end of the file otherwise. The posting blocks of the keys are not touched.
+  local_depth: the local depth stored at every block of the bucket.
+*/
+HT_ErrorCode writeSecChain(int fd, BF_Block *block, int bucket, int local_depth, char *keys, int n, int *spare, int *spareN)
 {
-  // insert code here
-  // printSecRecord(record);
-  CALL_OR_DIE(checkSecInsertEntry(indexDesc, record));
+  SecEntry *entry;
+  int dataSize = SEC_DATA_SIZE(getPageSize(fd));
+  int block_num = bucket;
+  int written = 0;
+  int offset = 0;
+  do
+  {
+    // the keys that fit in this block, a key always fits in an empty block as it came from one
+    int count = 0;
+    int bytes = 0;
+    while (written + count < n)
+    {
+      int keySize = getSecKeySize((SecKeyHeader *)(keys + offset + bytes));
+      if (bytes + keySize > dataSize)
+        break;
+      bytes += keySize;
+      count++;
+    }
 
-  // Initialize block
-  BF_Block *block;
-  BF_Block_Init(&block);
+    // chain one more block for the keys left
+    int next = -1;
+    if (written + count < n)
+    {
+      if (*spareN > 0)
+        next = spare[--(*spareN)];
+      else
+        CALL_OR_DIE(getNewBlock(fd, block, &next));
+    }
 
-  // get depth
-  int depth;
-  int fd = secIndexArray[indexDesc].fd;
-  CALL_OR_DIE(getDepth(fd, block, &depth));
+    CALL_OR_DIE(pinSecEntry(fd, block, block_num, &entry));
+    entry->secHeader.local_depth = local_depth;
+    entry->secHeader.size = count;
+    entry->secHeader.used = bytes;
+    entry->secHeader.next_block = next;
+    memcpy(entry->data, keys + offset, bytes);
+    CALL_OR_DIE(unpinPage(block, 1));
+
+    offset += bytes;
+    written += count;
+    block_num = next;
+  } while (block_num != -1);
 
-  // get HashTable
-  SecHashEntry hashEntry;
-  CALL_OR_DIE(getSecHashTable(fd, block, 1, &hashEntry));
+  return HT_OK;
+}
 
-  // get bucket
-  unsigned int value = hashAttr(record.index_key, depth);
-  int blockN = getSecBucket(value, hashEntry);
+/*
+  Writes 'index_key' as the name of 'key': at most size - 1 bytes of it, zero padded, so the name always ends.
+*/
+void setSecKeyName(SecKeyHeader *key, const char *index_key)
+{
+  size_t len = strnlen(index_key, sizeof(key->index_key) - 1);
+  memset(key->index_key, 0, sizeof(key->index_key));
+  memcpy(key->index_key, index_key, len);
+  key->index_key[len] = '\0';
+}
 
-  // get bucket's entry
-  SecEntry entry;
-  CALL_OR_DIE(getSecEntry(fd, block, blockN, &entry));
+/*
+  Adds a new key, with 'record.tupleId' as its only tupleId, at the end of the pinned 'entry'.
+  The entry must have space for it, the calling function marks it dirty.
+*/
+void appendSecKey(SecEntry *entry, SecondaryRecord record)
+{
+  SecKeyHeader *key = (SecKeyHeader *)(entry->data + entry->secHeader.used);
+  setSecKeyName(key, record.index_key);
+  key->count = 1;
+  key->next_posting = -1;
+  memcpy(key + 1, &record.tupleId, sizeof(int));
+
+  entry->secHeader.used += getSecKeySize(key);
+  entry->secHeader.size++;
+}
 
-  char *data;
+/*
+  Adds 'tupleId' to the key at 'offset' of the pinned 'entry'.
+  The tupleId goes next to the key if the entry has space (the keys after it are shifted), else to the key's first posting block,
+  or to a new posting block chained in front of the others if that is full.
+  dirty: set to 1 if 'entry' was changed, so the calling function must mark it dirty when it unpins it.
+*/
+HT_ErrorCode addSecPosting(int fd, SecEntry *entry, int offset, int tupleId, int *dirty)
+{
+  SecKeyHeader *key = (SecKeyHeader *)(entry->data + offset);
+  if (entry->secHeader.used + sizeof(int) <= SEC_DATA_SIZE(getPageSize(fd)))
+  {
+    int end = offset + getSecKeySize(key);
+    memmove(entry->data + end + sizeof(int), entry->data + end, entry->secHeader.used - end);
+    memcpy(entry->data + end, &tupleId, sizeof(int));
+    key->count++;
+    entry->secHeader.used += sizeof(int);
+    *dirty = 1;
+    return HT_OK;
+  }
 
-  // number of Records in the block
-  int size = entry.secHeader.size;
-  int local_depth = entry.secHeader.local_depth;
+  BF_Block *postingBlock;
+  BF_Block_Init(&postingBlock);
 
-  // check for available space
-  if (size >= SEC_MAX_RECORDS)
+  SecPostingEntry *posting = NULL;
+  *dirty = 0;
+  if (key->next_posting != -1)
   {
-    // check local depth
-    if (local_depth == depth)
+    CALL_OR_DIE(pinSecPostingEntry(fd, postingBlock, key->next_posting, &posting));
+    if (posting->header.size >= SEC_MAX_POSTINGS(getPageSize(fd)))
     {
-      // double HashTable
-      CALL_OR_DIE(doubleSecHashTable(fd, block, &hashEntry));
-      depth++;
-      CALL_OR_DIE(setDepth(fd, block, depth));
+      CALL_OR_DIE(unpinPage(postingBlock, 0));
+      posting = NULL;
     }
-    // spit hashTable's pointers
-    int res = splitSecHashTable(fd, block, depth, blockN, record, entry);
-    if (res == 2)
-      return SHT_SecondaryInsertEntry(indexDesc, record);
-    return HT_OK;
   }
 
-  // space available
-  CALL_OR_DIE(getSecEntry(fd, block, blockN, &entry));
-
-  // insert new record (whithout splitting)
-  entry.secRecord[entry.secHeader.size] = record;
+  if (posting == NULL)
+  {
+    int blockNew;
+    CALL_OR_DIE(pinNewSecPostingEntry(fd, postingBlock, &blockNew, &posting));
+    posting->header.size = 0;
+    posting->header.next_block = key->next_posting;
+    key->next_posting = blockNew;
+    *dirty = 1;
+  }
 
-  (entry.secHeader.size)++;
+  posting->tupleId[posting->header.size++] = tupleId;
+  CALL_OR_DIE(unpinPage(postingBlock, 1));
 
-  CALL_OR_DIE(setSecEntry(fd, block, blockN, &entry));
+  BF_Block_Destroy(&postingBlock);
   return HT_OK;
 }
 
-HT_ErrorCode SHT_SecondaryUpdateEntry(int indexDesc, UpdateRecordArray *updateArray)
+/*
+  Replaces 'oldTupleId' of the key 'key' with 'newTupleId', looking at the tupleIds next to it and at its posting blocks.
+  key: a key of a pinned SecEntry, 'dirty' is set to 1 if the tupleId was next to it (the SecEntry changed).
+  postingBlock: previously initialized BF_Block pointer, that is not pinned (does not get destroyed).
+*/
+HT_ErrorCode replaceSecPosting(int fd, BF_Block *postingBlock, SecKeyHeader *key, int oldTupleId, int newTupleId, int *dirty)
 {
-  if (indexArray[indexDesc].used == 0)
+  // tupleIds stored next to the key
+  int *tupleIds = (int *)(key + 1);
+  for (int i = 0; i < key->count; i++)
   {
-    printf("CLOSED FILE\n");
-    return HT_ERROR;
+    if (tupleIds[i] == oldTupleId)
+    {
+      tupleIds[i] = newTupleId;
+      *dirty = 1;
+      return HT_OK;
+    }
   }
 
-  if (updateArray[0].oldTupleId == -1)
+  // tupleIds of the key's posting blocks, only the block that has the tupleId is marked dirty
+  int block_num = key->next_posting;
+  while (block_num != -1)
   {
-    return HT_OK;
+    SecPostingEntry *posting;
+    CALL_OR_DIE(pinSecPostingEntry(fd, postingBlock, block_num, &posting));
+    for (int i = 0; i < posting->header.size; i++)
+    {
+      if (posting->tupleId[i] == oldTupleId)
+      {
+        posting->tupleId[i] = newTupleId;
+        CALL_OR_DIE(unpinPage(postingBlock, 1));
+        return HT_OK;
+      }
+    }
+    block_num = posting->header.next_block;
+    CALL_OR_DIE(unpinPage(postingBlock, 0));
   }
 
-  // insert code here
-  BF_Block *block;
-  BF_Block_Init(&block);
+  return HT_OK;
+}
+
+/*
+  Replaces 'oldTupleId' of 'index_key' with 'newTupleId', looking at the bucket that starts at 'bucket'.
+  Only the block that has the tupleId is marked dirty.
+*/
+HT_ErrorCode updateSecPosting(int fd, BF_Block *block, int bucket, const char *index_key, int oldTupleId, int newTupleId)
+{
+  BF_Block *postingBlock;
+  BF_Block_Init(&postingBlock);
 
-  for (int i = 0; i < MAX_RECORDS; i++)
+  int block_num = bucket;
+  while (block_num != -1)
   {
+    SecEntry *entry;
+    CALL_OR_DIE(pinSecEntry(fd, block, block_num, &entry));
+    int offset = findSecKey(entry, index_key);
+    int dirty = 0;
+    if (offset != -1)
+      CALL_OR_DIE(replaceSecPosting(fd, postingBlock, (SecKeyHeader *)(entry->data + offset), oldTupleId, newTupleId, &dirty));
+    block_num = offset != -1 ? -1 : entry->secHeader.next_block;
+    CALL_OR_DIE(unpinPage(block, dirty));
+  }
+
+  BF_Block_Destroy(&postingBlock);
+  return HT_OK;
+}
+
+/*
+  Applies the 'n' moves of 'moves', that all go to the bucket moves[0].bucket, reading and writing each block of the bucket once.
+  keyOffset: where the key is in an UpdateRecordArray (SecKeyField).
+  block: previously initialized BF_Block pointer, that is not pinned (does not get destroyed).
+*/
+HT_ErrorCode updateSecBucketPostings(int fd, BF_Block *block, SecBucketUpdate *moves, int n, size_t keyOffset)
+{
+  BF_Block *postingBlock;
+  BF_Block_Init(&postingBlock);
 
-    if (updateArray[i].oldTupleId == updateArray[i].newTupleId)
+  char *done = calloc(n, sizeof(char));
+  int left = n;
+  int block_num = moves[0].bucket;
+  while (block_num != -1 && left > 0)
+  {
+    SecEntry *entry;
+    CALL_OR_DIE(pinSecEntry(fd, block, block_num, &entry));
+    int dirty = 0;
+    for (int u = 0; u < n; u++)
     {
-      continue;
+      if (done[u])
+        continue;
+      int offset = findSecKey(entry, (char *)moves[u].update + keyOffset);
+      if (offset == -1)
+        continue;
+
+      // a key is in one block of the bucket only
+      done[u] = 1;
+      left--;
+      CALL_OR_DIE(replaceSecPosting(fd, postingBlock, (SecKeyHeader *)(entry->data + offset),
+                                    moves[u].update->oldTupleId, moves[u].update->newTupleId, &dirty));
     }
+    block_num = entry->secHeader.next_block;
+    CALL_OR_DIE(unpinPage(block, dirty));
+  }
 
-    int depth;
-    int fd = secIndexArray[indexDesc].fd;
-    CALL_OR_DIE(getDepth(fd, block, &depth));
+  free(done);
+  BF_Block_Destroy(&postingBlock);
+  return HT_OK;
+}
 
-    // get HashTable
-    SecHashEntry hashEntry;
-    CALL_OR_DIE(getSecHashTable(fd, block, 1, &hashEntry));
+int compareSecBucketUpdates(const void *a, const void *b)
+{
+  const SecBucketUpdate *ua = a, *ub = b;
+  if (ua->bucket != ub->bucket)
+    return ua->bucket - ub->bucket;
+  return ua->order - ub->order;
+}
 
-    // get bucket
-    int value = hashAttr(updateArray[i].surname, depth); /// Otan arxisoyme na kanoyme hash me vasi to surname/city prepei na to allaksoyme
+/*
+  Removes 'tupleId' from 'index_key', looking at the bucket that starts at 'bucket'.
+  A tupleId next to the key is removed by shifting the rest, one in a posting block is replaced by the last tupleId of the key's first
+  posting block, which is freed when it empties. A key without tupleIds is removed, and so is an overflow block without keys.
+  block: previously initialized BF_Block pointer, that is not pinned (does not get destroyed).
+*/
+HT_ErrorCode removeSecPosting(int fd, BF_Block *block, int bucket, const char *index_key, int tupleId)
+{
+  SecEntry *entry;
+  int block_num = bucket, prev = -1;
+  int offset = -1;
+  while (block_num != -1)
+  {
+    CALL_OR_DIE(pinSecEntry(fd, block, block_num, &entry));
+    offset = findSecKey(entry, index_key);
+    if (offset != -1)
+      break;
+    prev = block_num;
+    block_num = entry->secHeader.next_block;
+    CALL_OR_DIE(unpinPage(block, 0));
+  }
+  if (offset == -1)
+    return HT_OK;
 
-    if ((strcmp(hashEntry.secHeader.attribute, "cities") == 0) || (strcmp(hashEntry.secHeader.attribute, "city") == 0))
+  // tupleIds stored next to the key
+  SecKeyHeader *key = (SecKeyHeader *)(entry->data + offset);
+  int *tupleIds = (int *)(key + 1);
+  int found = 0;
+  for (int i = 0; i < key->count && !found; i++)
+  {
+    if (tupleIds[i] == tupleId)
     {
-      value = hashAttr(updateArray[i].city, depth);
+      int next = offset + sizeof(SecKeyHeader) + (i + 1) * sizeof(int);
+      memmove(entry->data + next - sizeof(int), entry->data + next, entry->secHeader.used - next);
+      key->count--;
+      entry->secHeader.used -= sizeof(int);
+      found = 1;
     }
+  }
 
-    int blockN = getSecBucket(value, hashEntry);
+  // tupleIds of the key's posting blocks, the first one fills the hole
+  if (!found && key->next_posting != -1)
+  {
+    BF_Block *headBlock;
+    BF_Block_Init(&headBlock);
+    BF_Block *postingBlock;
+    BF_Block_Init(&postingBlock);
 
-    // get bucket's entry
-    SecEntry entry;
-    CALL_OR_DIE(getSecEntry(fd, block, blockN, &entry));
+    int headN = key->next_posting;
+    SecPostingEntry *head;
+    CALL_OR_DIE(pinSecPostingEntry(fd, headBlock, headN, &head));
 
-    for (int j = 0; j < entry.secHeader.size; j++)
+    int posting_num = headN;
+    while (posting_num != -1 && !found)
     {
-      if (entry.secRecord[j].tupleId == updateArray[i].oldTupleId)
+      SecPostingEntry *posting = head;
+      if (posting_num != headN)
+        CALL_OR_DIE(pinSecPostingEntry(fd, postingBlock, posting_num, &posting));
+
+      for (int i = 0; i < posting->header.size; i++)
       {
-        entry.secRecord[j].tupleId = updateArray[i].newTupleId;
+        if (posting->tupleId[i] == tupleId)
+        {
+          head->header.size--;
+          posting->tupleId[i] = head->tupleId[head->header.size];
+          found = 1;
+          break;
+        }
       }
+
+      posting_num = posting->header.next_block;
+      if (posting != head)
+        CALL_OR_DIE(unpinPage(postingBlock, found));
     }
 
-    CALL_OR_DIE(setSecEntry(fd, block, blockN, &entry));
+    if (head->header.size == 0)
+    {
+      key->next_posting = head->header.next_block;
+      CALL_OR_DIE(unpinPage(headBlock, 0));
+      CALL_OR_DIE(freeBlock(fd, headBlock, headN));
+    }
+    else
+      CALL_OR_DIE(unpinPage(headBlock, found));
+
+    BF_Block_Destroy(&postingBlock);
+    BF_Block_Destroy(&headBlock);
+  }
+
+  // a key without tupleIds is removed, the keys after it are shifted
+  if (key->count == 0 && key->next_posting == -1)
+  {
+    int next = offset + sizeof(SecKeyHeader);
+    memmove(entry->data + offset, entry->data + next, entry->secHeader.used - next);
+    entry->secHeader.used -= sizeof(SecKeyHeader);
+    entry->secHeader.size--;
+  }
+
+  // an empty overflow block is taken out of the bucket's chain
+  int next_block = entry->secHeader.next_block;
+  int empty = entry->secHeader.size == 0 && prev != -1;
+  CALL_OR_DIE(unpinPage(block, found));
+  if (empty)
+  {
+    CALL_OR_DIE(pinSecEntry(fd, block, prev, &entry));
+    entry->secHeader.next_block = next_block;
+    CALL_OR_DIE(unpinPage(block, 1));
+    CALL_OR_DIE(freeBlock(fd, block, block_num));
   }
 
-  BF_Block_Destroy(&block);
   return HT_OK;
 }
 
 /*
-  prints SecHashNodes values
+  Returns 1 if the key of 'keyHeader' has 'tupleId', looking at the tupleIds next to it and at its posting blocks.
+  postingBlock: previously initialized BF_Block pointer, that is not pinned (does not get destroyed).
 */
-void SHT_PrintHashNode(SecHashNode node)
+int secKeyHasPosting(int fd, BF_Block *postingBlock, SecKeyHeader *keyHeader, int tupleId)
 {
-  printf("SecHashNode: block_num = %i, h_value=%i\n", node.block_num, node.h_value);
+  int *tupleIds = (int *)(keyHeader + 1);
+  for (int i = 0; i < keyHeader->count; i++)
+    if (tupleIds[i] == tupleId)
+      return 1;
+
+  int next = keyHeader->next_posting;
+  while (next != -1)
+  {
+    SecPostingEntry *posting;
+    if (pinSecPostingEntry(fd, postingBlock, next, &posting) != HT_OK)
+      return 0;
+    int found = 0;
+    for (int i = 0; i < posting->header.size && !found; i++)
+      found = posting->tupleId[i] == tupleId;
+    next = posting->header.next_block;
+    unpinPage(postingBlock, 0);
+    if (found)
+      return 1;
+  }
+
+  return 0;
 }
 
 /*
-  prints the contents of a SecondaryRecord
+  Finds the key of the bucket that starts at 'bucket' that has full hash 'hash' (hashString(key)) and the tupleId 'tupleId',
+  following the bucket's overflow blocks. The key is copied to 'index_key', which is set to "" if there is no such key.
+  block: previously initialized BF_Block pointer, that is not pinned (does not get destroyed).
 */
-void SHT_PrintSecondaryRecord(SecondaryRecord record)
+HT_ErrorCode findSecKeyOfPosting(int fd, BF_Block *block, int bucket, unsigned int hash, int tupleId, char *index_key)
 {
-  printf("index_key: %s, tupleId: %i\n", record.index_key, record.tupleId);
+  BF_Block *postingBlock;
+  BF_Block_Init(&postingBlock);
+
+  index_key[0] = '\0';
+  int block_num = bucket;
+  while (block_num != -1 && index_key[0] == '\0')
+  {
+    SecEntry *entry;
+    CALL_OR_DIE(pinSecEntry(fd, block, block_num, &entry));
+    int offset = 0;
+    for (int i = 0; i < entry->secHeader.size; i++)
+    {
+      SecKeyHeader *key = (SecKeyHeader *)(entry->data + offset);
+      if (hashString(key->index_key) == hash && secKeyHasPosting(fd, postingBlock, key, tupleId))
+      {
+        strcpy(index_key, key->index_key);
+        break;
+      }
+      offset += getSecKeySize(key);
+    }
+    block_num = entry->secHeader.next_block;
+    CALL_OR_DIE(unpinPage(block, 0));
+  }
+
+  BF_Block_Destroy(&postingBlock);
+  return HT_OK;
 }
 
 /*
-  Prints the contents of a SecEntry
+  Returns 1 if splitting the bucket (as many times as needed) can separate 'record' from some of the bucket's keys,
+  that is if some key of the bucket does not have exactly the same hash with the record's key. Returns 0 otherwise,
+  in which case the record must go to the bucket's overflow chain.
 */
-void SHT_PrintSecEntry(SecEntry entry)
+int canSplitSecBucket(int fd, BF_Block *block, int bucket, SecondaryRecord record)
 {
-  printf("local_depth = %i\n", entry.secHeader.local_depth);
-  for (int i = 0; i < entry.secHeader.size; i++)
-    SHT_PrintSecondaryRecord(entry.secRecord[i]);
+  unsigned int hash = hashAttr(record.index_key, 32);
+  int res = 0;
+  int block_num = bucket;
+  while (block_num != -1 && res == 0)
+  {
+    SecEntry *entry;
+    if (pinSecEntry(fd, block, block_num, &entry) != HT_OK)
+      return 0;
+
+    int offset = 0;
+    for (int i = 0; i < entry->secHeader.size && res == 0; i++)
+    {
+      SecKeyHeader *key = (SecKeyHeader *)(entry->data + offset);
+      if (hashAttr(key->index_key, 32) != hash)
+        res = 1;
+      offset += getSecKeySize(key);
+    }
+    block_num = entry->secHeader.next_block;
+    unpinPage(block, 0);
+  }
+
+  return res;
 }
 
 /*
-  Prints SecHashEntry's SecHashNodes.
-  If full is given as 1, it prints the block each SecHashNode points to, also
-  fd: file's fileDesc
-  block: previously initialized BF_Block stracture (must be destroyed by calling function)
+  Reassigns keys from one bucket to two. Used when need to split. !It doesn't split, it reassigns!
+  The two new buckets consist of the old bucket and a new one that has been allocated.
+  keys: all the keys of the bucket we are reassigning from (overflow blocks included), as loaded by getSecBucketKeys.
+  n: number of keys.
+  old: the keys that will remain in the old bucket (allocated by calling function, as many bytes as keys).
+  oldN: number of keys in old.
+  new: the keys that will be in the new bucket (allocated by calling function, as many bytes as keys).
+  newN: number of keys in new.
+  depth: global depth.
+  half: medium of [first, end]. first is the first index of the hash table that points to the old block and end is the last.
 */
-void SHT_PrintSecHashEntry(SecHashEntry hEntry, int full, int fd, BF_Block *block)
+HT_ErrorCode reassignSecKeys(char *keys, int n, int half, int depth, char *old, int *oldN, char *new, int *newN)
 {
-  SecEntry entry;
-
-  for (int i = 0; i < hEntry.secHeader.size; i++)
+  int offset = 0, oldBytes = 0, newBytes = 0;
+  *oldN = *newN = 0;
+  for (int i = 0; i < n; i++)
   {
-    if (full)
-      printf("\n");
-    SHT_PrintHashNode(hEntry.secHashNode[i]);
-    if (full == 1)
+    SecKeyHeader *key = (SecKeyHeader *)(keys + offset);
+    int keySize = getSecKeySize(key);
+    if (hashAttr(key->index_key, depth) <= half)
     {
-      int bn = hEntry.secHashNode[i].block_num;
-      printf("Secondary Entry with block_num = %i\n", bn);
-      CALL_OR_DIE(getSecEntry(fd, block, bn, &entry));
-      SHT_PrintSecEntry(entry);
+      memcpy(old + oldBytes, key, keySize);
+      oldBytes += keySize;
+      (*oldN)++;
+    }
+    else
+    {
+      memcpy(new + newBytes, key, keySize);
+      newBytes += keySize;
+      (*newN)++;
     }
+    offset += keySize;
   }
+
+  return HT_OK;
 }
 
 /*
-  Prints for every SecHashEntry in the Hash Table, it's SecHashNodes.
-  If full is given as 1, it prints the block each SecHashNode points to, also
-  fd: file's fileDesc
-  block: previously initialized BF_Block stracture (must be destroyed by calling function)
+  Doubles the pinned HashTable 'hashEntry' in place, the calling function marks it dirty.
 */
-void SHT_PrintSecHashTable(int fd, BF_Block *block, int full)
+HT_ErrorCode doubleSecHashTable(SecHashEntry *hashEntry)
 {
-  SecHashEntry table;
-  int block_num;
-
-  block_num = 1; // get start of hash table first
-
-  do
+  // double table, from the end so that i >> 1 is still unchanged
+  int size = hashEntry->secHeader.size * 2;
+  for (int i = size - 1; i >= 0; i--)
   {
-    CALL_OR_DIE(getSecHashTable(fd, block, block_num, &table));
-    block_num = table.secHeader.next_hblock;
+    hashEntry->secHashNode[i].block_num = hashEntry->secHashNode[i >> 1].block_num;
+  }
+  hashEntry->secHeader.size = size;
 
-    SHT_PrintSecHashEntry(table, full, fd, block);
-  } while (block_num != -1);
+  return HT_OK;
 }
 
 /*
-  Prints all records in a file.
-  fd: the fileDesc of the file.
-  block: previously initialized BF_Block pointer (does not get destroyed).
-  depth: the global depth.
-  hashEntry: the hash table.
+  Splits a HashTable's bucket, reassigns its keys (overflow blocks included), and stores updated data.
+  Keys move with the tupleIds stored next to them, their posting blocks stay where they are.
+  The record that caused the split is not inserted, the calling function retries the insertion.
+  fd: fileDesc of file we are interested in.
+  block: previously initialized BF_Block pointer, that is not pinned (does not get destroyed).
+  depth: global depth.
+  bucket: the block_num of the bucket we are spliting.
+  record: the record that when added caused the spliting.
+  local_depth: the local depth of the bucket before it splitted.
+  hashEntry: the pinned HashTable, changed in place (the calling function marks it dirty).
 */
-HT_ErrorCode printAllSecRecords(int fd, BF_Block *block, int depth, SecHashEntry hashEntry)
+HT_ErrorCode splitSecHashTable(int fd, BF_Block *block, int depth, int bucket, SecondaryRecord record, int local_depth, SecHashEntry *hashEntry)
 {
-  SHT_PrintSecHashTable(fd, block, 1);
+  // get end points
+  int first, half, end;
+  CALL_OR_DIE(getSecEndPoints(&first, &half, &end, local_depth, depth, hashAttr(record.index_key, depth)));
+
+  // get the keys of the bucket, and the overflow blocks they occupy
+  char *keys;
+  int n, bytes;
+  CALL_OR_DIE(getSecBucketKeys(fd, block, bucket, &keys, &n, &bytes));
+  int *spare;
+  int spareN;
+  CALL_OR_DIE(getSecOverflowBlocks(fd, block, bucket, &spare, &spareN));
 
+  // get a new block
+  int blockNew;
+  CALL_OR_DIE(getNewBlock(fd, block, &blockNew));
+
+  for (int i = half + 1; i <= end; i++)
+    hashEntry->secHashNode[i].block_num = blockNew;
+
+  // re-assing keys
+  char *old = malloc(bytes + 1);
+  char *new = malloc(bytes + 1);
+  int oldN, newN;
+  CALL_OR_DIE(reassignSecKeys(keys, n, half, depth, old, &oldN, new, &newN));
+
+  // store created/modified buckets, overflow blocks are reused
+  CALL_OR_DIE(writeSecChain(fd, block, bucket, local_depth + 1, old, oldN, spare, &spareN));
+  CALL_OR_DIE(writeSecChain(fd, block, blockNew, local_depth + 1, new, newN, spare, &spareN));
+
+  free(keys);
+  free(spare);
+  free(old);
+  free(new);
   return HT_OK;
 }
 
-HT_ErrorCode printSecSepcificRecord(int fd, BF_Block *block, char *id, int depth, SecHashEntry hashEntry)
+/*
+  Merges the bucket 'bucket' with its buddy (the bucket its hash values were split from), while the keys of both fit in one block.
+  Buckets with overflow blocks are not merged. The keys of the buddy move with the tupleIds next to them, their posting blocks stay where they are.
+  block: previously initialized BF_Block pointer, that is not pinned (does not get destroyed).
+  depth: global depth.
+  index_key: a key that hashes to the bucket.
+  hashEntry: the pinned HashTable, changed in place. Sets 'hashDirty' to 1 if it was changed.
+*/
+HT_ErrorCode mergeSecBuckets(int fd, BF_Block *block, int bucket, const char *index_key, int depth, SecHashEntry *hashEntry, int *hashDirty)
 {
-  int value = hashAttr(id, depth);
-  int blockN = getSecBucket(value, hashEntry);
+  BF_Block *buddyBlock;
+  BF_Block_Init(&buddyBlock);
 
-  // check if block was allocated
-  if (blockN == 0)
+  while (1)
   {
-    printf("Block was not allocated\n");
-    return HT_ERROR;
-  }
+    SecEntry *entry;
+    CALL_OR_DIE(pinSecEntry(fd, block, bucket, &entry));
+    int local_depth = entry->secHeader.local_depth;
+    if (local_depth == 0)
+    {
+      CALL_OR_DIE(unpinPage(block, 0));
+      break;
+    }
+
+    // the buddy's hash values differ only at the last bit of the local depth
+    int first, half, end;
+    CALL_OR_DIE(getSecEndPoints(&first, &half, &end, local_depth, depth, hashAttr(index_key, depth)));
+    int numOfHashes = end - first + 1;
+    int buddyFirst = first ^ numOfHashes;
+    int buddy = getSecBucket(buddyFirst, hashEntry);
+
+    SecEntry *other;
+    CALL_OR_DIE(pinSecEntry(fd, buddyBlock, buddy, &other));
+    if (other->secHeader.local_depth != local_depth || entry->secHeader.next_block != -1 || other->secHeader.next_block != -1 ||
+        entry->secHeader.used + other->secHeader.used > SEC_DATA_SIZE(getPageSize(fd)))
+    {
+      CALL_OR_DIE(unpinPage(buddyBlock, 0));
+      CALL_OR_DIE(unpinPage(block, 0));
+      break;
+    }
 
-  // print record with that id
-  SecEntry entry;
-  CALL_OR_DIE(getSecEntry(fd, block, blockN, &entry));
-  for (int i = 0; i < entry.secHeader.size; i++)
-    if (strcmp(entry.secRecord[i].index_key, id) == 0)
-      printSecRecord(entry.secRecord[i]);
+    memcpy(entry->data + entry->secHeader.used, other->data, other->secHeader.used);
+    entry->secHeader.used += other->secHeader.used;
+    entry->secHeader.size += other->secHeader.size;
+    entry->secHeader.local_depth--;
+    CALL_OR_DIE(unpinPage(block, 1));
+    CALL_OR_DIE(unpinPage(buddyBlock, 0));
+    CALL_OR_DIE(freeBlock(fd, buddyBlock, buddy));
+
+    // every hash value of the two buckets points to the one kept
+    int from = first < buddyFirst ? first : buddyFirst;
+    for (int i = from; i < from + 2 * numOfHashes; i++)
+      hashEntry->secHashNode[i].block_num = bucket;
+    *hashDirty = 1;
+  }
 
+  BF_Block_Destroy(&buddyBlock);
   return HT_OK;
 }
 
-HT_ErrorCode SHT_PrintAllEntries(int sindexDesc, char *index_key)
+/*
+  Returns 1 if the pinned HashTable 'hashEntry' can be halved, that is if every hash value 2i points to the same block as 2i+1.
+*/
+int canHalveSecHashTable(SecHashEntry *hashEntry)
 {
-  BF_Block *block;
-  BF_Block_Init(&block);
+  if (hashEntry->secHeader.size < 2)
+    return 0;
 
-  int fd = secIndexArray[sindexDesc].fd;
+  for (int i = 0; i < hashEntry->secHeader.size; i += 2)
+    if (hashEntry->secHashNode[i].block_num != hashEntry->secHashNode[i + 1].block_num)
+      return 0;
+  return 1;
+}
 
-  // get depth
-  int depth;
-  CALL_OR_DIE(getDepth(fd, block, &depth));
+/*
+  Halves the pinned HashTable 'hashEntry' in place, the calling function marks it dirty.
+*/
+HT_ErrorCode halveSecHashTable(SecHashEntry *hashEntry)
+{
+  int size = hashEntry->secHeader.size / 2;
+  for (int i = 0; i < size; i++)
+  {
+    hashEntry->secHashNode[i].block_num = hashEntry->secHashNode[2 * i].block_num;
+  }
+  hashEntry->secHeader.size = size;
 
-  // get HashTable
-  SecHashEntry hashEntry;
-  CALL_OR_DIE(getSecHashTable(fd, block, 1, &hashEntry));
+  return HT_OK;
+}
 
-  HT_ErrorCode htCode;
-  if (index_key == NULL)
-    htCode = printAllSecRecords(fd, block, depth, hashEntry);
-  else
-    htCode = printSecSepcificRecord(fd, block, index_key, depth, hashEntry);
+/*
+  Removes 'tupleId' from 'index_key', then merges its bucket and halves the HashTable while possible.
+  block: previously initialized BF_Block pointer, that is not pinned (does not get destroyed).
+  depth: global depth, updated (in memory and at the disk) if the HashTable is halved.
+  hashEntry: the pinned HashTable, changed in place. Sets 'hashDirty' to 1 if it was changed.
+*/
+HT_ErrorCode deleteSecRecord(int fd, BF_Block *block, int *depth, SecHashEntry *hashEntry, const char *index_key, int tupleId, int *hashDirty)
+{
+  int blockN = getSecBucket(hashAttr(index_key, *depth), hashEntry);
+  CALL_OR_DIE(removeSecPosting(fd, block, blockN, index_key, tupleId));
+  CALL_OR_DIE(mergeSecBuckets(fd, block, blockN, index_key, *depth, hashEntry, hashDirty));
 
-  BF_Block_Destroy(&block);
-  return htCode;
+  if (canHalveSecHashTable(hashEntry))
+  {
+    while (canHalveSecHashTable(hashEntry))
+    {
+      CALL_OR_DIE(halveSecHashTable(hashEntry));
+      (*depth)--;
+    }
+    CALL_OR_DIE(setDepth(fd, block, *depth));
+    *hashDirty = 1;
+  }
+
+  return HT_OK;
 }
 
-HT_ErrorCode SHT_HashStatistics(char *filename)
+HT_ErrorCode SHT_SecondaryInsertEntry(int indexDesc, SecondaryRecord record)
 {
-  // insert code here
+  CALL_OR_DIE(checkSecInsertEntry(indexDesc, record));
+
+  // Initialize blocks, the HashTable stays pinned at its own block
   BF_Block *block;
   BF_Block_Init(&block);
+  BF_Block *hashBlock;
+  BF_Block_Init(&hashBlock);
 
-  int id;
-  SHT_OpenSecondaryIndex(filename, &id);
-  int fd = secIndexArray[id].fd;
-
-  // get number of blocks
-  int nblocks;
-  CALL_BF(BF_GetBlockCounter(fd, &nblocks));
-  printf("File %s has %d blocks.\n", filename, nblocks);
-
-  // // get depth
+  // get depth
   int depth;
+  int fd = secIndexArray[indexDesc].fd;
   CALL_OR_DIE(getDepth(fd, block, &depth));
 
-  // // get hash table
-  SecHashEntry hashEntry;
-  CALL_OR_DIE(getSecHashTable(fd, block, 1, &hashEntry));
-
-  int iter = hashEntry.secHeader.size;
-  int dataN = iter;
-  int min, max, total;
-  max = total = 0;
-  min = -1;
+  // get HashTable
+  SecHashEntry *hashEntry;
+  CALL_OR_DIE(pinSecHashEntry(fd, hashBlock, 1, &hashEntry));
+  int hashDirty = 0;
+  int pageSize = getPageSize(fd);
 
-  int sum = 0;
-  for (int i = 0; i < iter; i++)
+  while (1)
   {
-    sum++;
-    if (sum - 1 < i)
-      sum = i + 1;
-    if (sum == iter)
+    // get bucket
+    unsigned int value = hashAttr(record.index_key, depth);
+    int blockN = getSecBucket(value, hashEntry);
+
+    // look for the key in the bucket's chain, and remember the first block with space for a new key
+    SecEntry *entry;
+    int block_num = blockN, last_num = blockN, free_num = -1;
+    int offset = -1, local_depth = 0;
+    while (1)
+    {
+      CALL_OR_DIE(pinSecEntry(fd, block, block_num, &entry));
+      if (block_num == blockN)
+        local_depth = entry->secHeader.local_depth;
+
+      // the block stays pinned when it has the key
+      offset = findSecKey(entry, record.index_key);
+      if (offset != -1)
+        break;
+
+      if (free_num == -1 && entry->secHeader.used + sizeof(SecKeyHeader) + sizeof(int) <= SEC_DATA_SIZE(pageSize))
+        free_num = block_num;
+      last_num = block_num;
+      int next = entry->secHeader.next_block;
+      CALL_OR_DIE(unpinPage(block, 0));
+
+      if (next == -1)
+        break;
+      block_num = next;
+    }
+
+    // key exists, add the tupleId to its postings
+    if (offset != -1)
+    {
+      int dirty;
+      CALL_OR_DIE(addSecPosting(fd, entry, offset, record.tupleId, &dirty));
+      CALL_OR_DIE(unpinPage(block, dirty));
       break;
-    int blockN = hashEntry.secHashNode[i].block_num;
-    SecEntry entry;
-    CALL_OR_DIE(getSecEntry(fd, block, blockN, &entry));
+    }
 
-    int num = entry.secHeader.size;
-    total += num;
-    if (num > max)
-      max = num;
-    if (num < min || min == -1)
-      min = num;
+    // space available, insert new key (whithout splitting)
+    if (free_num != -1)
+    {
+      CALL_OR_DIE(pinSecEntry(fd, block, free_num, &entry));
+      appendSecKey(entry, record);
+      CALL_OR_DIE(unpinPage(block, 1));
+      break;
+    }
 
-    int dif = depth - entry.secHeader.local_depth;
-    i += pow(2.0, (double)dif) - 1;
-    dataN -= pow(2.0, (double)dif) - 1;
-  }
+    // split only if it can separate keys and the HashTable has room to double, else grow the bucket's chain
+    int canDouble = hashEntry->secHeader.size * 2 <= SEC_MAX_NODES(pageSize);
+    if ((local_depth == depth && !canDouble) || !canSplitSecBucket(fd, block, blockN, record))
+    {
+      // a new overflow block with the key, chained after the last one
+      int blockNew;
+      CALL_OR_DIE(pinNewSecEntry(fd, block, &blockNew, &entry));
+      entry->secHeader.local_depth = local_depth;
+      entry->secHeader.size = 0;
+      entry->secHeader.used = 0;
+      entry->secHeader.next_block = -1;
+      appendSecKey(entry, record);
+      CALL_OR_DIE(unpinPage(block, 1));
+
+      CALL_OR_DIE(pinSecEntry(fd, block, last_num, &entry));
+      entry->secHeader.next_block = blockNew;
+      CALL_OR_DIE(unpinPage(block, 1));
+      break;
+    }
 
-  printf("Max number of records in bucket is %i\n", max);
-  printf("Min number of records in bucket is %i\n", min);
-  printf("Mean number of records in bucket is %f\n", (double)total / (double)dataN);
+    // check local depth
+    if (local_depth == depth)
+    {
+      // double HashTable
+      CALL_OR_DIE(doubleSecHashTable(hashEntry));
+      depth++;
+      CALL_OR_DIE(setDepth(fd, block, depth));
+    }
+    // spit hashTable's pointers, then retry
+    CALL_OR_DIE(splitSecHashTable(fd, block, depth, blockN, record, local_depth, hashEntry));
+    hashDirty = 1;
+  }
 
+  CALL_OR_DIE(unpinPage(hashBlock, hashDirty));
+  BF_Block_Destroy(&hashBlock);
   BF_Block_Destroy(&block);
-  SHT_CloseSecondaryIndex(id);
-
   return HT_OK;
 }
 
-HT_ErrorCode SHT_InnerJoin(int sindexDesc1, int sindexDesc2, char *index_key)
+HT_ErrorCode SHT_SecondaryUpdateEntry(int indexDesc, UpdateRecordArray *updateArray)
 {
+  if (secIndexArray[indexDesc].used == 0)
+  {
+    printf("CLOSED FILE\n");
+    return HT_ERROR;
+  }
 
-  // initialize blocks
-  BF_Block *block1;
-  BF_Block_Init(&block1);
-
-  BF_Block *block2;
-  BF_Block_Init(&block2);
+  if (updateArray[0].oldTupleId == -1)
+  {
+    return HT_OK;
+  }
 
-  // get secondary indexes
-  int fd1 = secIndexArray[sindexDesc1].fd;
-  int depth1;
-  CALL_OR_DIE(getDepth(fd1, block1, &depth1));
-  SecHashEntry hashEntry1;
-  CALL_OR_DIE(getSecHashTable(fd1, block1, 1, &hashEntry1));
+  BF_Block *block;
+  BF_Block_Init(&block);
+  BF_Block *hashBlock;
+  BF_Block_Init(&hashBlock);
 
-  int fd2 = secIndexArray[sindexDesc2].fd;
-  int depth2;
-  CALL_OR_DIE(getDepth(fd2, block2, &depth2));
-  SecHashEntry hashEntry2;
-  CALL_OR_DIE(getSecHashTable(fd2, block2, 1, &hashEntry2));
+  int depth;
+  int fd = secIndexArray[indexDesc].fd;
+  CALL_OR_DIE(getDepth(fd, block, &depth));
 
-  // get corresponding primary indexes
-  int pid1;
-  HT_OpenIndex(secIndexArray[sindexDesc1].primary_name, &pid1);
-  int pid2;
-  HT_OpenIndex(secIndexArray[sindexDesc2].primary_name, &pid2);
-  int pfd1 = indexArray[pid1].fd;
-  int pfd2 = indexArray[pid2].fd;
+  // get HashTable, and the field of the records it is built on
+  SecHashEntry *hashEntry;
+  CALL_OR_DIE(pinSecHashEntry(fd, hashBlock, 1, &hashEntry));
+  int hashDirty = 0;
+  const SecKeyField *field = getSecKeyField(hashEntry->secHeader.attribute);
+  if (field == NULL)
+  {
+    CALL_OR_DIE(unpinPage(hashBlock, 0));
+    BF_Block_Destroy(&hashBlock);
+    BF_Block_Destroy(&block);
+    return HT_ERROR;
+  }
+
+  // the updates end at the first "no update" (or at MAX_UPDATES)
+  int updatesN = 0;
+  while (updatesN < (int)MAX_UPDATES && !(updateArray[updatesN].oldTupleId == -1 && updateArray[updatesN].newTupleId == -1))
+    updatesN++;
+  SecBucketUpdate *moves = malloc((updatesN + 1) * sizeof(SecBucketUpdate));
 
-  BF_Block *block3;
-  BF_Block_Init(&block3);
+  int i = 0;
+  while (i < updatesN)
+  {
+    // the record was deleted from the primary index, buckets may merge so it is applied on its own
+    if (updateArray[i].newTupleId == -1 && updateArray[i].oldTupleId != -1)
+    {
+      char *index_key = (char *)&updateArray[i] + field->updateOffset;
+      CALL_OR_DIE(deleteSecRecord(fd, block, &depth, hashEntry, index_key, updateArray[i].oldTupleId, &hashDirty));
+      i++;
+      continue;
+    }
 
-  BF_Block *block4;
-  BF_Block_Init(&block4);
+    // hash the keys of the moves up to the next delete once, and group them by bucket
+    int n = 0;
+    for (; i < updatesN && !(updateArray[i].newTupleId == -1 && updateArray[i].oldTupleId != -1); i++)
+    {
+      if (updateArray[i].oldTupleId == updateArray[i].newTupleId)
+        continue;
+      char *index_key = (char *)&updateArray[i] + field->updateOffset;
+      moves[n].bucket = getSecBucket(hashAttr(index_key, depth), hashEntry);
+      moves[n].order = i;
+      moves[n].update = &updateArray[i];
+      n++;
+    }
+    qsort(moves, n, sizeof(SecBucketUpdate), compareSecBucketUpdates);
 
-  // if key is NULL print all records of join
-  if (index_key == NULL)
+    // every affected bucket is read and written once
+    for (int from = 0, to; from < n; from = to)
+    {
+      for (to = from + 1; to < n && moves[to].bucket == moves[from].bucket; to++)
+        ;
+      CALL_OR_DIE(updateSecBucketPostings(fd, block, moves + from, to - from, field->updateOffset));
+    }
+  }
+  free(moves);
+
+  CALL_OR_DIE(unpinPage(hashBlock, hashDirty));
+  BF_Block_Destroy(&hashBlock);
+  BF_Block_Destroy(&block);
+  return HT_OK;
+}
+
+HT_ErrorCode SHT_SecondaryDeleteEntry(int indexDesc, SecondaryRecord record)
+{
+  if (secIndexArray[indexDesc].used == 0)
+  {
+    printf("Trying to delete from a closed file!\n");
+    return HT_ERROR;
+  }
+
+  BF_Block *block;
+  BF_Block_Init(&block);
+  BF_Block *hashBlock;
+  BF_Block_Init(&hashBlock);
+
+  int depth;
+  int fd = secIndexArray[indexDesc].fd;
+  CALL_OR_DIE(getDepth(fd, block, &depth));
+
+  // get HashTable
+  SecHashEntry *hashEntry;
+  CALL_OR_DIE(pinSecHashEntry(fd, hashBlock, 1, &hashEntry));
+  int hashDirty = 0;
+
+  CALL_OR_DIE(deleteSecRecord(fd, block, &depth, hashEntry, record.index_key, record.tupleId, &hashDirty));
+
+  CALL_OR_DIE(unpinPage(hashBlock, hashDirty));
+  BF_Block_Destroy(&hashBlock);
+  BF_Block_Destroy(&block);
+  return HT_OK;
+}
+
+HT_ErrorCode SHT_SecondaryApplyDeltas(int indexDesc, TupleDelta *deltas, int n)
+{
+  if (n == 0)
+    return HT_OK;
+  if (secIndexArray[indexDesc].used == 0)
+  {
+    printf("Trying to update a closed file!\n");
+    return HT_ERROR;
+  }
+
+  BF_Block *block;
+  BF_Block_Init(&block);
+  BF_Block *hashBlock;
+  BF_Block_Init(&hashBlock);
+
+  int depth;
+  int fd = secIndexArray[indexDesc].fd;
+  CALL_OR_DIE(getDepth(fd, block, &depth));
+
+  // get HashTable
+  SecHashEntry *hashEntry;
+  CALL_OR_DIE(pinSecHashEntry(fd, hashBlock, 1, &hashEntry));
+  int hashDirty = 0;
+  const SecKeyField *field = getSecKeyField(hashEntry->secHeader.attribute);
+  if (field == NULL)
   {
-    for (int i = 0; i < hashEntry1.secHeader.size; i++)
+    CALL_OR_DIE(unpinPage(hashBlock, 0));
+    BF_Block_Destroy(&hashBlock);
+    BF_Block_Destroy(&block);
+    return HT_ERROR;
+  }
+
+  for (int i = 0; i < n; i++)
+  {
+    if (deltas[i].oldTupleId == deltas[i].newTupleId)
+      continue;
+
+    // the bucket comes from the key's hash, the key itself from the tupleId it has
+    unsigned int hash = *(unsigned int *)((char *)&deltas[i] + field->deltaOffset);
+    int blockN = getSecBucket(depth == 0 ? 0 : hash >> (32 - depth), hashEntry);
+    char index_key[20];
+    CALL_OR_DIE(findSecKeyOfPosting(fd, block, blockN, hash, deltas[i].oldTupleId, index_key));
+    if (index_key[0] == '\0')
+      continue;
+
+    // the record was deleted from the primary index
+    if (deltas[i].newTupleId == -1)
     {
-      int blockN1 = hashEntry1.secHashNode[i].block_num;
-      SecEntry entry1;
-      CALL_OR_DIE(getSecEntry(fd1, block1, blockN1, &entry1));
+      CALL_OR_DIE(deleteSecRecord(fd, block, &depth, hashEntry, index_key, deltas[i].oldTupleId, &hashDirty));
+      continue;
+    }
+    CALL_OR_DIE(updateSecPosting(fd, block, blockN, index_key, deltas[i].oldTupleId, deltas[i].newTupleId));
+  }
 
-      for (int j = 0; j < entry1.secHeader.size; j++)
-      {
-        for (int z = 0; z < hashEntry2.secHeader.size; z++)
-        {
-          int blockN2 = hashEntry2.secHashNode[z].block_num;
-          SecEntry entry2;
-          CALL_OR_DIE(getSecEntry(fd2, block2, blockN2, &entry2));
+  CALL_OR_DIE(unpinPage(hashBlock, hashDirty));
+  BF_Block_Destroy(&hashBlock);
+  BF_Block_Destroy(&block);
+  return HT_OK;
+}
 
-          for (int w = 0; w < entry2.secHeader.size; w++)
-          {
-            if (strcmp(entry1.secRecord[j].index_key, entry2.secRecord[w].index_key) == 0)
-            {
-              int block_num1 = getBlockNumFromTID(entry1.secRecord[j].tupleId);
-              int index_in_block1 = getIndexFromTID(entry1.secRecord[j].tupleId);
-              int block_num2 = getBlockNumFromTID(entry2.secRecord[w].tupleId);
-              int index_in_block2 = getIndexFromTID(entry2.secRecord[w].tupleId);
-
-              Entry pentry1;
-              Entry pentry2;
-              CALL_OR_DIE(getEntry(pfd1, block3, block_num1, &pentry1));
-              CALL_OR_DIE(getEntry(pfd2, block4, block_num2, &pentry2));
-
-              if (strcmp(hashEntry1.secHeader.attribute, "surnames") == 0)
-              {
-                printf("%s, %d, %s, %s, ", entry1.secRecord[j].index_key, entry1.secRecord[j].tupleId, pentry1.record[index_in_block1].name, pentry1.record[index_in_block1].city);
-                printf("%d, %s, %s\n", entry2.secRecord[w].tupleId, pentry2.record[index_in_block2].name, pentry2.record[index_in_block2].city);
-              }
-              else
-              {
-                printf("%s, %d, %s, %s, ", entry1.secRecord[j].index_key, entry1.secRecord[j].tupleId, pentry1.record[index_in_block1].name, pentry1.record[index_in_block1].surname);
-                printf("%d, %s, %s\n", entry2.secRecord[w].tupleId, pentry2.record[index_in_block2].name, pentry2.record[index_in_block2].surname);
-              }
-            }
-          }
-          // skip hash values that point to the same block
-          int dif2 = depth2 - entry2.secHeader.local_depth;
-          z += pow(2.0, (double)dif2) - 1;
-        }
-      }
-      // skip hash values that point to the same block
-      int dif1 = depth1 - entry1.secHeader.local_depth;
-      i += pow(2.0, (double)dif1) - 1;
+HT_ErrorCode SHT_Lookup(int sindexDesc, char *index_key, SHT_LookupCallback callback, void *arg)
+{
+  if (secIndexArray[sindexDesc].used == 0)
+  {
+    printf("Can't look up a closed file!\n");
+    return HT_ERROR;
+  }
+  if (index_key == NULL || callback == NULL)
+  {
+    printf("Wrong lookup input!\n");
+    return HT_ERROR;
+  }
+
+  BF_Block *block;
+  BF_Block_Init(&block);
+
+  int depth;
+  int fd = secIndexArray[sindexDesc].fd;
+  CALL_OR_DIE(getDepth(fd, block, &depth));
+
+  // get bucket
+  SecHashEntry *hashEntry;
+  CALL_OR_DIE(pinSecHashEntry(fd, block, 1, &hashEntry));
+  int block_num = getSecBucket(hashAttr(index_key, depth), hashEntry);
+  CALL_OR_DIE(unpinPage(block, 0));
+
+  // a key is stored once in its bucket, so stop at the first block that has it
+  while (block_num != -1)
+  {
+    SecEntry *entry;
+    CALL_OR_DIE(pinSecEntry(fd, block, block_num, &entry));
+    int offset = findSecKey(entry, index_key);
+    if (offset != -1)
+      CALL_OR_DIE(visitSecKeyPostings(fd, (SecKeyHeader *)(entry->data + offset), callback, arg));
+
+    block_num = offset != -1 ? -1 : entry->secHeader.next_block;
+    CALL_OR_DIE(unpinPage(block, 0));
+  }
+
+  BF_Block_Destroy(&block);
+  return HT_OK;
+}
+
+// a SecondaryRecord of a bulk load, with the full hash of its key
+typedef struct
+{
+  unsigned int hash;
+  SecondaryRecord record;
+} SecBulkRecord;
+
+// a key of a bulk load: the sorted records [from, to) have it, 'size' is the space it takes in a SecEntry
+typedef struct
+{
+  unsigned int hash;
+  int from;
+  int to;
+  int size;
+} SecBulkKey;
+
+// a bucket of a bulk load: the keys [from, to), that share the first 'local_depth' bits of their hash
+typedef struct
+{
+  int from;
+  int to;
+  unsigned int prefix;
+  int local_depth;
+} SecBulkBucket;
+
+int compareSecBulkRecords(const void *a, const void *b)
+{
+  const SecBulkRecord *ra = a;
+  const SecBulkRecord *rb = b;
+  if (ra->hash != rb->hash)
+    return ra->hash < rb->hash ? -1 : 1;
+  int cmp = strcmp(ra->record.index_key, rb->record.index_key);
+  if (cmp != 0)
+    return cmp;
+  return ra->record.tupleId - rb->record.tupleId;
+}
+
+/*
+  Plans the buckets of a bulk load for the keys [from..to) (sorted by hash), that all start with the 'local_depth' bits of 'prefix'.
+  The keys become one bucket if they fit in a block and 'local_depth' is at least the requested 'depth'. If they don't fit
+  but splitting can not separate them (same hash, or 'maxDepth' reached), the bucket gets overflow blocks as in SHT_SecondaryInsertEntry.
+  buckets: grows (realloc) when 'capacity' is reached, 'bucketsN' is its number of buckets.
+*/
+void planSecBulkBuckets(SecBulkKey *keys, int from, int to, unsigned int prefix, int local_depth, int depth, int maxDepth, int dataSize, SecBulkBucket **buckets, int *bucketsN, int *capacity)
+{
+  int bytes = 0;
+  for (int k = from; k < to; k++)
+    bytes += keys[k].size;
+
+  int sameHash = to - from > 0 && keys[from].hash == keys[to - 1].hash;
+  if (local_depth >= depth && (bytes <= dataSize || local_depth == maxDepth || sameHash))
+  {
+    if (*bucketsN == *capacity)
+    {
+      *capacity *= 2;
+      *buckets = realloc(*buckets, *capacity * sizeof(SecBulkBucket));
     }
+    SecBulkBucket *bucket = &(*buckets)[(*bucketsN)++];
+    bucket->from = from;
+    bucket->to = to;
+    bucket->prefix = prefix;
+    bucket->local_depth = local_depth;
+    return;
   }
-  else
+
+  // the keys with the next bit 0 come first
+  unsigned int bit = 1u << (31 - local_depth);
+  int mid = from;
+  while (mid < to && (keys[mid].hash & bit) == 0)
+    mid++;
+
+  planSecBulkBuckets(keys, from, mid, prefix << 1, local_depth + 1, depth, maxDepth, dataSize, buckets, bucketsN, capacity);
+  planSecBulkBuckets(keys, mid, to, (prefix << 1) | 1, local_depth + 1, depth, maxDepth, dataSize, buckets, bucketsN, capacity);
+}
+
+/*
+  Writes the postings of 'key' that do not fit next to it (records [from + inline, to)) at new posting blocks,
+  and stores the first one at 'next_posting' (-1 if there are none).
+*/
+HT_ErrorCode writeSecBulkPostings(int fd, BF_Block *block, SecBulkRecord *records, int from, int to, int *next_posting)
+{
+  SecPostingEntry *posting;
+  int postingsN = SEC_MAX_POSTINGS(getPageSize(fd));
+  *next_posting = -1;
+  for (int i = from; i < to; i += postingsN)
   {
-    int hash_val1 = hashAttr(index_key, depth1);
-    int hash_val2 = hashAttr(index_key, depth2);
-    int bn1 = hashEntry1.secHashNode[hash_val1].block_num;
-    int bn2 = hashEntry2.secHashNode[hash_val2].block_num;
+    int blockNew;
+    CALL_OR_DIE(pinNewSecPostingEntry(fd, block, &blockNew, &posting));
+    posting->header.size = 0;
+    posting->header.next_block = *next_posting;
+    for (int j = i; j < to && j < i + postingsN; j++)
+      posting->tupleId[posting->header.size++] = records[j].record.tupleId;
+    CALL_OR_DIE(unpinPage(block, 1));
+    *next_posting = blockNew;
+  }
+
+  return HT_OK;
+}
+
+/*
+  Creates the secondary index 'sfileName' of the primary 'fileName', with the 'n' SecondaryRecords of 'input'.
+  Every block is written once: the keys are grouped and the buckets (and the global depth) are picked before writing.
+*/
+HT_ErrorCode bulkCreateSecIndex(const char *sfileName, char *attrName, int depth, char *fileName, SecondaryRecord *input, int n)
+{
+  int maxDepth = 0;
+  while ((2 << maxDepth) <= SEC_MAX_NODES(htPageSize))
+    maxDepth++;
+  if (depth > maxDepth)
+  {
+    printf("Depth input is wrong! The secondary HashTable fits up to depth %i!\n", maxDepth);
+    return HT_ERROR;
+  }
+
+  // order the records by key hash, so that the records of a key and the keys of a bucket are next to each other
+  SecBulkRecord *records = malloc((n + 1) * sizeof(SecBulkRecord));
+  for (int i = 0; i < n; i++)
+  {
+    records[i].record = input[i];
+    records[i].hash = hashAttr(input[i].index_key, 32);
+  }
+  qsort(records, n, sizeof(SecBulkRecord), compareSecBulkRecords);
+
+  int maxInline = (SEC_DATA_SIZE(htPageSize) - sizeof(SecKeyHeader)) / sizeof(int);
+  SecBulkKey *keys = malloc((n + 1) * sizeof(SecBulkKey));
+  int keysN = 0;
+  for (int i = 0; i < n; i++)
+  {
+    if (keysN == 0 || strcmp(records[i].record.index_key, records[keys[keysN - 1].from].record.index_key) != 0)
+    {
+      keys[keysN].hash = records[i].hash;
+      keys[keysN].from = i;
+      keysN++;
+    }
+    keys[keysN - 1].to = i + 1;
+  }
+  for (int k = 0; k < keysN; k++)
+  {
+    int count = keys[k].to - keys[k].from;
+    keys[k].size = sizeof(SecKeyHeader) + (count < maxInline ? count : maxInline) * sizeof(int);
+  }
+
+  int capacity = 16, bucketsN = 0;
+  SecBulkBucket *buckets = malloc(capacity * sizeof(SecBulkBucket));
+  planSecBulkBuckets(keys, 0, keysN, 0, 0, depth, maxDepth, SEC_DATA_SIZE(htPageSize), &buckets, &bucketsN, &capacity);
+
+  int finalDepth = depth;
+  for (int b = 0; b < bucketsN; b++)
+    if (buckets[b].local_depth > finalDepth)
+      finalDepth = buckets[b].local_depth;
 
-    SecEntry entry1;
-    CALL_OR_DIE(getSecEntry(fd1, block1, bn1, &entry1));
+  CALL_BF(BF_CreateFile(sfileName));
 
-    SecEntry entry2;
-    CALL_OR_DIE(getSecEntry(fd2, block2, bn2, &entry2));
+  BF_Block *block;
+  BF_Block_Init(&block);
 
-    for (int i = 0; i < entry1.secHeader.size; i++)
+  int id;
+  CALL_OR_DIE(SHT_OpenSecondaryIndex(sfileName, &id));
+  int sfd = secIndexArray[id].fd;
+  setSecPrimaryName(secIndexArray[id].primary_name, fileName);
+
+  // info block and the HashTable's block, that stays pinned while the buckets are written
+  CALL_OR_DIE(createSecInfoBlock(sfd, block, finalDepth, fileName));
+  BF_Block *hashBlock;
+  BF_Block_Init(&hashBlock);
+  CALL_BF(BF_AllocateBlock(sfd, hashBlock));
+  SecHashEntry *hashEntry = (SecHashEntry *)BF_Block_GetData(hashBlock);
+  hashEntry->secHeader.size = 1 << finalDepth;
+  hashEntry->secHeader.next_hblock = -1;
+  strcpy(hashEntry->secHeader.attribute, attrName);
+
+  // write every bucket once, after the posting blocks of its keys
+  char *data = malloc(SEC_DATA_SIZE(htPageSize));
+  int dataCapacity = SEC_DATA_SIZE(htPageSize);
+  for (int b = 0; b < bucketsN; b++)
+  {
+    int bytes = 0;
+    for (int k = buckets[b].from; k < buckets[b].to; k++)
     {
-      for (int j = 0; j < entry2.secHeader.size; j++)
+      if (bytes + keys[k].size > dataCapacity)
       {
-        if ((strcmp(entry1.secRecord[i].index_key, index_key) == 0) && (strcmp(index_key, entry2.secRecord[j].index_key) == 0))
-        {
-          int block_num1 = getBlockNumFromTID(entry1.secRecord[i].tupleId);
-          int index_in_block1 = getIndexFromTID(entry1.secRecord[i].tupleId);
-          int block_num2 = getBlockNumFromTID(entry2.secRecord[j].tupleId);
-          int index_in_block2 = getIndexFromTID(entry2.secRecord[j].tupleId);
-
-          Entry pentry1;
-          Entry pentry2;
-          CALL_OR_DIE(getEntry(pfd1, block3, block_num1, &pentry1));
-          CALL_OR_DIE(getEntry(pfd2, block4, block_num2, &pentry2));
-
-          // check record types of secondary directories in order to adjust prints
-          if (strcmp(hashEntry1.secHeader.attribute, "surnames") == 0)
-          {
-            printf("%s, %d, %s, %s, ", entry1.secRecord[i].index_key, entry1.secRecord[i].tupleId, pentry1.record[index_in_block1].name, pentry1.record[index_in_block1].city);
-            printf("%d, %s, %s\n", entry2.secRecord[j].tupleId, pentry2.record[index_in_block2].name, pentry2.record[index_in_block2].city);
-          }
-          else
-          {
-            printf("%s, %d, %s, %s, ", entry1.secRecord[i].index_key, entry1.secRecord[i].tupleId, pentry1.record[index_in_block1].name, pentry1.record[index_in_block1].surname);
-            printf("%d, %s, %s\n", entry2.secRecord[j].tupleId, pentry2.record[index_in_block2].name, pentry2.record[index_in_block2].surname);
-          }
-        }
+        dataCapacity *= 2;
+        data = realloc(data, dataCapacity);
       }
+
+      int count = keys[k].to - keys[k].from;
+      if (count > maxInline)
+        count = maxInline;
+
+      SecKeyHeader *key = (SecKeyHeader *)(data + bytes);
+      setSecKeyName(key, records[keys[k].from].record.index_key);
+      key->count = count;
+      CALL_OR_DIE(writeSecBulkPostings(sfd, block, records, keys[k].from + count, keys[k].to, &key->next_posting));
+
+      int *tupleIds = (int *)(key + 1);
+      for (int i = 0; i < count; i++)
+        tupleIds[i] = records[keys[k].from + i].record.tupleId;
+      bytes += keys[k].size;
     }
+
+    int bucket, spareN = 0;
+    CALL_OR_DIE(getNewBlock(sfd, block, &bucket));
+    CALL_OR_DIE(writeSecChain(sfd, block, bucket, buckets[b].local_depth, data, buckets[b].to - buckets[b].from, NULL, &spareN));
+
+    int dif = finalDepth - buckets[b].local_depth;
+    int first = buckets[b].prefix << dif;
+    for (int i = first; i < first + (1 << dif); i++)
+      hashEntry->secHashNode[i].block_num = bucket;
   }
+
+  // Store HashTable
+  CALL_OR_DIE(unpinPage(hashBlock, 1));
+  BF_Block_Destroy(&hashBlock);
+
+  free(data);
+  free(records);
+  free(keys);
+  free(buckets);
+  BF_Block_Destroy(&block);
+  SHT_CloseSecondaryIndex(id);
   return HT_OK;
 }
+
+HT_ErrorCode SHT_BulkCreateIndexes(const char *fileName, int depth, Record *records, int n, const char *sfileName, char *attrName, int attrLength, int sdepth)
+{
+  CALL_OR_DIE(checkShtCreate(sfileName, attrName, attrLength, sdepth, (char *)fileName));
+
+  // the primary gives the tupleIds of the records, the secondary is built from them without reading the primary back
+  tid *tupleIds = malloc((n + 1) * sizeof(tid));
+  if (HT_BulkCreateIndex(fileName, depth, records, n, tupleIds) != HT_OK)
+  {
+    free(tupleIds);
+    return HT_ERROR;
+  }
+
+  int byCity = (strcmp(attrName, "cities") == 0) || (strcmp(attrName, "city") == 0);
+  SecondaryRecord *secRecords = malloc((n + 1) * sizeof(SecondaryRecord));
+  for (int i = 0; i < n; i++)
+  {
+    strcpy(secRecords[i].index_key, byCity ? records[i].city : records[i].surname);
+    secRecords[i].tupleId = tupleIds[i];
+  }
+
+  HT_ErrorCode code = bulkCreateSecIndex(sfileName, attrName, sdepth, (char *)fileName, secRecords, n);
+
+  free(tupleIds);
+  free(secRecords);
+  return code;
+}
+
+/*
+  prints SecHashNodes values
+*/
+void SHT_PrintHashNode(int h_value, SecHashNode node)
+{
+  printf("SecHashNode: block_num = %i, h_value=%i\n", node.block_num, h_value);
+}
+
+/*
+  prints the contents of a SecondaryRecord
+*/
+void SHT_PrintSecondaryRecord(SecondaryRecord record)
+{
+  printf("index_key: %s, tupleId: %i\n", record.index_key, record.tupleId);
+}
+
+/*
+  Prints a SecondaryRecord for every tupleId of the keys of a SecEntry, the ones in the key's posting blocks included.
+*/
+void SHT_PrintSecKeys(int fd, SecEntry *entry)
+{
+  int capacity = SEC_MAX_POSTINGS(getPageSize(fd));
+  SecondaryRecord *records = malloc(capacity * sizeof(SecondaryRecord));
+  int n = 0;
+
+  int offset = 0;
+  for (int i = 0; i < entry->secHeader.size; i++)
+  {
+    SecKeyHeader *key = (SecKeyHeader *)(entry->data + offset);
+    CALL_OR_DIE(loadSecKeyRecords(fd, key, &records, &n, &capacity));
+    offset += getSecKeySize(key);
+  }
+
+  for (int i = 0; i < n; i++)
+    SHT_PrintSecondaryRecord(records[i]);
+  free(records);
+}
+
+/*
+  Prints the contents of a SecEntry
+*/
+void SHT_PrintSecEntry(int fd, SecEntry *entry)
+{
+  printf("local_depth = %i\n", entry->secHeader.local_depth);
+  SHT_PrintSecKeys(fd, entry);
+}
+
+/*
+  Prints SecHashEntry's SecHashNodes.
+  If full is given as 1, it prints the block each SecHashNode points to, also
+  fd: file's fileDesc
+  block: previously initialized BF_Block stracture (must be destroyed by calling function)
+*/
+void SHT_PrintSecHashEntry(SecHashEntry *hEntry, int full, int fd, BF_Block *block)
+{
+  SecEntry *entry;
+
+  if (full == 1)
+    prefetchSecBuckets(fd, hEntry);
+  for (int i = 0; i < hEntry->secHeader.size; i++)
+  {
+    if (full)
+      printf("\n");
+    SHT_PrintHashNode(i, hEntry->secHashNode[i]);
+    if (full == 1)
+    {
+      int bn = hEntry->secHashNode[i].block_num;
+      printf("Secondary Entry with block_num = %i\n", bn);
+      CALL_OR_DIE(pinSecEntry(fd, block, bn, &entry));
+      SHT_PrintSecEntry(fd, entry);
+
+      // overflow blocks of the bucket
+      while (entry->secHeader.next_block != -1)
+      {
+        bn = entry->secHeader.next_block;
+        CALL_OR_DIE(unpinPage(block, 0));
+        printf("Overflow Entry with block_num = %i\n", bn);
+        CALL_OR_DIE(pinSecEntry(fd, block, bn, &entry));
+        SHT_PrintSecKeys(fd, entry);
+      }
+      CALL_OR_DIE(unpinPage(block, 0));
+    }
+  }
+}
+
+/*
+  Prints for every SecHashEntry in the Hash Table, it's SecHashNodes.
+  If full is given as 1, it prints the block each SecHashNode points to, also
+  fd: file's fileDesc
+  block: previously initialized BF_Block stracture (must be destroyed by calling function)
+*/
+void SHT_PrintSecHashTable(int fd, BF_Block *block, int full)
+{
+  SecHashEntry *table;
+  int block_num;
+
+  // the HashTable stays pinned at its own block, while 'block' is used for its buckets
+  BF_Block *hashBlock;
+  BF_Block_Init(&hashBlock);
+
+  block_num = 1; // get start of hash table first
+
+  do
+  {
+    CALL_OR_DIE(pinSecHashEntry(fd, hashBlock, block_num, &table));
+    block_num = table->secHeader.next_hblock;
+
+    SHT_PrintSecHashEntry(table, full, fd, block);
+    CALL_OR_DIE(unpinPage(hashBlock, 0));
+  } while (block_num != -1);
+
+  BF_Block_Destroy(&hashBlock);
+}
+
+/*
+  Prints all records in a file.
+  fd: the fileDesc of the file.
+  block: previously initialized BF_Block pointer (does not get destroyed).
+  depth: the global depth.
+  hashEntry: the hash table.
+*/
+HT_ErrorCode printAllSecRecords(int fd, BF_Block *block, int depth, SecHashEntry *hashEntry)
+{
+  SHT_PrintSecHashTable(fd, block, 1);
+
+  return HT_OK;
+}
+
+HT_ErrorCode printSecSepcificRecord(int fd, BF_Block *block, char *id, int depth, SecHashEntry *hashEntry)
+{
+  int value = hashAttr(id, depth);
+  int blockN = getSecBucket(value, hashEntry);
+
+  // check if block was allocated
+  if (blockN == 0)
+  {
+    printf("Block was not allocated\n");
+    return HT_ERROR;
+  }
+
+  // print records with that id
+  SecondaryRecord *records;
+  int n;
+  CALL_OR_DIE(getSecKeyRecords(fd, block, blockN, id, &records, &n));
+  for (int i = 0; i < n; i++)
+    printSecRecord(records[i]);
+
+  free(records);
+  return HT_OK;
+}
+
+HT_ErrorCode SHT_PrintAllEntries(int sindexDesc, char *index_key)
+{
+  BF_Block *block;
+  BF_Block_Init(&block);
+
+  int fd = secIndexArray[sindexDesc].fd;
+
+  // get depth
+  int depth;
+  CALL_OR_DIE(getDepth(fd, block, &depth));
+
+  // get HashTable, printAllSecRecords pins it itself
+  HT_ErrorCode htCode;
+  if (index_key == NULL)
+    htCode = printAllSecRecords(fd, block, depth, NULL);
+  else
+  {
+    BF_Block *hashBlock;
+    BF_Block_Init(&hashBlock);
+    SecHashEntry *hashEntry;
+    CALL_OR_DIE(pinSecHashEntry(fd, hashBlock, 1, &hashEntry));
+    htCode = printSecSepcificRecord(fd, block, index_key, depth, hashEntry);
+    CALL_OR_DIE(unpinPage(hashBlock, 0));
+    BF_Block_Destroy(&hashBlock);
+  }
+
+  BF_Block_Destroy(&block);
+  return htCode;
+}
+
+HT_ErrorCode SHT_HashStatistics(char *filename)
+{
+  // insert code here
+  BF_Block *block;
+  BF_Block_Init(&block);
+
+  int id;
+  SHT_OpenSecondaryIndex(filename, &id);
+  int fd = secIndexArray[id].fd;
+
+  // get number of blocks
+  int nblocks;
+  CALL_BF(BF_GetBlockCounter(fd, &nblocks));
+  printf("File %s has %d blocks.\n", filename, nblocks);
+
+  // // get depth
+  int depth;
+  CALL_OR_DIE(getDepth(fd, block, &depth));
+
+  // // get hash table
+  BF_Block *hashBlock;
+  BF_Block_Init(&hashBlock);
+  SecHashEntry *hashEntry;
+  CALL_OR_DIE(pinSecHashEntry(fd, hashBlock, 1, &hashEntry));
+
+  prefetchSecBuckets(fd, hashEntry);
+  int iter = hashEntry->secHeader.size;
+  int dataN = iter;
+  int min, max, total;
+  max = total = 0;
+  min = -1;
+
+  for (int i = 0; i < iter; i++)
+  {
+    int blockN = hashEntry->secHashNode[i].block_num;
+    SecondaryRecord *records;
+    int num, local_depth;
+    CALL_OR_DIE(getSecBucketRecords(fd, block, blockN, &records, &num, &local_depth));
+    free(records);
+
+    total += num;
+    if (num > max)
+      max = num;
+    if (num < min || min == -1)
+      min = num;
+
+    int dif = depth - local_depth;
+    i += pow(2.0, (double)dif) - 1;
+    dataN -= pow(2.0, (double)dif) - 1;
+  }
+
+  printf("Max number of records in bucket is %i\n", max);
+  printf("Min number of records in bucket is %i\n", min);
+  printf("Mean number of records in bucket is %f\n", (double)total / (double)dataN);
+
+  CALL_OR_DIE(unpinPage(hashBlock, 0));
+  BF_Block_Destroy(&hashBlock);
+  BF_Block_Destroy(&block);
+  SHT_CloseSecondaryIndex(id);
+
+  return HT_OK;
+}
+
+// the in-memory hash table of a hash join, over the SecondaryRecords of one of the two indexes
+typedef struct
+{
+  int n;
+  SecondaryRecord *records; // in the order of a scan of the index
+  unsigned int *hash;       // hashString of each record's key
+  int *next;                // the next record of the same chain, or -1
+  int size;                 // number of chains, a power of 2
+  int *head;                // the first record of each chain, or -1
+} SecJoinTable;
+
+/*
+  Loads every SecondaryRecord of the secondary index with fileDesc 'fd' and pinned HashTable 'hashEntry', bucket by bucket,
+  each bucket once. 'records' is allocated here and must be freed by the calling function.
+*/
+HT_ErrorCode loadSecIndexRecords(int fd, BF_Block *block, int depth, SecHashEntry *hashEntry, SecondaryRecord **records, int *n)
+{
+  int capacity = SEC_MAX_POSTINGS(getPageSize(fd));
+  *records = malloc(capacity * sizeof(SecondaryRecord));
+  *n = 0;
+
+  prefetchSecBuckets(fd, hashEntry);
+  for (int i = 0; i < hashEntry->secHeader.size; i++)
+  {
+    SecondaryRecord *bucketRecords;
+    int bucketN, local_depth;
+    CALL_OR_DIE(getSecBucketRecords(fd, block, hashEntry->secHashNode[i].block_num, &bucketRecords, &bucketN, &local_depth));
+    if (*n + bucketN > capacity)
+    {
+      while (*n + bucketN > capacity)
+        capacity *= 2;
+      *records = realloc(*records, capacity * sizeof(SecondaryRecord));
+    }
+    memcpy(*records + *n, bucketRecords, bucketN * sizeof(SecondaryRecord));
+    *n += bucketN;
+    free(bucketRecords);
+
+    // skip hash values that point to the same block
+    i += (1 << (depth - local_depth)) - 1;
+  }
+
+  return HT_OK;
+}
+
+/*
+  Builds the hash join table 'table' over every record of the secondary index with fileDesc 'fd'.
+  The records of a chain keep the order of the scan, so the matches of a key are found in that order.
+*/
+HT_ErrorCode buildSecJoinTable(int fd, BF_Block *block, int depth, SecHashEntry *hashEntry, SecJoinTable *table)
+{
+  CALL_OR_DIE(loadSecIndexRecords(fd, block, depth, hashEntry, &table->records, &table->n));
+
+  table->size = 1;
+  while (table->size < table->n)
+    table->size *= 2;
+  table->hash = malloc((table->n + 1) * sizeof(unsigned int));
+  table->next = malloc((table->n + 1) * sizeof(int));
+  table->head = malloc(table->size * sizeof(int));
+  for (int h = 0; h < table->size; h++)
+    table->head[h] = -1;
+
+  // pushed from the last record, so that every chain is in scan order
+  for (int i = table->n - 1; i >= 0; i--)
+  {
+    table->hash[i] = hashString(table->records[i].index_key);
+    int h = table->hash[i] & (table->size - 1);
+    table->next[i] = table->head[h];
+    table->head[h] = i;
+  }
+
+  return HT_OK;
+}
+
+void freeSecJoinTable(SecJoinTable *table)
+{
+  free(table->records);
+  free(table->hash);
+  free(table->next);
+  free(table->head);
+}
+
+/*
+  Hash join of the secondary indexes with fileDescs 'fd1' and 'fd2' (pinned HashTables 'hashEntry1', 'hashEntry2').
+  The table is built over the index with the fewer blocks, the other one is read once, bucket by bucket.
+  'callback' gets the tupleId of the first index first, whichever side the table was built on.
+*/
+HT_ErrorCode hashJoinSecIndexes(int fd1, int depth1, SecHashEntry *hashEntry1, int fd2, int depth2, SecHashEntry *hashEntry2,
+                                SHT_JoinCallback callback, void *arg)
+{
+  BF_Block *block;
+  BF_Block_Init(&block);
+
+  int blocks1, blocks2;
+  CALL_BF(BF_GetBlockCounter(fd1, &blocks1));
+  CALL_BF(BF_GetBlockCounter(fd2, &blocks2));
+  int buildFirst = blocks1 < blocks2;
+
+  SecJoinTable table;
+  if (buildFirst)
+  {
+    CALL_OR_DIE(buildSecJoinTable(fd1, block, depth1, hashEntry1, &table));
+  }
+  else
+  {
+    CALL_OR_DIE(buildSecJoinTable(fd2, block, depth2, hashEntry2, &table));
+  }
+
+  int fd = buildFirst ? fd2 : fd1;
+  int depth = buildFirst ? depth2 : depth1;
+  SecHashEntry *hashEntry = buildFirst ? hashEntry2 : hashEntry1;
+  prefetchSecBuckets(fd, hashEntry);
+  for (int i = 0; i < hashEntry->secHeader.size; i++)
+  {
+    SecondaryRecord *records;
+    int n, local_depth;
+    CALL_OR_DIE(getSecBucketRecords(fd, block, hashEntry->secHashNode[i].block_num, &records, &n, &local_depth));
+
+    for (int j = 0; j < n; j++)
+    {
+      unsigned int hash = hashString(records[j].index_key);
+      for (int k = table.head[hash & (table.size - 1)]; k != -1; k = table.next[k])
+      {
+        if (table.hash[k] != hash || strcmp(table.records[k].index_key, records[j].index_key) != 0)
+          continue;
+        if (buildFirst)
+          callback(records[j].index_key, table.records[k].tupleId, records[j].tupleId, arg);
+        else
+          callback(records[j].index_key, records[j].tupleId, table.records[k].tupleId, arg);
+      }
+    }
+    free(records);
+
+    // skip hash values that point to the same block
+    i += (1 << (depth - local_depth)) - 1;
+  }
+
+  freeSecJoinTable(&table);
+  BF_Block_Destroy(&block);
+  return HT_OK;
+}
+
+/*
+  Calls 'callback' for every pair of a 'probe' record and a 'build' record with the same key.
+  build: the records of one bucket, the records of a key next to each other (as getSecBucketRecords loads them).
+  buildFirst: 1 if 'build' comes from the first index, so that its tupleId is given first.
+*/
+void joinSecBucketRecords(SecondaryRecord *build, int buildN, SecondaryRecord *probe, int probeN, int buildFirst,
+                          SHT_JoinCallback callback, void *arg)
+{
+  // where the records of each key of 'build' start, a bucket has few keys
+  int *runs = malloc((buildN + 1) * sizeof(int));
+  int runsN = 0;
+  for (int k = 0; k < buildN; k++)
+    if (k == 0 || strcmp(build[k].index_key, build[k - 1].index_key) != 0)
+      runs[runsN++] = k;
+  runs[runsN] = buildN;
+
+  for (int j = 0; j < probeN; j++)
+  {
+    for (int r = 0; r < runsN; r++)
+    {
+      if (strcmp(build[runs[r]].index_key, probe[j].index_key) != 0)
+        continue;
+      for (int k = runs[r]; k < runs[r + 1]; k++)
+      {
+        if (buildFirst)
+          callback(probe[j].index_key, build[k].tupleId, probe[j].tupleId, arg);
+        else
+          callback(probe[j].index_key, probe[j].tupleId, build[k].tupleId, arg);
+      }
+      break;
+    }
+  }
+
+  free(runs);
+}
+
+/*
+  Join of the secondary indexes with fileDescs 'fd1' and 'fd2' (pinned HashTables 'hashEntry1', 'hashEntry2') that uses
+  that both hash their keys with hashAttr: a key is in the buckets of the two indexes whose hash values share their first bits.
+  The two HashTables are walked together, as tables of the largest depth. At every step the bucket with the lower local depth
+  is kept in memory and the buckets of the other index under it are read one by one, so every bucket is read once.
+*/
+HT_ErrorCode partitionedJoinSecIndexes(int fd1, int depth1, SecHashEntry *hashEntry1, int fd2, int depth2, SecHashEntry *hashEntry2,
+                                       SHT_JoinCallback callback, void *arg)
+{
+  BF_Block *block;
+  BF_Block_Init(&block);
+
+  prefetchSecBuckets(fd1, hashEntry1);
+  prefetchSecBuckets(fd2, hashEntry2);
+  int depth = depth1 > depth2 ? depth1 : depth2;
+  int h = 0;
+  while (h < (1 << depth))
+  {
+    // the buckets of both indexes start at hash value h
+    SecondaryRecord *records1, *records2;
+    int n1, n2, local_depth1, local_depth2;
+    CALL_OR_DIE(getSecBucketRecords(fd1, block, hashEntry1->secHashNode[h >> (depth - depth1)].block_num, &records1, &n1, &local_depth1));
+    CALL_OR_DIE(getSecBucketRecords(fd2, block, hashEntry2->secHashNode[h >> (depth - depth2)].block_num, &records2, &n2, &local_depth2));
+    int span1 = 1 << (depth - local_depth1);
+    int span2 = 1 << (depth - local_depth2);
+
+    // the wider bucket is kept, with equal ones the first index is read record by record, as a nested loop would
+    int buildFirst = span1 > span2;
+    SecondaryRecord *build = buildFirst ? records1 : records2;
+    int buildN = buildFirst ? n1 : n2;
+    int span = buildFirst ? span1 : span2;
+
+    int fd = buildFirst ? fd2 : fd1;
+    int probeDepth = buildFirst ? depth2 : depth1;
+    SecHashEntry *hashEntry = buildFirst ? hashEntry2 : hashEntry1;
+    SecondaryRecord *probe = buildFirst ? records2 : records1;
+    int probeN = buildFirst ? n2 : n1;
+    int probeSpan = buildFirst ? span2 : span1;
+
+    int x = h;
+    while (1)
+    {
+      joinSecBucketRecords(build, buildN, probe, probeN, buildFirst, callback, arg);
+      free(probe);
+      x += probeSpan;
+      if (x >= h + span)
+        break;
+
+      int local_depth;
+      CALL_OR_DIE(getSecBucketRecords(fd, block, hashEntry->secHashNode[x >> (depth - probeDepth)].block_num, &probe, &probeN, &local_depth));
+      probeSpan = 1 << (depth - local_depth);
+    }
+
+    free(build);
+    h += span;
+  }
+
+  BF_Block_Destroy(&block);
+  return HT_OK;
+}
+
+/*
+  Returns the 'i'-th bit of the Bloom filter that a key with hashString 'hash' sets. The bits come from two hash values
+  of the key (double hashing), 'hash' and a second one mixed out of it.
+*/
+unsigned int getBloomBit(const SHT_BloomFilter *filter, unsigned int hash, int i)
+{
+  unsigned int hash2 = (hash * 0x9E3779B1u) >> 7 | 1;
+  return (hash + i * hash2) % filter->bitsN;
+}
+
+HT_ErrorCode SHT_BloomInit(SHT_BloomFilter *filter, int keysN, int bitsPerKey)
+{
+  if (keysN < 0 || bitsPerKey < 1)
+  {
+    printf("Wrong Bloom filter input!\n");
+    return HT_ERROR;
+  }
+
+  // k = bitsPerKey * ln 2 hash functions give the fewest false positives
+  filter->bitsN = keysN * bitsPerKey < 64 ? 64 : keysN * bitsPerKey;
+  filter->hashesN = (int)(bitsPerKey * 0.69 + 0.5);
+  if (filter->hashesN < 1)
+    filter->hashesN = 1;
+  filter->bits = calloc((filter->bitsN + 7) / 8, 1);
+  return HT_OK;
+}
+
+void SHT_BloomAdd(SHT_BloomFilter *filter, const char *key)
+{
+  unsigned int hash = hashString(key);
+  for (int i = 0; i < filter->hashesN; i++)
+  {
+    unsigned int bit = getBloomBit(filter, hash, i);
+    filter->bits[bit / 8] |= 1 << (bit % 8);
+  }
+}
+
+int SHT_BloomMayContain(const SHT_BloomFilter *filter, const char *key)
+{
+  unsigned int hash = hashString(key);
+  for (int i = 0; i < filter->hashesN; i++)
+  {
+    unsigned int bit = getBloomBit(filter, hash, i);
+    if ((filter->bits[bit / 8] & (1 << (bit % 8))) == 0)
+      return 0;
+  }
+  return 1;
+}
+
+void SHT_BloomFree(SHT_BloomFilter *filter)
+{
+  free(filter->bits);
+  filter->bits = NULL;
+}
+
+/*
+  Calls 'visit' for the header of every key of the secondary index with fileDesc 'fd' (pinned HashTable 'hashEntry'),
+  bucket by bucket, each bucket once. Only the blocks of the buckets are read, not the blocks with tupleIds.
+*/
+HT_ErrorCode visitSecIndexKeys(int fd, BF_Block *block, int depth, SecHashEntry *hashEntry, void (*visit)(SecKeyHeader *key, void *arg), void *arg)
+{
+  prefetchSecBuckets(fd, hashEntry);
+  for (int i = 0; i < hashEntry->secHeader.size; i++)
+  {
+    int block_num = hashEntry->secHashNode[i].block_num;
+    int local_depth = depth;
+    while (block_num != -1)
+    {
+      SecEntry *entry;
+      CALL_OR_DIE(pinSecEntry(fd, block, block_num, &entry));
+      if (block_num == hashEntry->secHashNode[i].block_num)
+        local_depth = entry->secHeader.local_depth;
+
+      int offset = 0;
+      for (int k = 0; k < entry->secHeader.size; k++)
+      {
+        SecKeyHeader *key = (SecKeyHeader *)(entry->data + offset);
+        visit(key, arg);
+        offset += getSecKeySize(key);
+      }
+      block_num = entry->secHeader.next_block;
+      CALL_OR_DIE(unpinPage(block, 0));
+    }
+
+    // skip hash values that point to the same block
+    i += (1 << (depth - local_depth)) - 1;
+  }
+
+  return HT_OK;
+}
+
+/*
+  Key visitor of SHT_BuildBloomFilter that only counts the keys in the int 'arg'.
+*/
+void countSecKey(SecKeyHeader *key, void *arg)
+{
+  (void)key;
+  (*(int *)arg)++;
+}
+
+void addSecKeyToBloom(SecKeyHeader *key, void *arg)
+{
+  SHT_BloomAdd(arg, key->index_key);
+}
+
+HT_ErrorCode SHT_BuildBloomFilter(int sindexDesc, int bitsPerKey, SHT_BloomFilter *filter)
+{
+  if (secIndexArray[sindexDesc].used == 0)
+  {
+    printf("Can't read a closed file!\n");
+    return HT_ERROR;
+  }
+
+  BF_Block *block;
+  BF_Block_Init(&block);
+  BF_Block *hashBlock;
+  BF_Block_Init(&hashBlock);
+
+  int fd = secIndexArray[sindexDesc].fd;
+  int depth;
+  CALL_OR_DIE(getDepth(fd, block, &depth));
+  SecHashEntry *hashEntry;
+  CALL_OR_DIE(pinSecHashEntry(fd, hashBlock, 1, &hashEntry));
+
+  // every distinct key is stored once, so the first pass counts them for the size of the filter
+  int keysN = 0;
+  CALL_OR_DIE(visitSecIndexKeys(fd, block, depth, hashEntry, countSecKey, &keysN));
+  HT_ErrorCode code = SHT_BloomInit(filter, keysN, bitsPerKey);
+  if (code == HT_OK)
+    CALL_OR_DIE(visitSecIndexKeys(fd, block, depth, hashEntry, addSecKeyToBloom, filter));
+
+  CALL_OR_DIE(unpinPage(hashBlock, 0));
+  BF_Block_Destroy(&hashBlock);
+  BF_Block_Destroy(&block);
+  return code;
+}
+
+/*
+  Adds every SecondaryRecord of the secondary index with fileDesc 'fd' (pinned HashTable 'hashEntry') to 'parts',
+  bucket by bucket, each bucket once.
+*/
+HT_ErrorCode partitionSecRecords(int fd, int depth, SecHashEntry *hashEntry, JoinPartitions *parts)
+{
+  BF_Block *block;
+  BF_Block_Init(&block);
+  prefetchSecBuckets(fd, hashEntry);
+
+  for (int i = 0; i < hashEntry->secHeader.size; i++)
+  {
+    SecondaryRecord *records;
+    int n, local_depth;
+    CALL_OR_DIE(getSecBucketRecords(fd, block, hashEntry->secHashNode[i].block_num, &records, &n, &local_depth));
+    for (int j = 0; j < n; j++)
+      CALL_OR_DIE(addJoinTuple(parts, records[j].index_key, records[j].tupleId));
+    free(records);
+
+    // skip hash values that point to the same block
+    i += (1 << (depth - local_depth)) - 1;
+  }
+
+  BF_Block_Destroy(&block);
+  return flushJoinPartitions(parts);
+}
+
+HT_ErrorCode SHT_GraceJoin(int sindexDesc1, int sindexDesc2, int memoryBlocks, SHT_JoinCallback callback, void *arg)
+{
+  if (secIndexArray[sindexDesc1].used == 0 || secIndexArray[sindexDesc2].used == 0)
+  {
+    printf("Can't join a closed file!\n");
+    return HT_ERROR;
+  }
+  if (callback == NULL || memoryBlocks < 3 || memoryBlocks > getJoinMemoryMax())
+  {
+    printf("Wrong join input! Please give a callback and from 3 to %d blocks.\n", getJoinMemoryMax());
+    return HT_ERROR;
+  }
+
+  BF_Block *block;
+  BF_Block_Init(&block);
+
+  int fd1 = secIndexArray[sindexDesc1].fd;
+  int depth1;
+  CALL_OR_DIE(getDepth(fd1, block, &depth1));
+  BF_Block *hashBlock1;
+  BF_Block_Init(&hashBlock1);
+  SecHashEntry *hashEntry1;
+  CALL_OR_DIE(pinSecHashEntry(fd1, hashBlock1, 1, &hashEntry1));
+
+  int fd2 = secIndexArray[sindexDesc2].fd;
+  int depth2;
+  CALL_OR_DIE(getDepth(fd2, block, &depth2));
+  BF_Block *hashBlock2;
+  BF_Block_Init(&hashBlock2);
+  SecHashEntry *hashEntry2;
+  CALL_OR_DIE(pinSecHashEntry(fd2, hashBlock2, 1, &hashEntry2));
+
+  // the number of records is not kept, a block holds at most SEC_MAX_POSTINGS of them
+  int blocks1, blocks2;
+  CALL_BF(BF_GetBlockCounter(fd1, &blocks1));
+  CALL_BF(BF_GetBlockCounter(fd2, &blocks2));
+  int records1 = blocks1 * SEC_MAX_POSTINGS(getPageSize(fd1));
+  int records2 = blocks2 * SEC_MAX_POSTINGS(getPageSize(fd2));
+  int n = getJoinPartitionsN(records1 < records2 ? records1 : records2, memoryBlocks);
+
+  JoinPartitions parts1, parts2;
+  CALL_OR_DIE(openJoinPartitions(&parts1, n, 1, 0));
+  CALL_OR_DIE(openJoinPartitions(&parts2, n, 2, 0));
+  CALL_OR_DIE(partitionSecRecords(fd1, depth1, hashEntry1, &parts1));
+  CALL_OR_DIE(partitionSecRecords(fd2, depth2, hashEntry2, &parts2));
+
+  CALL_OR_DIE(unpinPage(hashBlock1, 0));
+  CALL_OR_DIE(unpinPage(hashBlock2, 0));
+  BF_Block_Destroy(&hashBlock1);
+  BF_Block_Destroy(&hashBlock2);
+  BF_Block_Destroy(&block);
+
+  CALL_OR_DIE(joinPartitions(&parts1, &parts2, memoryBlocks, callback, arg));
+
+  CALL_OR_DIE(closeJoinPartitions(&parts1));
+  CALL_OR_DIE(closeJoinPartitions(&parts2));
+
+  return HT_OK;
+}
+
+/*
+  Semi-join pushdown of the secondary indexes with fileDescs 'fd1' and 'fd2' (pinned HashTables 'hashEntry1', 'hashEntry2').
+  The index with the fewer blocks is loaded as in hashJoinSecIndexes, and two filters are built over its keys:
+  the hash values (at the depth of the other index) that have any of its keys, and a Bloom filter.
+  A bucket of the other index is read only if its hash values have a key of the small index, a key of it is compared with
+  the keys of the table only if it passes the Bloom filter, and its tupleIds are read only if it has a match.
+*/
+HT_ErrorCode bloomJoinSecIndexes(int fd1, int depth1, SecHashEntry *hashEntry1, int fd2, int depth2, SecHashEntry *hashEntry2,
+                                 SHT_JoinCallback callback, void *arg)
+{
+  BF_Block *block;
+  BF_Block_Init(&block);
+
+  int blocks1, blocks2;
+  CALL_BF(BF_GetBlockCounter(fd1, &blocks1));
+  CALL_BF(BF_GetBlockCounter(fd2, &blocks2));
+  int buildFirst = blocks1 < blocks2;
+
+  SecJoinTable table;
+  if (buildFirst)
+  {
+    CALL_OR_DIE(buildSecJoinTable(fd1, block, depth1, hashEntry1, &table));
+  }
+  else
+  {
+    CALL_OR_DIE(buildSecJoinTable(fd2, block, depth2, hashEntry2, &table));
+  }
+
+  int fd = buildFirst ? fd2 : fd1;
+  int depth = buildFirst ? depth2 : depth1;
+  SecHashEntry *hashEntry = buildFirst ? hashEntry2 : hashEntry1;
+
+  SHT_BloomFilter filter;
+  CALL_OR_DIE(SHT_BloomInit(&filter, table.n, SHT_BLOOM_BITS_PER_KEY));
+  char *values = calloc(hashEntry->secHeader.size, 1);
+  for (int k = 0; k < table.n; k++)
+  {
+    SHT_BloomAdd(&filter, table.records[k].index_key);
+    values[hashAttr(table.records[k].index_key, depth)] = 1;
+  }
+
+  int capacity = SEC_MAX_POSTINGS(getPageSize(fd));
+  SecondaryRecord *records = malloc(capacity * sizeof(SecondaryRecord));
+  int i = 0;
+  while (i < hashEntry->secHeader.size)
+  {
+    // the hash values of a bucket are next to each other in the HashTable, so it is skipped without being read
+    int bucket = hashEntry->secHashNode[i].block_num;
+    int span = 1;
+    while (i + span < hashEntry->secHeader.size && hashEntry->secHashNode[i + span].block_num == bucket)
+      span++;
+    int wanted = 0;
+    for (int h = i; h < i + span && !wanted; h++)
+      wanted = values[h];
+    i += span;
+    if (!wanted)
+      continue;
+
+    int block_num = bucket;
+    while (block_num != -1)
+    {
+      SecEntry *entry;
+      CALL_OR_DIE(pinSecEntry(fd, block, block_num, &entry));
+      int offset = 0;
+      for (int k = 0; k < entry->secHeader.size; k++)
+      {
+        SecKeyHeader *key = (SecKeyHeader *)(entry->data + offset);
+        offset += getSecKeySize(key);
+        if (!SHT_BloomMayContain(&filter, key->index_key))
+          continue;
+
+        // the first record of the table with this key, if there is any
+        unsigned int hash = hashString(key->index_key);
+        int first = table.head[hash & (table.size - 1)];
+        while (first != -1 && (table.hash[first] != hash || strcmp(table.records[first].index_key, key->index_key) != 0))
+          first = table.next[first];
+        if (first == -1)
+          continue;
+
+        int n = 0;
+        CALL_OR_DIE(loadSecKeyRecords(fd, key, &records, &n, &capacity));
+        for (int j = 0; j < n; j++)
+        {
+          for (int m = first; m != -1; m = table.next[m])
+          {
+            if (table.hash[m] != hash || strcmp(table.records[m].index_key, key->index_key) != 0)
+              continue;
+            if (buildFirst)
+              callback(key->index_key, table.records[m].tupleId, records[j].tupleId, arg);
+            else
+              callback(key->index_key, records[j].tupleId, table.records[m].tupleId, arg);
+          }
+        }
+      }
+      block_num = entry->secHeader.next_block;
+      CALL_OR_DIE(unpinPage(block, 0));
+    }
+  }
+
+  free(records);
+  free(values);
+  SHT_BloomFree(&filter);
+  freeSecJoinTable(&table);
+  BF_Block_Destroy(&block);
+  return HT_OK;
+}
+
+HT_ErrorCode SHT_InnerJoinCallback(int sindexDesc1, int sindexDesc2, char *index_key, SHT_JoinMethod method, SHT_JoinCallback callback, void *arg)
+{
+  if (secIndexArray[sindexDesc1].used == 0 || secIndexArray[sindexDesc2].used == 0)
+  {
+    printf("Can't join a closed file!\n");
+    return HT_ERROR;
+  }
+  if (callback == NULL)
+  {
+    printf("Wrong join input!\n");
+    return HT_ERROR;
+  }
+
+  // initialize blocks
+  BF_Block *block1;
+  BF_Block_Init(&block1);
+
+  BF_Block *block2;
+  BF_Block_Init(&block2);
+
+  // get secondary indexes
+  int fd1 = secIndexArray[sindexDesc1].fd;
+  int depth1;
+  CALL_OR_DIE(getDepth(fd1, block1, &depth1));
+  BF_Block *hashBlock1;
+  BF_Block_Init(&hashBlock1);
+  SecHashEntry *hashEntry1;
+  CALL_OR_DIE(pinSecHashEntry(fd1, hashBlock1, 1, &hashEntry1));
+
+  int fd2 = secIndexArray[sindexDesc2].fd;
+  int depth2;
+  CALL_OR_DIE(getDepth(fd2, block2, &depth2));
+  BF_Block *hashBlock2;
+  BF_Block_Init(&hashBlock2);
+  SecHashEntry *hashEntry2;
+  CALL_OR_DIE(pinSecHashEntry(fd2, hashBlock2, 1, &hashEntry2));
+
+  // if key is NULL join all records, with the method asked for
+  if (index_key == NULL && method == SHT_HASH_JOIN)
+  {
+    CALL_OR_DIE(hashJoinSecIndexes(fd1, depth1, hashEntry1, fd2, depth2, hashEntry2, callback, arg));
+  }
+  else if (index_key == NULL && method == SHT_BLOOM_JOIN)
+  {
+    CALL_OR_DIE(bloomJoinSecIndexes(fd1, depth1, hashEntry1, fd2, depth2, hashEntry2, callback, arg));
+  }
+  else if (index_key == NULL)
+  {
+    CALL_OR_DIE(partitionedJoinSecIndexes(fd1, depth1, hashEntry1, fd2, depth2, hashEntry2, callback, arg));
+  }
+  else
+  {
+    int hash_val1 = hashAttr(index_key, depth1);
+    int hash_val2 = hashAttr(index_key, depth2);
+    int bn1 = hashEntry1->secHashNode[hash_val1].block_num;
+    int bn2 = hashEntry2->secHashNode[hash_val2].block_num;
+
+    // only the postings of the key are loaded
+    SecondaryRecord *records1;
+    int n1;
+    CALL_OR_DIE(getSecKeyRecords(fd1, block1, bn1, index_key, &records1, &n1));
+
+    SecondaryRecord *records2;
+    int n2;
+    CALL_OR_DIE(getSecKeyRecords(fd2, block2, bn2, index_key, &records2, &n2));
+
+    for (int i = 0; i < n1; i++)
+      for (int j = 0; j < n2; j++)
+        callback(records1[i].index_key, records1[i].tupleId, records2[j].tupleId, arg);
+
+    free(records1);
+    free(records2);
+  }
+
+  CALL_OR_DIE(unpinPage(hashBlock1, 0));
+  CALL_OR_DIE(unpinPage(hashBlock2, 0));
+  BF_Block_Destroy(&hashBlock1);
+  BF_Block_Destroy(&hashBlock2);
+  BF_Block_Destroy(&block1);
+  BF_Block_Destroy(&block2);
+  return HT_OK;
+}
+
+// the tuple ids of a key gathered by SHT_LookupRecords
+typedef struct
+{
+  int n;
+  int capacity;
+  tid *tupleIds;
+} SecTidList;
+
+/*
+  SHT_LookupCallback of SHT_LookupRecords: adds a tuple id to the SecTidList 'arg'.
+*/
+void addSecTid(tid tupleId, void *arg)
+{
+  SecTidList *list = arg;
+  if (list->n == list->capacity)
+  {
+    list->capacity *= 2;
+    list->tupleIds = realloc(list->tupleIds, list->capacity * sizeof(tid));
+  }
+  list->tupleIds[list->n++] = tupleId;
+}
+
+HT_ErrorCode SHT_LookupRecords(int sindexDesc, char *index_key, SHT_RecordCallback callback, void *arg)
+{
+  if (callback == NULL)
+  {
+    printf("Wrong lookup input!\n");
+    return HT_ERROR;
+  }
+
+  SecTidList list;
+  list.n = 0;
+  list.capacity = SEC_MAX_POSTINGS(BF_BLOCK_SIZE);
+  list.tupleIds = malloc(list.capacity * sizeof(tid));
+  HT_ErrorCode code = SHT_Lookup(sindexDesc, index_key, addSecTid, &list);
+  if (code != HT_OK)
+  {
+    free(list.tupleIds);
+    return code;
+  }
+
+  int pid, opened;
+  code = getPrimaryIndex(secIndexArray[sindexDesc].primary_name, &pid, &opened);
+  if (code != HT_OK)
+  {
+    free(list.tupleIds);
+    return code;
+  }
+
+  // SEC_FETCH_BATCH records at a time, each primary block read once per batch
+  Record *records = malloc(SEC_FETCH_BATCH * sizeof(Record));
+  for (int i = 0; i < list.n && code == HT_OK; i += SEC_FETCH_BATCH)
+  {
+    int n = list.n - i < SEC_FETCH_BATCH ? list.n - i : SEC_FETCH_BATCH;
+    code = HT_FetchRecords(pid, list.tupleIds + i, n, records);
+    for (int j = 0; j < n && code == HT_OK; j++)
+      callback(list.tupleIds[i + j], &records[j], arg);
+  }
+
+  free(records);
+  free(list.tupleIds);
+  if (opened)
+    CALL_OR_DIE(HT_CloseFile(pid));
+  return code;
+}
+
+// a pair of the join, kept until the records of its batch are fetched
+typedef struct
+{
+  char index_key[20];
+  tid tupleId1;
+  tid tupleId2;
+} SecJoinPair;
+
+// how many threads of SHT_ParallelInnerJoin read the indexes at the same time with src/bf.c, so that their pins fit in the BF memory
+typedef struct
+{
+  pthread_mutex_t mutex;
+  pthread_cond_t freed; // signalled when a thread stops reading
+  int readers;
+  int readersMax;
+} SecReadGate;
+
+// the pairs of a join whose records are fetched before they are given to the sink, SEC_FETCH_BATCH pairs at a time
+typedef struct
+{
+  int primary1;
+  int primary2;
+  int n;
+  SecJoinPair *pairs;
+  tid *tupleIds;
+  Record *records1;
+  Record *records2;
+  SHT_JoinSink *sink;
+  pthread_mutex_t *mutex;     // held around every write of a sink with usesBF when other threads use the BF too, or NULL
+  pthread_mutex_t *readMutex; // held around every read of the indexes when other threads use a BF that is not thread-safe, or NULL
+  SecReadGate *gate;          // entered around every read of the indexes when other threads read together, or NULL
+  HT_ErrorCode code;
+} SecJoinBatch;
+
+void lockSecJoinBatch(SecJoinBatch *batch)
+{
+  if (batch->mutex != NULL)
+    pthread_mutex_lock(batch->mutex);
+}
+
+void unlockSecJoinBatch(SecJoinBatch *batch)
+{
+  if (batch->mutex != NULL)
+    pthread_mutex_unlock(batch->mutex);
+}
+
+void lockSecJoinReads(SecJoinBatch *batch)
+{
+  if (batch->readMutex != NULL)
+    pthread_mutex_lock(batch->readMutex);
+  if (batch->gate != NULL)
+  {
+    pthread_mutex_lock(&batch->gate->mutex);
+    while (batch->gate->readers == batch->gate->readersMax)
+      pthread_cond_wait(&batch->gate->freed, &batch->gate->mutex);
+    batch->gate->readers++;
+    pthread_mutex_unlock(&batch->gate->mutex);
+  }
+}
+
+void unlockSecJoinReads(SecJoinBatch *batch)
+{
+  if (batch->gate != NULL)
+  {
+    pthread_mutex_lock(&batch->gate->mutex);
+    batch->gate->readers--;
+    pthread_cond_signal(&batch->gate->freed);
+    pthread_mutex_unlock(&batch->gate->mutex);
+  }
+  if (batch->readMutex != NULL)
+    pthread_mutex_unlock(batch->readMutex);
+}
+
+/*
+  Fetches the records of the pairs kept in 'batch' from their primary indexes, each block once and in file order,
+  and gives the rows to the sink in the order the pairs were found.
+*/
+HT_ErrorCode flushSecJoinBatch(SecJoinBatch *batch)
+{
+  if (batch->n == 0)
+    return HT_OK;
+
+  // runs at the threads of SHT_ParallelInnerJoin too, so an error is returned with the mutexes released
+  lockSecJoinReads(batch);
+  for (int i = 0; i < batch->n; i++)
+    batch->tupleIds[i] = batch->pairs[i].tupleId1;
+  HT_ErrorCode code = HT_FetchRecords(batch->primary1, batch->tupleIds, batch->n, batch->records1);
+  if (code == HT_OK)
+  {
+    for (int i = 0; i < batch->n; i++)
+      batch->tupleIds[i] = batch->pairs[i].tupleId2;
+    code = HT_FetchRecords(batch->primary2, batch->tupleIds, batch->n, batch->records2);
+  }
+  unlockSecJoinReads(batch);
+  if (code != HT_OK)
+  {
+    batch->n = 0;
+    return code;
+  }
+  if (batch->sink->usesBF)
+    lockSecJoinBatch(batch);
+
+  for (int i = 0; i < batch->n && code == HT_OK; i++)
+  {
+    SHT_JoinRow row;
+    row.index_key = batch->pairs[i].index_key;
+    row.tupleId1 = batch->pairs[i].tupleId1;
+    row.tupleId2 = batch->pairs[i].tupleId2;
+    row.record1 = &batch->records1[i];
+    row.record2 = &batch->records2[i];
+    code = batch->sink->write(batch->sink, &row);
+    batch->sink->rows++;
+  }
+  if (batch->sink->usesBF)
+    unlockSecJoinBatch(batch);
+
+  batch->n = 0;
+  return code;
+}
+
+/*
+  SHT_JoinCallback of SHT_InnerJoinSink for sinks that need records: keeps a pair, and gives the kept pairs to the sink
+  when SEC_FETCH_BATCH of them are gathered.
+*/
+void addSecJoinPair(const char *index_key, tid tupleId1, tid tupleId2, void *arg)
+{
+  SecJoinBatch *batch = arg;
+  if (batch->code != HT_OK)
+    return;
+
+  SecJoinPair *pair = &batch->pairs[batch->n++];
+  strcpy(pair->index_key, index_key);
+  pair->tupleId1 = tupleId1;
+  pair->tupleId2 = tupleId2;
+
+  if (batch->n == SEC_FETCH_BATCH)
+    batch->code = flushSecJoinBatch(batch);
+}
+
+/*
+  SHT_JoinCallback of SHT_InnerJoinSink for sinks that do not need records: gives the pair to the sink of the SecJoinBatch 'arg' right away.
+*/
+void writeSecJoinPair(const char *index_key, tid tupleId1, tid tupleId2, void *arg)
+{
+  SecJoinBatch *batch = arg;
+  SHT_JoinSink *sink = batch->sink;
+  SHT_JoinRow row;
+  row.index_key = index_key;
+  row.tupleId1 = tupleId1;
+  row.tupleId2 = tupleId2;
+  row.record1 = NULL;
+  row.record2 = NULL;
+  if (sink->usesBF)
+    lockSecJoinBatch(batch);
+  if (sink->write(sink, &row) != HT_OK)
+    batch->code = HT_ERROR;
+  if (sink->usesBF)
+    unlockSecJoinBatch(batch);
+  sink->rows++;
+}
+
+HT_ErrorCode SHT_InnerJoinSink(int sindexDesc1, int sindexDesc2, char *index_key, SHT_JoinMethod method, SHT_JoinSink *sink)
+{
+  if (sink == NULL || sink->write == NULL)
+  {
+    printf("Wrong join input!\n");
+    return HT_ERROR;
+  }
+  if (secIndexArray[sindexDesc1].used == 0 || secIndexArray[sindexDesc2].used == 0)
+  {
+    printf("Can't join a closed file!\n");
+    return HT_ERROR;
+  }
+
+  // without records the primary indexes are not needed at all
+  SecJoinBatch batch;
+  batch.n = 0;
+  batch.sink = sink;
+  batch.mutex = NULL;
+  batch.readMutex = NULL;
+  batch.gate = NULL;
+  batch.code = HT_OK;
+  if (!sink->needsRecords)
+  {
+    HT_ErrorCode code = SHT_InnerJoinCallback(sindexDesc1, sindexDesc2, index_key, method, writeSecJoinPair, &batch);
+    return code == HT_OK ? batch.code : code;
+  }
+
+  // get corresponding primary indexes
+  int pid1, opened1;
+  if (getPrimaryIndex(secIndexArray[sindexDesc1].primary_name, &pid1, &opened1) != HT_OK)
+    return HT_ERROR;
+  int pid2, opened2;
+  if (getPrimaryIndex(secIndexArray[sindexDesc2].primary_name, &pid2, &opened2) != HT_OK)
+  {
+    if (opened1)
+      HT_CloseFile(pid1);
+    return HT_ERROR;
+  }
+
+  batch.primary1 = pid1;
+  batch.primary2 = pid2;
+  batch.pairs = malloc(SEC_FETCH_BATCH * sizeof(SecJoinPair));
+  batch.tupleIds = malloc(SEC_FETCH_BATCH * sizeof(tid));
+  batch.records1 = malloc(SEC_FETCH_BATCH * sizeof(Record));
+  batch.records2 = malloc(SEC_FETCH_BATCH * sizeof(Record));
+
+  HT_ErrorCode code = SHT_InnerJoinCallback(sindexDesc1, sindexDesc2, index_key, method, addSecJoinPair, &batch);
+  if (code == HT_OK)
+    code = batch.code;
+  if (code == HT_OK)
+    code = flushSecJoinBatch(&batch);
+
+  free(batch.pairs);
+  free(batch.tupleIds);
+  free(batch.records1);
+  free(batch.records2);
+  if (opened1 && HT_CloseFile(pid1) != HT_OK)
+    code = HT_ERROR;
+  if (opened2 && HT_CloseFile(pid2) != HT_OK)
+    code = HT_ERROR;
+  return code;
+}
+
+// what the threads of SHT_ParallelInnerJoin share
+typedef struct
+{
+  int fd1, depth1;
+  SecHashEntry *hashEntry1;
+  int fd2, depth2;
+  SecHashEntry *hashEntry2;
+  int depth;              // the largest of the two depths, the hash values below are of this depth
+  int bucketsN;           // number of distinct buckets of the first index
+  int *starts;            // the first hash value of each distinct bucket of the first index
+  int *spans;             // the number of hash values of each distinct bucket of the first index
+  int next;               // the next bucket no thread has taken yet
+  pthread_mutex_t queueMutex; // held while a thread takes a bucket
+} SecParallelJoin;
+
+// one thread of SHT_ParallelInnerJoin
+typedef struct
+{
+  SecParallelJoin *join;
+  SecJoinBatch batch; // the sink of the thread, with the records fetched in batches if it needs them
+  pthread_t thread;
+} SecJoinWorker;
+
+/*
+  Loads the records of the bucket with block_num 'bucket' while holding the read mutex of 'batch', if it has one.
+*/
+HT_ErrorCode getSecBucketRecordsLocked(SecJoinBatch *batch, int fd, BF_Block *block, int bucket, SecondaryRecord **records, int *n, int *local_depth)
+{
+  lockSecJoinReads(batch);
+  HT_ErrorCode code = getSecBucketRecords(fd, block, bucket, records, n, local_depth);
+  unlockSecJoinReads(batch);
+  return code;
+}
+
+/*
+  Thread of SHT_ParallelInnerJoin: takes the distinct buckets of the first index one at a time and joins each with the buckets
+  of the second index under the same hash values, as partitionedJoinSecIndexes does. With lib/libbf.so every BF call holds
+  secBFMutex, with src/bf.c the reads run together. The pairs go to the sink of the thread.
+*/
+void *secJoinWorker(void *arg)
+{
+  SecJoinWorker *worker = arg;
+  SecParallelJoin *join = worker->join;
+  SecJoinBatch *batch = &worker->batch;
+  SHT_JoinCallback callback = batch->sink->needsRecords ? addSecJoinPair : writeSecJoinPair;
+
+  BF_Block *block;
+  BF_Block_Init(&block);
+
+  while (batch->code == HT_OK)
+  {
+    pthread_mutex_lock(&join->queueMutex);
+    int i = join->next++;
+    pthread_mutex_unlock(&join->queueMutex);
+    if (i >= join->bucketsN)
+      break;
+
+    // an error stops this thread only, SHT_ParallelInnerJoin reports it after every thread is done
+    int start = join->starts[i];
+    int end = start + join->spans[i];
+    SecondaryRecord *records1;
+    int n1, local_depth;
+    batch->code = getSecBucketRecordsLocked(batch, join->fd1, block, join->hashEntry1->secHashNode[start >> (join->depth - join->depth1)].block_num,
+                                            &records1, &n1, &local_depth);
+    if (batch->code != HT_OK)
+      break;
+
+    // every key of the bucket is in exactly one of the buckets of the second index under [start, end)
+    int x = start;
+    while (x < end && n1 > 0 && batch->code == HT_OK)
+    {
+      SecondaryRecord *records2;
+      int n2;
+      batch->code = getSecBucketRecordsLocked(batch, join->fd2, block, join->hashEntry2->secHashNode[x >> (join->depth - join->depth2)].block_num,
+                                              &records2, &n2, &local_depth);
+      if (batch->code != HT_OK)
+        break;
+      joinSecBucketRecords(records2, n2, records1, n1, 0, callback, batch);
+      free(records2);
+
+      int span = 1 << (join->depth - local_depth);
+      x = (x & ~(span - 1)) + span;
+    }
+    free(records1);
+  }
+
+  if (batch->code == HT_OK && batch->sink->needsRecords)
+    batch->code = flushSecJoinBatch(batch);
+
+  BF_Block_Destroy(&block);
+  return NULL;
+}
+
+HT_ErrorCode SHT_ParallelInnerJoin(int sindexDesc1, int sindexDesc2, int threadsN, SHT_JoinSink *sinks)
+{
+  if (secIndexArray[sindexDesc1].used == 0 || secIndexArray[sindexDesc2].used == 0)
+  {
+    printf("Can't join a closed file!\n");
+    return HT_ERROR;
+  }
+  if (threadsN < 1 || threadsN > SHT_MAX_THREADS || sinks == NULL)
+  {
+    printf("Wrong join input! Please give from 1 to %d threads, each with a sink.\n", SHT_MAX_THREADS);
+    return HT_ERROR;
+  }
+
+  // get corresponding primary indexes, if any sink needs records
+  int needsRecords = 0;
+  for (int t = 0; t < threadsN; t++)
+    needsRecords |= sinks[t].needsRecords;
+  int pid1 = -1, opened1 = 0;
+  int pid2 = -1, opened2 = 0;
+  if (needsRecords)
+  {
+    if (getPrimaryIndex(secIndexArray[sindexDesc1].primary_name, &pid1, &opened1) != HT_OK)
+      return HT_ERROR;
+    if (getPrimaryIndex(secIndexArray[sindexDesc2].primary_name, &pid2, &opened2) != HT_OK)
+    {
+      if (opened1)
+        HT_CloseFile(pid1);
+      return HT_ERROR;
+    }
+  }
+
+  // get secondary indexes, their HashTables stay pinned and are only read by the threads
+  SecParallelJoin join;
+  BF_Block *block;
+  BF_Block_Init(&block);
+
+  join.fd1 = secIndexArray[sindexDesc1].fd;
+  CALL_OR_DIE(getDepth(join.fd1, block, &join.depth1));
+  BF_Block *hashBlock1;
+  BF_Block_Init(&hashBlock1);
+  CALL_OR_DIE(pinSecHashEntry(join.fd1, hashBlock1, 1, &join.hashEntry1));
+
+  join.fd2 = secIndexArray[sindexDesc2].fd;
+  CALL_OR_DIE(getDepth(join.fd2, block, &join.depth2));
+  BF_Block *hashBlock2;
+  BF_Block_Init(&hashBlock2);
+  CALL_OR_DIE(pinSecHashEntry(join.fd2, hashBlock2, 1, &join.hashEntry2));
+
+  // the distinct buckets of the first index, with the same skip of hash values as every scan
+  prefetchSecBuckets(join.fd1, join.hashEntry1);
+  prefetchSecBuckets(join.fd2, join.hashEntry2);
+  join.depth = join.depth1 > join.depth2 ? join.depth1 : join.depth2;
+  join.bucketsN = 0;
+  join.starts = malloc(join.hashEntry1->secHeader.size * sizeof(int));
+  join.spans = malloc(join.hashEntry1->secHeader.size * sizeof(int));
+  for (int i = 0; i < join.hashEntry1->secHeader.size; i++)
+  {
+    int local_depth;
+    SecEntry *entry;
+    CALL_OR_DIE(pinSecEntry(join.fd1, block, join.hashEntry1->secHashNode[i].block_num, &entry));
+    local_depth = entry->secHeader.local_depth;
+    CALL_OR_DIE(unpinPage(block, 0));
+
+    join.starts[join.bucketsN] = i << (join.depth - join.depth1);
+    join.spans[join.bucketsN++] = 1 << (join.depth - local_depth);
+    i += (1 << (join.depth1 - local_depth)) - 1;
+  }
+  join.next = 0;
+  pthread_mutex_init(&join.queueMutex, NULL);
+
+  // src/bf.c reads with many threads: each one pins up to PIN_WINDOW blocks of a primary index (HT_FetchRecords) and
+  // a bucket block, next to the two HashTables and a block of each sink
+  SecReadGate gate;
+  pthread_mutex_init(&gate.mutex, NULL);
+  pthread_cond_init(&gate.freed, NULL);
+  gate.readers = 0;
+  gate.readersMax = 1;
+#ifdef BF_SRC
+  int frames;
+  if (BF_GetPoolSize(&frames) == BF_OK && (frames - 2 - threadsN) / (PIN_WINDOW + 1) > 1)
+    gate.readersMax = (frames - 2 - threadsN) / (PIN_WINDOW + 1);
+#endif
+
+  SecJoinWorker *workers = malloc(threadsN * sizeof(SecJoinWorker));
+  for (int t = 0; t < threadsN; t++)
+  {
+    SecJoinBatch *batch = &workers[t].batch;
+    workers[t].join = &join;
+    batch->primary1 = pid1;
+    batch->primary2 = pid2;
+    batch->n = 0;
+    batch->pairs = malloc(SEC_FETCH_BATCH * sizeof(SecJoinPair));
+    batch->tupleIds = malloc(SEC_FETCH_BATCH * sizeof(tid));
+    batch->records1 = malloc(SEC_FETCH_BATCH * sizeof(Record));
+    batch->records2 = malloc(SEC_FETCH_BATCH * sizeof(Record));
+    batch->sink = &sinks[t];
+    batch->mutex = &secBFMutex;
+#ifdef BF_SRC
+    batch->readMutex = NULL;
+    batch->gate = &gate;
+#else
+    batch->readMutex = &secBFMutex;
+    batch->gate = NULL;
+#endif
+    batch->code = HT_OK;
+  }
+
+  // with lib/libbf.so the BF is only called with the mutex held from now on, until every thread is done
+  int started = 0;
+  while (started < threadsN && pthread_create(&workers[started].thread, NULL, secJoinWorker, &workers[started]) == 0)
+    started++;
+
+  // if fewer threads could start, the buckets are all taken by those that did
+  HT_ErrorCode code = HT_OK;
+  if (started == 0)
+  {
+    printf("Can't start a join thread!\n");
+    code = HT_ERROR;
+  }
+  for (int t = 0; t < started; t++)
+  {
+    pthread_join(workers[t].thread, NULL);
+    if (workers[t].batch.code != HT_OK)
+      code = HT_ERROR;
+  }
+
+  for (int t = 0; t < threadsN; t++)
+  {
+    free(workers[t].batch.pairs);
+    free(workers[t].batch.tupleIds);
+    free(workers[t].batch.records1);
+    free(workers[t].batch.records2);
+  }
+  free(workers);
+  pthread_mutex_destroy(&join.queueMutex);
+  pthread_mutex_destroy(&gate.mutex);
+  pthread_cond_destroy(&gate.freed);
+  free(join.starts);
+  free(join.spans);
+
+  CALL_OR_DIE(unpinPage(hashBlock1, 0));
+  CALL_OR_DIE(unpinPage(hashBlock2, 0));
+  BF_Block_Destroy(&hashBlock1);
+  BF_Block_Destroy(&hashBlock2);
+  BF_Block_Destroy(&block);
+  if (opened1 && HT_CloseFile(pid1) != HT_OK)
+    code = HT_ERROR;
+  if (opened2 && HT_CloseFile(pid2) != HT_OK)
+    code = HT_ERROR;
+  return code;
+}
+
+/*
+  Sets the fields of 'sink' that the Open...Sink functions do not use to their empty values.
+*/
+void initJoinSink(SHT_JoinSink *sink)
+{
+  sink->needsRecords = 0;
+  sink->write = NULL;
+  sink->close = NULL;
+  sink->rows = 0;
+  sink->callback = NULL;
+  sink->arg = NULL;
+  sink->file = NULL;
+  sink->buffer = NULL;
+  sink->bufferN = 0;
+  sink->bySurname = 0;
+  sink->usesBF = 0;
+  sink->fd = -1;
+  sink->block = NULL;
+  sink->page = NULL;
+}
+
+HT_ErrorCode writeCallbackSink(SHT_JoinSink *sink, const SHT_JoinRow *row)
+{
+  sink->callback(row, sink->arg);
+  return HT_OK;
+}
+
+HT_ErrorCode SHT_OpenCallbackSink(SHT_JoinSink *sink, SHT_JoinRowCallback callback, void *arg)
+{
+  if (callback == NULL)
+  {
+    printf("Please give a callback for the sink!\n");
+    return HT_ERROR;
+  }
+
+  initJoinSink(sink);
+  sink->needsRecords = 1;
+  sink->write = writeCallbackSink;
+  sink->callback = callback;
+  sink->arg = arg;
+  return HT_OK;
+}
+
+HT_ErrorCode writeCountSink(SHT_JoinSink *sink, const SHT_JoinRow *row)
+{
+  (void)sink;
+  (void)row;
+  return HT_OK;
+}
+
+HT_ErrorCode SHT_OpenCountSink(SHT_JoinSink *sink)
+{
+  initJoinSink(sink);
+  sink->write = writeCountSink;
+  return HT_OK;
+}
+
+/*
+  Writes the text kept in the buffer of 'sink' to its file.
+*/
+HT_ErrorCode flushSinkBuffer(SHT_JoinSink *sink)
+{
+  if (sink->bufferN > 0 && fwrite(sink->buffer, 1, sink->bufferN, sink->file) != (size_t)sink->bufferN)
+  {
+    printf("Can't write the join rows!\n");
+    return HT_ERROR;
+  }
+  sink->bufferN = 0;
+  return HT_OK;
+}
+
+/*
+  Appends the first 'n' chars of 'text' to the buffer of 'sink', writing the buffer out first if they do not fit.
+*/
+HT_ErrorCode appendSinkText(SHT_JoinSink *sink, const char *text, int n)
+{
+  if (sink->bufferN + n > SHT_SINK_BUFFER_SIZE)
+    CALL_OR_DIE(flushSinkBuffer(sink));
+  memcpy(sink->buffer + sink->bufferN, text, n);
+  sink->bufferN += n;
+  return HT_OK;
+}
+
+/*
+  Appends the string 'str' (at most 'size' chars, as record fields may fill their array) to the buffer of 'sink'.
+*/
+HT_ErrorCode appendSinkString(SHT_JoinSink *sink, const char *str, int size)
+{
+  return appendSinkText(sink, str, strnlen(str, size));
+}
+
+/*
+  Appends 'value' in decimal to the buffer of 'sink', without going through printf.
+*/
+HT_ErrorCode appendSinkInt(SHT_JoinSink *sink, int value)
+{
+  char digits[12];
+  int n = sizeof(digits);
+  unsigned int u = value < 0 ? -(unsigned int)value : (unsigned int)value;
+
+  do
+  {
+    digits[--n] = '0' + u % 10;
+    u /= 10;
+  } while (u > 0);
+  if (value < 0)
+    digits[--n] = '-';
+
+  return appendSinkText(sink, digits + n, sizeof(digits) - n);
+}
+
+/*
+  Appends the string 'str' (at most 'size' chars) as a CSV field, in quotes if it has a comma, a quote or a newline.
+*/
+HT_ErrorCode appendCsvField(SHT_JoinSink *sink, const char *str, int size)
+{
+  int n = strnlen(str, size);
+  if (strcspn(str, ",\"\n") >= (size_t)n)
+    return appendSinkText(sink, str, n);
+
+  CALL_OR_DIE(appendSinkText(sink, "\"", 1));
+  for (int i = 0; i < n; i++)
+  {
+    if (str[i] == '"')
+      CALL_OR_DIE(appendSinkText(sink, "\"", 1));
+    CALL_OR_DIE(appendSinkText(sink, &str[i], 1));
+  }
+  return appendSinkText(sink, "\"", 1);
+}
+
+/*
+  Appends a tuple id and the fields of its 'record' as CSV fields, each followed by 'end'.
+*/
+HT_ErrorCode appendCsvRecord(SHT_JoinSink *sink, tid tupleId, const Record *record, const char *end)
+{
+  CALL_OR_DIE(appendSinkInt(sink, tupleId));
+  CALL_OR_DIE(appendSinkText(sink, ",", 1));
+  CALL_OR_DIE(appendSinkInt(sink, record->id));
+  CALL_OR_DIE(appendSinkText(sink, ",", 1));
+  CALL_OR_DIE(appendCsvField(sink, record->name, sizeof(record->name)));
+  CALL_OR_DIE(appendSinkText(sink, ",", 1));
+  CALL_OR_DIE(appendCsvField(sink, record->surname, sizeof(record->surname)));
+  CALL_OR_DIE(appendSinkText(sink, ",", 1));
+  CALL_OR_DIE(appendCsvField(sink, record->city, sizeof(record->city)));
+  return appendSinkText(sink, end, strlen(end));
+}
+
+HT_ErrorCode writeCsvSink(SHT_JoinSink *sink, const SHT_JoinRow *row)
+{
+  CALL_OR_DIE(appendCsvField(sink, row->index_key, 20));
+  CALL_OR_DIE(appendSinkText(sink, ",", 1));
+  CALL_OR_DIE(appendCsvRecord(sink, row->tupleId1, row->record1, ","));
+  return appendCsvRecord(sink, row->tupleId2, row->record2, "\n");
+}
+
+/*
+  close of the text sinks: writes out the rest of the buffer and frees it. The file stays open.
+*/
+HT_ErrorCode closeTextSink(SHT_JoinSink *sink)
+{
+  HT_ErrorCode code = flushSinkBuffer(sink);
+  if (code == HT_OK && fflush(sink->file) != 0)
+    code = HT_ERROR;
+  free(sink->buffer);
+  sink->buffer = NULL;
+  return code;
+}
+
+HT_ErrorCode SHT_OpenCsvSink(SHT_JoinSink *sink, FILE *file)
+{
+  if (file == NULL)
+  {
+    printf("Please give a file for the sink!\n");
+    return HT_ERROR;
+  }
+
+  initJoinSink(sink);
+  sink->needsRecords = 1;
+  sink->write = writeCsvSink;
+  sink->close = closeTextSink;
+  sink->file = file;
+  sink->buffer = malloc(SHT_SINK_BUFFER_SIZE);
+
+  const char *header = "key,tupleId1,id1,name1,surname1,city1,tupleId2,id2,name2,surname2,city2\n";
+  return appendSinkText(sink, header, strlen(header));
+}
+
+/*
+  write of the sink of SHT_InnerJoin: the layout SHT_InnerJoin always printed, through the buffer of the sink.
+*/
+HT_ErrorCode writePrintSink(SHT_JoinSink *sink, const SHT_JoinRow *row)
+{
+  const Record *records[2] = {row->record1, row->record2};
+  tid tupleIds[2] = {row->tupleId1, row->tupleId2};
+
+  CALL_OR_DIE(appendSinkString(sink, row->index_key, 20));
+  for (int i = 0; i < 2; i++)
+  {
+    CALL_OR_DIE(appendSinkText(sink, ", ", 2));
+    CALL_OR_DIE(appendSinkInt(sink, tupleIds[i]));
+    CALL_OR_DIE(appendSinkText(sink, ", ", 2));
+    CALL_OR_DIE(appendSinkString(sink, records[i]->name, sizeof(records[i]->name)));
+    CALL_OR_DIE(appendSinkText(sink, ", ", 2));
+
+    // check record types of secondary directories in order to adjust prints
+    if (sink->bySurname)
+    {
+      CALL_OR_DIE(appendSinkString(sink, records[i]->city, sizeof(records[i]->city)));
+    }
+    else
+    {
+      CALL_OR_DIE(appendSinkString(sink, records[i]->surname, sizeof(records[i]->surname)));
+    }
+  }
+  return appendSinkText(sink, "\n", 1);
+}
+
+/*
+  Opens the sink of SHT_InnerJoin, that prints to stdout the key, then the tuple id, name and city (for indexes on surnames)
+  or surname (for indexes on cities) of both records.
+*/
+HT_ErrorCode openSecPrintSink(SHT_JoinSink *sink, int bySurname)
+{
+  initJoinSink(sink);
+  sink->needsRecords = 1;
+  sink->write = writePrintSink;
+  sink->close = closeTextSink;
+  sink->file = stdout;
+  sink->buffer = malloc(SHT_SINK_BUFFER_SIZE);
+  sink->bySurname = bySurname;
+  return HT_OK;
+}
+
+HT_ErrorCode writeBlockFileSink(SHT_JoinSink *sink, const SHT_JoinRow *row)
+{
+  // a full block is unpinned, the next row goes to a new one
+  if (sink->page->header.size == (int)SHT_MAX_JOIN_ROWS)
+  {
+    CALL_OR_DIE(unpinPage(sink->block, 1));
+    CALL_BF(BF_AllocateBlock(sink->fd, sink->block));
+    sink->page = (SHT_JoinRowPage *)BF_Block_GetData(sink->block);
+    sink->page->header.size = 0;
+  }
+
+  SHT_JoinRowRecord *record = &sink->page->row[sink->page->header.size++];
+  memset(record->index_key, 0, sizeof(record->index_key));
+  strncpy(record->index_key, row->index_key, sizeof(record->index_key) - 1);
+  record->tupleId1 = row->tupleId1;
+  record->tupleId2 = row->tupleId2;
+  record->record1 = *row->record1;
+  record->record2 = *row->record2;
+  return HT_OK;
+}
+
+HT_ErrorCode closeBlockFileSink(SHT_JoinSink *sink)
+{
+  CALL_OR_DIE(unpinPage(sink->block, 1));
+  BF_Block_Destroy(&sink->block);
+  CALL_BF(BF_CloseFile(sink->fd));
+  sink->page = NULL;
+  return HT_OK;
+}
+
+HT_ErrorCode SHT_OpenBlockFileSink(SHT_JoinSink *sink, const char *fileName)
+{
+  if (fileName == NULL || strcmp(fileName, "") == 0)
+  {
+    printf("Please provide a name for the output file!\n");
+    return HT_ERROR;
+  }
+
+  initJoinSink(sink);
+  sink->needsRecords = 1;
+  sink->write = writeBlockFileSink;
+  sink->close = closeBlockFileSink;
+  sink->usesBF = 1;
+
+  CALL_BF(BF_CreateFile(fileName));
+  CALL_BF(BF_OpenFile(fileName, &sink->fd));
+  BF_Block_Init(&sink->block);
+  CALL_BF(BF_AllocateBlock(sink->fd, sink->block));
+  sink->page = (SHT_JoinRowPage *)BF_Block_GetData(sink->block);
+  sink->page->header.size = 0;
+  return HT_OK;
+}
+
+HT_ErrorCode SHT_CloseJoinSink(SHT_JoinSink *sink)
+{
+  if (sink->close == NULL)
+    return HT_OK;
+  return sink->close(sink);
+}
+
+HT_ErrorCode SHT_ScanJoinRowFile(const char *fileName, SHT_JoinRowCallback callback, void *arg)
+{
+  if (callback == NULL)
+  {
+    printf("Please give a callback for the rows!\n");
+    return HT_ERROR;
+  }
+
+  int fd, blocks;
+  CALL_BF(BF_OpenFile(fileName, &fd));
+  CALL_BF(BF_GetBlockCounter(fd, &blocks));
+  BF_Block *block;
+  BF_Block_Init(&block);
+
+  for (int b = 0; b < blocks; b++)
+  {
+    CALL_BF(BF_GetBlock(fd, b, block));
+    SHT_JoinRowPage *page = (SHT_JoinRowPage *)BF_Block_GetData(block);
+    for (int i = 0; i < page->header.size; i++)
+    {
+      SHT_JoinRow row;
+      row.index_key = page->row[i].index_key;
+      row.tupleId1 = page->row[i].tupleId1;
+      row.tupleId2 = page->row[i].tupleId2;
+      row.record1 = &page->row[i].record1;
+      row.record2 = &page->row[i].record2;
+      callback(&row, arg);
+    }
+    CALL_OR_DIE(unpinPage(block, 0));
+  }
+
+  BF_Block_Destroy(&block);
+  CALL_BF(BF_CloseFile(fd));
+  return HT_OK;
+}
+
+HT_ErrorCode SHT_InnerJoin(int sindexDesc1, int sindexDesc2, char *index_key)
+{
+  if (secIndexArray[sindexDesc1].used == 0 || secIndexArray[sindexDesc2].used == 0)
+  {
+    printf("Can't join a closed file!\n");
+    return HT_ERROR;
+  }
+
+  // the attribute is read from the first index's HashTable
+  BF_Block *block;
+  BF_Block_Init(&block);
+  SecHashEntry *hashEntry;
+  CALL_OR_DIE(pinSecHashEntry(secIndexArray[sindexDesc1].fd, block, 1, &hashEntry));
+  int bySurname = strcmp(hashEntry->secHeader.attribute, "surnames") == 0;
+  CALL_OR_DIE(unpinPage(block, 0));
+  BF_Block_Destroy(&block);
+
+  SHT_JoinSink sink;
+  CALL_OR_DIE(openSecPrintSink(&sink, bySurname));
+  HT_ErrorCode code = SHT_InnerJoinSink(sindexDesc1, sindexDesc2, index_key, SHT_PARTITIONED_JOIN, &sink);
+  HT_ErrorCode closeCode = SHT_CloseJoinSink(&sink);
+  return code == HT_OK ? closeCode : code;
+}